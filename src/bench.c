@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "core/awale.h"
+#include "core/awale_batch.h"
+#include "client/render.h"
+#include "engine/engine.h"
+#include "utils/clock.h"
+#include "utils/constants.h"
+
+/*
+ * Benchmarks. Each one is a subcommand:
+ *   smp   - Lazy SMP scaling: time to search a fixed set of positions to a
+ *           fixed depth with 1, 2, 4 ... threads (speedup and efficiency)
+ *   batch - move generation throughput: apply_move in a loop against the
+ *           packed batch API (scalar and vector paths), checked for equality
+ *   render - board rendering throughput: the client's template renderer
+ *           against the snprintf one it replaced, checked for equality
+ */
+
+static void display_help_menu(char *exec_name)
+{
+    printf("Usage: %s <benchmark> [options]\n", exec_name);
+    printf("Benchmarks:\n");
+    printf("  smp [--depth <d>] [--threads <max>] [--positions <n>] [--hash <mb>]\n");
+    printf("                         Lazy SMP speedup vs thread count at fixed depth (default: 12, CPUs, 8, 64)\n");
+    printf("  batch [--boards <n>] [--rounds <n>]\n");
+    printf("                         Batch move generation vs apply_move (default: 65536, 100)\n");
+    printf("  render [--boards <n>] [--rounds <n>]\n");
+    printf("                         Template board rendering vs snprintf (default: 4096, 200)\n");
+    printf("  --help                 Show this help message\n");
+}
+
+static unsigned int next_random(unsigned int *state)
+{
+    /* xorshift32 */
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// Reproducible middle-game positions: random legal plies from the start
+static void bench_positions(Board *boards, int count, int plies)
+{
+    unsigned int rng = 12345;
+    for (int i = 0; i < count; i++)
+    {
+        do
+        {
+            init_board(&boards[i]);
+            for (int p = 0; p < plies && !is_game_over(&boards[i]); p++)
+            {
+                int moves[PITS_PER_PLAYER];
+                int n = legal_moves(&boards[i], moves);
+                apply_move(&boards[i], moves[next_random(&rng) % n]);
+            }
+        } while (is_game_over(&boards[i]));
+    }
+}
+
+static int bench_smp(int argc, char **argv)
+{
+    EngineParams params;
+    engine_default_params(&params);
+    params.depth = 12;
+    int max_threads = 0;
+    int positions = 8;
+    int hash_mb = 64;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--depth") == 0)
+            params.depth = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--threads") == 0)
+            max_threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--positions") == 0)
+            positions = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--hash") == 0)
+            hash_mb = atoi(argv[i + 1]);
+        else
+        {
+            fprintf(stderr, "%s[error]%s Unknown argument: %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (max_threads <= 0)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        max_threads = n > 1 ? (int)n : 2;
+    }
+    if (max_threads > ENGINE_MAX_THREADS)
+        max_threads = ENGINE_MAX_THREADS;
+    if (params.depth < 1 || params.depth > ENGINE_MAX_DEPTH || positions < 1 || hash_mb < 1)
+    {
+        fprintf(stderr, "%s[error]%s Invalid depth, position count or hash size\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+        return EXIT_FAILURE;
+    }
+
+    Board *boards = malloc(sizeof(Board) * positions);
+    EngineTable table;
+    if (!boards || engine_table_init(&table, (size_t)hash_mb) != 0)
+    {
+        fprintf(stderr, "%s[error]%s Out of memory\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+        return EXIT_FAILURE;
+    }
+    bench_positions(boards, positions, 8);
+
+    printf("%s[bench]%s Lazy SMP, %d positions at depth %d, %d MB table\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, positions, params.depth, hash_mb);
+    printf("threads      time(ms)   Mnodes/s    speedup  efficiency\n");
+    double base_ms = 0;
+    int threads = 1;
+    for (;;)
+    {
+        EngineStats stats = {0};
+        long long start = monotonic_ms();
+        for (int i = 0; i < positions; i++)
+        {
+            int best;
+            engine_table_clear(&table); // every position starts cold
+            engine_search_parallel(&boards[i], &params, &table, threads, &stats, &best);
+        }
+        double ms = (double)(monotonic_ms() - start);
+        if (ms < 1)
+            ms = 1;
+        if (threads == 1)
+            base_ms = ms;
+        double speedup = base_ms / ms;
+        printf("%7d %13.0f %10.2f %10.2f %10.0f%%\n", threads, ms, stats.nodes / ms / 1000.0, speedup, 100.0 * speedup / threads);
+        if (threads >= max_threads)
+            break;
+        threads = threads * 2 < max_threads ? threads * 2 : max_threads;
+    }
+
+    engine_table_free(&table);
+    free(boards);
+    return EXIT_SUCCESS;
+}
+
+// Milliseconds spent applying moves[i] to a fresh copy of boards[i], `rounds` times
+static double time_apply_move(const Board *boards, const uint8_t *moves, Board *work, int count, int rounds)
+{
+    long long total = 0;
+    for (int r = 0; r < rounds; r++)
+    {
+        memcpy(work, boards, sizeof(Board) * count);
+        long long start = monotonic_ms();
+        for (int i = 0; i < count; i++)
+            apply_move(&work[i], moves[i]);
+        total += monotonic_ms() - start;
+    }
+    return (double)total;
+}
+
+static double time_batch(void (*apply)(PackedBoard *, const uint8_t *, size_t), const PackedBoard *boards, const uint8_t *moves, PackedBoard *work, int count, int rounds)
+{
+    long long total = 0;
+    for (int r = 0; r < rounds; r++)
+    {
+        memcpy(work, boards, sizeof(PackedBoard) * count);
+        long long start = monotonic_ms();
+        apply(work, moves, (size_t)count);
+        total += monotonic_ms() - start;
+    }
+    return (double)total;
+}
+
+static int bench_batch(int argc, char **argv)
+{
+    int count = 65536;
+    int rounds = 100;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--boards") == 0)
+            count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--rounds") == 0)
+            rounds = atoi(argv[i + 1]);
+        else
+        {
+            fprintf(stderr, "%s[error]%s Unknown argument: %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (count < 1 || rounds < 1)
+    {
+        fprintf(stderr, "%s[error]%s Invalid board or round count\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+        return EXIT_FAILURE;
+    }
+
+    Board *boards = malloc(sizeof(Board) * count);
+    Board *work = malloc(sizeof(Board) * count);
+    PackedBoard *packed = malloc(sizeof(PackedBoard) * count);
+    PackedBoard *packed_work = malloc(sizeof(PackedBoard) * count);
+    uint8_t *moves = malloc(count);
+    if (!boards || !work || !packed || !packed_work || !moves)
+    {
+        fprintf(stderr, "%s[error]%s Out of memory\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+        return EXIT_FAILURE;
+    }
+    // a spread of game phases, each with a random legal move
+    unsigned int rng = 777;
+    for (int i = 0; i < count; i += 64)
+        bench_positions(&boards[i], count - i < 64 ? count - i : 64, 4 + (i / 64) % 40);
+    for (int i = 0; i < count; i++)
+    {
+        int legal[PITS_PER_PLAYER];
+        int n = legal_moves(&boards[i], legal);
+        moves[i] = (uint8_t)legal[next_random(&rng) % n];
+        awale_pack(&boards[i], &packed[i]);
+    }
+
+    double loop_ms = time_apply_move(boards, moves, work, count, rounds);
+    double scalar_ms = time_batch(awale_batch_apply_scalar, packed, moves, packed_work, count, rounds);
+    int mismatches = 0;
+    for (int i = 0; i < count; i++)
+    {
+        Board b;
+        awale_unpack(&packed_work[i], &b);
+        mismatches += memcmp(&b, &work[i], sizeof(Board)) != 0;
+    }
+    double batch_ms = time_batch(awale_batch_apply, packed, moves, packed_work, count, rounds);
+    for (int i = 0; i < count; i++)
+    {
+        Board b;
+        awale_unpack(&packed_work[i], &b);
+        mismatches += memcmp(&b, &work[i], sizeof(Board)) != 0;
+    }
+
+    double moves_total = (double)count * rounds;
+    printf("%s[bench]%s Batch move generation, %d boards x %d rounds\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, count, rounds);
+    printf("%-22s %10s %12s %9s\n", "path", "time(ms)", "Mmoves/s", "speedup");
+    printf("%-22s %10.0f %12.1f %9.2f\n", "apply_move loop", loop_ms, moves_total / (loop_ms > 0 ? loop_ms : 1) / 1000.0, 1.0);
+    printf("%-22s %10.0f %12.1f %9.2f\n", "batch scalar", scalar_ms, moves_total / (scalar_ms > 0 ? scalar_ms : 1) / 1000.0, loop_ms / (scalar_ms > 0 ? scalar_ms : 1));
+    printf("batch %-16s %10.0f %12.1f %9.2f\n", awale_batch_impl(), batch_ms, moves_total / (batch_ms > 0 ? batch_ms : 1) / 1000.0, loop_ms / (batch_ms > 0 ? batch_ms : 1));
+    if (mismatches)
+        printf("%s[error]%s %d boards differ from apply_move\n", COLOR_RED COLOR_BOLD, COLOR_RESET, mismatches);
+    else
+        printf("%s[bench]%s all boards match apply_move\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET);
+
+    free(boards);
+    free(work);
+    free(packed);
+    free(packed_work);
+    free(moves);
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// The renderer render_board() replaced: one snprintf per field
+static int render_board_snprintf(const BoardState *state, char *out, size_t out_size)
+{
+    if (out == NULL || out_size == 0)
+        return 0;
+    size_t off = 0;
+#define APPENDF(fmt, ...)                                                     \
+    do                                                                        \
+    {                                                                         \
+        if (off < out_size)                                                   \
+        {                                                                     \
+            int _n = snprintf(out + off, out_size - off, fmt, ##__VA_ARGS__); \
+            if (_n > 0)                                                       \
+                off += (size_t)_n;                                            \
+        }                                                                     \
+    } while (0)
+
+    APPENDF("\n");
+    APPENDF("%s=====================================%s\n", STYLE_DIM, COLOR_RESET);
+    APPENDF("%sPlayer 2:%s %s%2d%s           %s<-- Direction%s\n", COLOR_BOLD COLOR_YELLOW, COLOR_RESET, COLOR_BOLD COLOR_YELLOW, state->score[1], COLOR_RESET, STYLE_DIM, COLOR_RESET);
+    APPENDF("     ");
+    for (int i = TOTAL_PITS - 1; i >= PITS_PER_PLAYER; i--)
+        APPENDF("%s[%2d]%s", COLOR_BOLD COLOR_GREEN, state->pits[i], COLOR_RESET);
+    APPENDF("\n");
+    APPENDF("%sPit:  %s", STYLE_DIM, COLOR_RESET);
+    for (int i = TOTAL_PITS - 1; i >= PITS_PER_PLAYER; i--)
+        APPENDF("%s %2d %s", STYLE_DIM, i, COLOR_RESET);
+    APPENDF("\n");
+    APPENDF("%s     -------------------------%s\n", STYLE_DIM, COLOR_RESET);
+    APPENDF("%sPit:  %s", STYLE_DIM, COLOR_RESET);
+    for (int i = 0; i < PITS_PER_PLAYER; i++)
+        APPENDF("%s %2d %s", STYLE_DIM, i, COLOR_RESET);
+    APPENDF("\n");
+    APPENDF("     ");
+    for (int i = 0; i < PITS_PER_PLAYER; i++)
+        APPENDF("%s[%2d]%s", COLOR_BOLD COLOR_RED, state->pits[i], COLOR_RESET);
+    APPENDF("\n%sDirection -->%s           %sPlayer 1: %2d%s\n", STYLE_DIM, COLOR_RESET, COLOR_BOLD COLOR_YELLOW, state->score[0], COLOR_RESET);
+    APPENDF("%s=====================================%s\n", STYLE_DIM, COLOR_RESET);
+#undef APPENDF
+    if (off >= out_size)
+    {
+        out[out_size - 1] = '\0';
+        return (int)(out_size - 1);
+    }
+    return (int)off;
+}
+
+// Milliseconds spent rendering every state `rounds` times; *bytes gets a
+// checksum of the output so the work is not optimized away
+static double time_render(int (*render)(const BoardState *, char *, size_t), const BoardState *states, int count, int rounds, long long *bytes)
+{
+    char out[BUF_SIZE];
+    long long start = monotonic_ms();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < count; i++)
+            *bytes += render(&states[i], out, sizeof(out)) + out[r % 64];
+    }
+    return (double)(monotonic_ms() - start);
+}
+
+static int bench_render(int argc, char **argv)
+{
+    int count = 4096;
+    int rounds = 200;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--boards") == 0)
+            count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--rounds") == 0)
+            rounds = atoi(argv[i + 1]);
+        else
+        {
+            fprintf(stderr, "%s[error]%s Unknown argument: %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (count < 1 || rounds < 1)
+    {
+        fprintf(stderr, "%s[error]%s Invalid board or round count\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+        return EXIT_FAILURE;
+    }
+
+    Board *boards = malloc(sizeof(Board) * count);
+    BoardState *states = malloc(sizeof(BoardState) * count);
+    if (!boards || !states)
+    {
+        fprintf(stderr, "%s[error]%s Out of memory\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < count; i += 64)
+        bench_positions(&boards[i], count - i < 64 ? count - i : 64, 4 + (i / 64) % 40);
+    memset(states, 0, sizeof(BoardState) * count);
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(states[i].pits, boards[i].pits, sizeof(states[i].pits));
+        states[i].score[0] = boards[i].score[0];
+        states[i].score[1] = boards[i].score[1];
+    }
+
+    int mismatches = 0;
+    for (int i = 0; i < count; i++)
+    {
+        char a[BUF_SIZE], b[BUF_SIZE];
+        int la = render_board_snprintf(&states[i], a, sizeof(a));
+        int lb = render_board(&states[i], b, sizeof(b));
+        mismatches += la != lb || strcmp(a, b) != 0;
+    }
+
+    long long sink = 0;
+    double snprintf_ms = time_render(render_board_snprintf, states, count, rounds, &sink);
+    double template_ms = time_render(render_board, states, count, rounds, &sink);
+
+    double renders = (double)count * rounds;
+    printf("%s[bench]%s Board rendering, %d boards x %d rounds (checksum %lld)\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, count, rounds, sink);
+    printf("%-22s %10s %12s %9s\n", "renderer", "time(ms)", "Mrenders/s", "speedup");
+    printf("%-22s %10.0f %12.2f %9.2f\n", "snprintf", snprintf_ms, renders / (snprintf_ms > 0 ? snprintf_ms : 1) / 1000.0, 1.0);
+    printf("%-22s %10.0f %12.2f %9.2f\n", "template", template_ms, renders / (template_ms > 0 ? template_ms : 1) / 1000.0, snprintf_ms / (template_ms > 0 ? template_ms : 1));
+    if (mismatches)
+        printf("%s[error]%s %d boards render differently\n", COLOR_RED COLOR_BOLD, COLOR_RESET, mismatches);
+    else
+        printf("%s[bench]%s all boards render identically\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET);
+
+    free(boards);
+    free(states);
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || strcmp(argv[1], "--help") == 0)
+    {
+        display_help_menu(argv[0]);
+        return argc < 2 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    if (strcmp(argv[1], "smp") == 0)
+        return bench_smp(argc - 2, argv + 2);
+    if (strcmp(argv[1], "batch") == 0)
+        return bench_batch(argc - 2, argv + 2);
+    if (strcmp(argv[1], "render") == 0)
+        return bench_render(argc - 2, argv + 2);
+
+    fprintf(stderr, "%s[error]%s Unknown benchmark: %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, argv[1]);
+    display_help_menu(argv[0]);
+    return EXIT_FAILURE;
+}
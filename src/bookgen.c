@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "core/awale.h"
+#include "engine/engine.h"
+#include "engine/book.h"
+#include "engine/pool.h"
+#include "utils/clock.h"
+#include "utils/constants.h"
+
+/*
+ * Opening book builder. Every position reached in the first --plies plies
+ * (of every variant, either side starting) is searched once to --depth on
+ * all threads. Then --games self-play games, each through a random book
+ * line and played out by the engine at --game-depth, count how often the
+ * side to move won from every book position. See engine/book.h.
+ */
+
+#define BOOK_MAX_GAME_PLIES 400 // self-play games are adjudicated after this
+
+typedef struct
+{
+    uint64_t key;
+    Board board;
+} Node;
+
+typedef struct
+{
+    Node *items;
+    size_t count;
+    size_t capacity;
+} NodeList;
+
+typedef struct
+{
+    int variants[VARIANT_COUNT];
+    int variant_count;
+    int plies;
+    EngineParams params; // of the self-play games
+    uint64_t *keys;      // per game, plies + 1 positions
+    signed char *movers; // side to move at each of them
+    signed char *winner; // per game: 0, 1, or -1 for a draw
+} Games;
+
+static void display_help_menu(char *exec_name)
+{
+    printf("Usage: %s [--plies <n>] [--depth <d>] [--games <n>] [--out <file>]\n", exec_name);
+    printf("Options:\n");
+    printf("  --plies <n>            Plies from the start covered by the book (default: 4)\n");
+    printf("  --depth <d>            Search depth of every book position (default: 16)\n");
+    printf("  --games <n>            Self-play games through the book for statistics (default: 2000)\n");
+    printf("  --game-depth <d>       Engine depth of the self-play games (default: 4)\n");
+    printf("  --variant <name>       Only this variant (default: all)\n");
+    printf("  --threads <n>          Worker threads (default: number of CPUs)\n");
+    printf("  --out <file>           Book file (default: %s/%s)\n", PERSIST_DEFAULT_DIR, BOOK_FILE);
+    printf("  --help                 Show this help message\n");
+}
+
+static unsigned int next_random(unsigned int *state)
+{
+    /* xorshift32 */
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static int push_node(NodeList *list, const Board *board)
+{
+    if (list->count == list->capacity)
+    {
+        size_t capacity = list->capacity ? list->capacity * 2 : 1024;
+        Node *grown = realloc(list->items, capacity * sizeof(Node));
+        if (!grown)
+            return -1;
+        list->items = grown;
+        list->capacity = capacity;
+    }
+    list->items[list->count].key = engine_hash(board);
+    list->items[list->count].board = *board;
+    list->count++;
+    return 0;
+}
+
+static int compare_nodes(const void *a, const void *b)
+{
+    uint64_t ka = ((const Node *)a)->key;
+    uint64_t kb = ((const Node *)b)->key;
+    return ka < kb ? -1 : (ka > kb);
+}
+
+// Sort by key and drop transpositions
+static void unique_nodes(NodeList *list)
+{
+    if (list->count == 0)
+        return;
+    qsort(list->items, list->count, sizeof(Node), compare_nodes);
+    size_t kept = 1;
+    for (size_t i = 1; i < list->count; i++)
+    {
+        if (list->items[i].key != list->items[kept - 1].key)
+            list->items[kept++] = list->items[i];
+    }
+    list->count = kept;
+}
+
+// Every position of the first `plies` plies where the game is not over,
+// one per key, sorted by key
+static int collect_positions(const Games *g, NodeList *all)
+{
+    NodeList level = {0};
+    NodeList next = {0};
+    int ok = 1;
+    for (int v = 0; v < g->variant_count && ok; v++)
+    {
+        for (int first = 0; first < 2 && ok; first++)
+        {
+            Board b;
+            init_board_variant(&b, g->variants[v]);
+            b.current_player = first;
+            ok = push_node(&level, &b) == 0;
+        }
+    }
+    for (int ply = 0; ply <= g->plies && ok; ply++)
+    {
+        unique_nodes(&level);
+        next.count = 0;
+        for (size_t i = 0; i < level.count && ok; i++)
+        {
+            ok = push_node(all, &level.items[i].board) == 0;
+            if (ply == g->plies)
+                continue;
+            int moves[PITS_PER_PLAYER];
+            int n = legal_moves(&level.items[i].board, moves);
+            for (int m = 0; m < n && ok; m++)
+            {
+                Board child = level.items[i].board;
+                apply_move(&child, moves[m]);
+                if (!is_game_over(&child))
+                    ok = push_node(&next, &child) == 0;
+            }
+        }
+        NodeList swap = level;
+        level = next;
+        next = swap;
+    }
+    unique_nodes(all);
+    free(level.items);
+    free(next.items);
+    return ok ? 0 : -1;
+}
+
+// One self-play game: a random line through the book, then the engine
+static void play_game(int game, int worker, void *ctx)
+{
+    (void)worker;
+    Games *g = ctx;
+    Board board;
+    init_board_variant(&board, g->variants[game % g->variant_count]);
+    board.current_player = (game / g->variant_count) % 2;
+    unsigned int rng = (unsigned int)game * 2654435761u + 1;
+    uint64_t *keys = &g->keys[(size_t)game * (g->plies + 1)];
+    signed char *movers = &g->movers[(size_t)game * (g->plies + 1)];
+    for (int ply = 0; ply <= g->plies; ply++)
+        movers[ply] = -1; // not reached
+    EngineStats stats = {0};
+    for (int ply = 0; ply < BOOK_MAX_GAME_PLIES && !is_game_over(&board); ply++)
+    {
+        int pit;
+        if (ply <= g->plies)
+        {
+            keys[ply] = engine_hash(&board);
+            movers[ply] = (signed char)board.current_player;
+        }
+        if (ply < g->plies)
+        {
+            int moves[PITS_PER_PLAYER];
+            int n = legal_moves(&board, moves);
+            pit = n ? moves[next_random(&rng) % n] : -1;
+        }
+        else
+            engine_search(&board, &g->params, &stats, &pit);
+        if (pit < 0)
+            break;
+        apply_move(&board, pit);
+    }
+    int diff = board.score[0] - board.score[1];
+    g->winner[game] = diff > 0 ? 0 : (diff < 0 ? 1 : -1);
+}
+
+static int compare_key_entry(const void *key, const void *entry)
+{
+    uint64_t k = *(const uint64_t *)key;
+    uint64_t e = ((const BookEntry *)entry)->key;
+    return k < e ? -1 : (k > e);
+}
+
+int main(int argc, char **argv)
+{
+    Games g;
+    memset(&g, 0, sizeof(g));
+    g.plies = 4;
+    int depth = 16;
+    int games = 2000;
+    int game_depth = 4;
+    int threads = pool_default_threads();
+    const char *out = NULL;
+    int variant = -1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        int ok = value != NULL;
+        if (strcmp(argv[i], "--help") == 0)
+        {
+            display_help_menu(argv[0]);
+            return EXIT_SUCCESS;
+        }
+        else if (ok && strcmp(argv[i], "--plies") == 0)
+            g.plies = atoi(value);
+        else if (ok && strcmp(argv[i], "--depth") == 0)
+            depth = atoi(value);
+        else if (ok && strcmp(argv[i], "--games") == 0)
+            games = atoi(value);
+        else if (ok && strcmp(argv[i], "--game-depth") == 0)
+            game_depth = atoi(value);
+        else if (ok && strcmp(argv[i], "--threads") == 0)
+            threads = atoi(value);
+        else if (ok && strcmp(argv[i], "--out") == 0)
+            out = value;
+        else if (ok && strcmp(argv[i], "--variant") == 0)
+            ok = (variant = variant_by_name(value)) >= 0;
+        else
+            ok = 0;
+        if (!ok)
+        {
+            fprintf(stderr, "%s[error]%s Invalid argument: %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, argv[i]);
+            display_help_menu(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i++;
+    }
+    if (g.plies < 0 || depth < 1 || depth > ENGINE_MAX_DEPTH || games < 0 || game_depth < 1 || threads < 1)
+    {
+        fprintf(stderr, "%s[error]%s Need plies >= 0, depth 1..%d, games >= 0, game depth >= 1 and 1 thread\n", COLOR_RED COLOR_BOLD, COLOR_RESET, ENGINE_MAX_DEPTH);
+        return EXIT_FAILURE;
+    }
+    if (threads > ENGINE_MAX_THREADS)
+        threads = ENGINE_MAX_THREADS;
+    char default_out[256];
+    if (!out)
+    {
+        mkdir(PERSIST_DEFAULT_DIR, 0755); // may exist already
+        snprintf(default_out, sizeof(default_out), "%s/%s", PERSIST_DEFAULT_DIR, BOOK_FILE);
+        out = default_out;
+    }
+    for (int v = 0; v < VARIANT_COUNT; v++)
+    {
+        if (variant < 0 || v == variant)
+            g.variants[g.variant_count++] = v;
+    }
+
+    NodeList positions = {0};
+    if (collect_positions(&g, &positions) != 0)
+    {
+        fprintf(stderr, "%s[error]%s Out of memory\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+        return EXIT_FAILURE;
+    }
+    printf("%s[book]%s %zu positions in the first %d plies of %d variant(s), depth %d on %d threads\n",
+           COLOR_BLUE COLOR_BOLD, COLOR_RESET, positions.count, g.plies, g.variant_count, depth, threads);
+
+    // Deep searches, one position at a time on every thread; the table is
+    // shared, so a position also profits from the ones searched before it
+    BookEntry *entries = calloc(positions.count ? positions.count : 1, sizeof(BookEntry));
+    EngineTable table;
+    if (!entries || engine_table_init(&table, 64) != 0)
+    {
+        fprintf(stderr, "%s[error]%s Out of memory\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+        return EXIT_FAILURE;
+    }
+    EngineParams params;
+    engine_default_params(&params);
+    params.depth = depth;
+    long long start = monotonic_ms();
+    long long nodes = 0;
+    for (size_t i = 0; i < positions.count; i++)
+    {
+        EngineStats stats = {0};
+        int best;
+        int score = engine_search_parallel(&positions.items[i].board, &params, &table, threads, &stats, &best);
+        nodes += stats.nodes;
+        BookEntry *e = &entries[i];
+        e->key = positions.items[i].key;
+        e->best_move = (uint8_t)best;
+        e->depth = (uint8_t)depth;
+        e->score = (int16_t)(score >= BOOK_SCORE_WIN ? BOOK_SCORE_WIN : (score <= -BOOK_SCORE_WIN ? -BOOK_SCORE_WIN : score));
+        if ((i + 1) % 256 == 0)
+            printf("%s[book]%s searched %zu/%zu\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, i + 1, positions.count);
+    }
+    engine_table_free(&table);
+    double search_s = (monotonic_ms() - start) / 1000.0;
+    printf("%s[book]%s searches done in %.1fs (%lld nodes)\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET, search_s, nodes);
+
+    // Self-play statistics (entries are in key order, like positions)
+    if (games > 0)
+    {
+        engine_default_params(&g.params);
+        g.params.depth = game_depth;
+        g.keys = malloc((size_t)games * (g.plies + 1) * sizeof(uint64_t));
+        g.movers = malloc((size_t)games * (g.plies + 1));
+        g.winner = malloc((size_t)games);
+        if (!g.keys || !g.movers || !g.winner)
+        {
+            fprintf(stderr, "%s[error]%s Out of memory\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+            return EXIT_FAILURE;
+        }
+        start = monotonic_ms();
+        if (pool_run(threads, games, play_game, &g) != 0)
+        {
+            fprintf(stderr, "%s[error]%s Could not start worker threads\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+            return EXIT_FAILURE;
+        }
+        for (int game = 0; game < games; game++)
+        {
+            for (int ply = 0; ply <= g.plies; ply++)
+            {
+                size_t at = (size_t)game * (g.plies + 1) + ply;
+                if (g.movers[at] < 0)
+                    break;
+                BookEntry *e = bsearch(&g.keys[at], entries, positions.count, sizeof(BookEntry), compare_key_entry);
+                if (!e || e->games == UINT16_MAX)
+                    continue;
+                e->games++;
+                e->wins += g.winner[game] == g.movers[at];
+            }
+        }
+        printf("%s[book]%s %d self-play games in %.1fs\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET, games, (monotonic_ms() - start) / 1000.0);
+    }
+
+    if (book_write(out, entries, positions.count) != 0)
+    {
+        fprintf(stderr, "%s[error]%s Cannot write %s: %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, out, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    printf("%s[book]%s wrote %zu entries (%zu bytes) to %s\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET,
+           positions.count, positions.count * sizeof(BookEntry), out);
+
+    free(entries);
+    free(positions.items);
+    free(g.keys);
+    free(g.movers);
+    free(g.winner);
+    return EXIT_SUCCESS;
+}
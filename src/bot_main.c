@@ -0,0 +1,258 @@
+#include "client/bot.h"
+#include "utils/constants.h"
+#include "utils/clock.h"
+#include "protocol/protocol.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Soak test: many random-move bots on one thread, paired by the server's
+ * matchmaking queue, until a number of games has been played.
+ */
+
+typedef struct
+{
+   unsigned int rng;
+   int retries;           // invalid moves sent for the current turn
+   long long move_sent;   // monotonic ms of the last move (0: none pending)
+   int move_ply;          // ply of the board the move was played on
+} Bot;
+
+typedef struct
+{
+   long long games; // game over messages (two per game)
+   long long moves;
+   long long rejected;
+   long long latency_total; // move -> next board, ms
+   long long latency_max;
+   long long latency_samples;
+} SoakStats;
+
+static SoakStats stats;
+
+static void display_help_menu(char *exec_name)
+{
+   printf("Usage: %s [--ip <address>] [--port <port>] [--bots <n>] [--games <n>] [--timeout <s>]\n", exec_name);
+   printf("Options:\n");
+   printf("  --ip <address>         Server IP address (default: %s)\n", SERVER_ADDR);
+   printf("  --port <port>          Server port number (default: %d)\n", SERVER_PORT);
+   printf("  --bots <n>             Number of concurrent bot sessions (default: 16)\n");
+   printf("  --games <n>            Stop after this many finished games (default: 32)\n");
+   printf("  --timeout <s>          Give up after this many seconds (default: 60)\n");
+   printf("  --help                 Show this help message\n");
+}
+
+static unsigned int next_random(Bot *bot)
+{
+   /* xorshift32 */
+   unsigned int x = bot->rng;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   bot->rng = x;
+   return x;
+}
+
+/* Pick a random non-empty pit, preferring moves that feed an empty opponent */
+static int choose_move(Bot *bot, const BoardState *b)
+{
+   int first = b->seat * PITS_PER_PLAYER;
+   int opponent_first = (1 - b->seat) * PITS_PER_PLAYER;
+   int opponent_seeds = 0;
+   for (int i = 0; i < PITS_PER_PLAYER; i++)
+      opponent_seeds += b->pits[opponent_first + i];
+
+   int candidates[PITS_PER_PLAYER];
+   int count = 0;
+   for (int i = 0; i < PITS_PER_PLAYER; i++)
+   {
+      int seeds = b->pits[first + i];
+      if (seeds == 0)
+         continue;
+      if (opponent_seeds == 0 && seeds < PITS_PER_PLAYER - i)
+         continue;
+      candidates[count++] = first + i;
+   }
+   if (count == 0)
+   {
+      for (int i = 0; i < PITS_PER_PLAYER; i++)
+      {
+         if (b->pits[first + i] > 0)
+            candidates[count++] = first + i;
+      }
+   }
+   if (count == 0)
+      return first;
+   return candidates[next_random(bot) % count];
+}
+
+static void play(BotSession *s, const BoardState *board)
+{
+   Bot *bot = s->user;
+   int pit = choose_move(bot, board);
+   bot->move_sent = monotonic_ms();
+   bot->move_ply = board->ply;
+   bot_send(s, "%s %d", CMD_MOVE, pit);
+   stats.moves++;
+}
+
+static void on_connect(BotSession *s)
+{
+   bot_send(s, "%s", CMD_QUEUE);
+}
+
+static void on_board(BotSession *s, const BoardState *board)
+{
+   Bot *bot = s->user;
+   if (bot->move_sent && board->ply > bot->move_ply)
+   {
+      long long latency = monotonic_ms() - bot->move_sent;
+      stats.latency_total += latency;
+      stats.latency_samples++;
+      if (latency > stats.latency_max)
+         stats.latency_max = latency;
+      bot->move_sent = 0;
+   }
+}
+
+static void on_turn(BotSession *s, const BoardState *board)
+{
+   Bot *bot = s->user;
+   bot->retries = 0;
+   play(s, board);
+}
+
+static void on_game_over(BotSession *s, const char *text)
+{
+   (void)text;
+   Bot *bot = s->user;
+   bot->move_sent = 0;
+   stats.games++;
+   bot_send(s, "%s", CMD_QUEUE);
+}
+
+static void on_message(BotSession *s, MessageType type, const char *payload)
+{
+   Bot *bot = s->user;
+   (void)payload;
+   /* a rejected move: try another one while it is still our turn */
+   if (type == MSG_ERROR && s->in_match && s->board.current_player == s->board.seat && bot->move_sent)
+   {
+      stats.rejected++;
+      if (bot->retries++ < TOTAL_PITS)
+         play(s, &s->board);
+   }
+}
+
+static void on_close(BotSession *s)
+{
+   fprintf(stderr, "%s[bot]%s %s lost its connection\n", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, s->name);
+}
+
+static int parse_int_option(int argc, char **argv, int *i, int *out)
+{
+   if (*i + 1 >= argc)
+   {
+      fprintf(stderr, "%s[error]%s %s requires an argument\n", COLOR_RED COLOR_BOLD, COLOR_RESET, argv[*i]);
+      return 0;
+   }
+   *out = atoi(argv[++(*i)]);
+   return 1;
+}
+
+int main(int argc, char **argv)
+{
+   const char *address = SERVER_ADDR;
+   int port = SERVER_PORT;
+   int bot_count = 16;
+   int games = 32;
+   int timeout_s = 60;
+
+   for (int i = 1; i < argc; i++)
+   {
+      int ok = 1;
+      if (strcmp(argv[i], "--ip") == 0 && i + 1 < argc)
+         address = argv[++i];
+      else if (strcmp(argv[i], "--port") == 0)
+         ok = parse_int_option(argc, argv, &i, &port);
+      else if (strcmp(argv[i], "--bots") == 0)
+         ok = parse_int_option(argc, argv, &i, &bot_count);
+      else if (strcmp(argv[i], "--games") == 0)
+         ok = parse_int_option(argc, argv, &i, &games);
+      else if (strcmp(argv[i], "--timeout") == 0)
+         ok = parse_int_option(argc, argv, &i, &timeout_s);
+      else if (strcmp(argv[i], "--help") == 0)
+      {
+         display_help_menu(argv[0]);
+         return EXIT_SUCCESS;
+      }
+      else
+      {
+         fprintf(stderr, "%s[error]%s Unknown argument: %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, argv[i]);
+         ok = 0;
+      }
+      if (!ok)
+      {
+         display_help_menu(argv[0]);
+         return EXIT_FAILURE;
+      }
+   }
+   if (bot_count < 2 || port <= 0 || port > 65535)
+   {
+      fprintf(stderr, "%s[error]%s Need at least 2 bots and a valid port\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+      return EXIT_FAILURE;
+   }
+
+   static const BotCallbacks callbacks = {on_connect, on_board, on_turn, on_game_over, on_message, on_close};
+   BotSession *sessions = calloc(bot_count, sizeof(BotSession));
+   Bot *bots = calloc(bot_count, sizeof(Bot));
+   if (!sessions || !bots)
+   {
+      fprintf(stderr, "%s[error]%s Out of memory\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+      return EXIT_FAILURE;
+   }
+
+   long long start = monotonic_ms();
+   for (int i = 0; i < bot_count; i++)
+   {
+      char name[MAX_USERNAME_LEN];
+      snprintf(name, sizeof(name), "bot%d_%lld", i, start % 100000);
+      bots[i].rng = 2463534242u + (unsigned int)i * 7919u;
+      bot_open(&sessions[i], address, port, name, &callbacks, &bots[i]);
+   }
+
+   long long deadline = start + (long long)timeout_s * 1000;
+   int open = bot_count;
+   while (open > 0 && stats.games / 2 < games && monotonic_ms() < deadline)
+   {
+      open = bot_poll(sessions, bot_count, 100);
+   }
+   long long elapsed = monotonic_ms() - start;
+
+   long long frames = 0;
+   long long commands = 0;
+   long long bytes = 0;
+   long long resyncs = 0;
+   for (int i = 0; i < bot_count; i++)
+   {
+      frames += sessions[i].frames_received;
+      commands += sessions[i].commands_sent;
+      bytes += sessions[i].bytes_received;
+      resyncs += sessions[i].resyncs;
+      bot_close(&sessions[i]);
+   }
+   double seconds = elapsed > 0 ? elapsed / 1000.0 : 0.001;
+   printf("%s[soak]%s %d bots, %lld games, %lld moves (%lld rejected) in %.2fs\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET,
+          bot_count, stats.games / 2, stats.moves, stats.rejected, seconds);
+   printf("%s[soak]%s %.0f moves/s, %.0f frames/s, %lld commands sent\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET,
+          stats.moves / seconds, frames / seconds, commands);
+   printf("%s[soak]%s %.1f KB received (%.0f bytes per move), %lld board resyncs\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET,
+          bytes / 1024.0, stats.moves > 0 ? (double)bytes / stats.moves : 0.0, resyncs);
+   if (stats.latency_samples > 0)
+      printf("%s[soak]%s move latency avg %.2f ms, max %lld ms\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET,
+             (double)stats.latency_total / stats.latency_samples, stats.latency_max);
+   free(sessions);
+   free(bots);
+   return stats.games / 2 >= games ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <netdb.h>
+#include "bot.h"
+#include "../utils/constants.h"
+
+/* Make sure buf can hold `need` bytes, doubling its capacity */
+static int reserve(char **buf, size_t *cap, size_t need)
+{
+    if (need <= *cap)
+        return 0;
+    size_t size = *cap ? *cap : BUF_SIZE;
+    while (size < need)
+        size *= 2;
+    char *grown = realloc(*buf, size);
+    if (!grown)
+        return -1;
+    *buf = grown;
+    *cap = size;
+    return 0;
+}
+
+static void session_closed(BotSession *s)
+{
+    if (s->state == BOT_CLOSED)
+        return;
+    bot_close(s);
+    if (s->callbacks && s->callbacks->on_close)
+        s->callbacks->on_close(s);
+}
+
+int bot_open(BotSession *s, const char *address, int port, const char *name, const BotCallbacks *callbacks, void *user)
+{
+    memset(s, 0, sizeof(*s));
+    s->sock = INVALID_SOCKET;
+    s->state = BOT_CLOSED;
+    s->callbacks = callbacks;
+    s->user = user;
+    strncpy(s->name, name, MAX_USERNAME_LEN - 1);
+
+    struct hostent *hostinfo = gethostbyname(address);
+    if (hostinfo == NULL)
+    {
+        fprintf(stderr, "Unknown host %s.\n", address);
+        return -1;
+    }
+    SOCKADDR_IN sin = {0};
+    sin.sin_addr = *(IN_ADDR *)hostinfo->h_addr;
+    sin.sin_port = htons(port);
+    sin.sin_family = AF_INET;
+
+    s->sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (s->sock == INVALID_SOCKET)
+    {
+        perror("socket()");
+        return -1;
+    }
+    fcntl(s->sock, F_SETFL, fcntl(s->sock, F_GETFL, 0) | O_NONBLOCK);
+    /* commands are tiny and latency matters more than packet count */
+    int one = 1;
+    setsockopt(s->sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(s->sock, (SOCKADDR *)&sin, sizeof(sin)) == SOCKET_ERROR && errno != EINPROGRESS)
+    {
+        perror("connect()");
+        close(s->sock);
+        s->sock = INVALID_SOCKET;
+        return -1;
+    }
+    s->state = BOT_CONNECTING;
+
+    /* the server reads the name first; the board format request rides behind it */
+    bot_send(s, "%s", s->name);
+    bot_send(s, "%s delta", CMD_BOARD);
+    return 0;
+}
+
+int bot_send(BotSession *s, const char *fmt, ...)
+{
+    if (s->state == BOT_CLOSED)
+        return -1;
+    char line[BUF_SIZE];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line) - 1, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return -1;
+    if (n > (int)sizeof(line) - 2)
+        n = sizeof(line) - 2;
+    line[n++] = '\n';
+    if (reserve(&s->out, &s->out_cap, s->out_len + n) < 0)
+        return -1;
+    memcpy(s->out + s->out_len, line, n);
+    s->out_len += n;
+    s->commands_sent++;
+    return 0;
+}
+
+void bot_close(BotSession *s)
+{
+    if (s->sock != INVALID_SOCKET)
+        close(s->sock);
+    s->sock = INVALID_SOCKET;
+    s->state = BOT_CLOSED;
+    free(s->out);
+    free(s->in);
+    s->out = s->in = NULL;
+    s->out_len = s->out_cap = 0;
+    s->in_len = s->in_cap = 0;
+}
+
+static void flush_output(BotSession *s)
+{
+    size_t sent = 0;
+    while (sent < s->out_len)
+    {
+        ssize_t n = send(s->sock, s->out + sent, s->out_len - sent, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            session_closed(s);
+            return;
+        }
+        sent += (size_t)n;
+    }
+    memmove(s->out, s->out + sent, s->out_len - sent);
+    s->out_len -= sent;
+}
+
+/* Route one "TYPE|payload" message to the callbacks */
+static void dispatch_frame(BotSession *s, char *message)
+{
+    char *pipe = strchr(message, '|');
+    if (!pipe || pipe - message > 3)
+        return;
+    MessageType type = (MessageType)atoi(message);
+    const char *payload = pipe + 1;
+    const BotCallbacks *cb = s->callbacks;
+    s->frames_received++;
+
+    switch (type)
+    {
+    case MSG_CONNECT_ACK:
+        s->state = BOT_READY;
+        if (cb && cb->on_connect)
+            cb->on_connect(s);
+        break;
+    case MSG_BOARD_STATE:
+    case MSG_BOARD_DELTA:
+        if (type == MSG_BOARD_STATE)
+        {
+            if (!protocol_parse_board(payload, &s->board))
+                break;
+            s->in_match = s->board.seat >= 0;
+        }
+        else
+        {
+            BoardDelta delta;
+            if (!protocol_parse_delta(payload, &delta))
+                break;
+            if (!protocol_apply_delta(&s->board, &delta))
+            {
+                /* missed a move (or never got the keyframe): ask for one */
+                s->resyncs++;
+                bot_send(s, "%s %d", CMD_SYNC, delta.match_id);
+                break;
+            }
+        }
+        if (cb && cb->on_board)
+            cb->on_board(s, &s->board);
+        if (s->in_match && s->board.current_player == s->board.seat && cb && cb->on_turn)
+            cb->on_turn(s, &s->board);
+        break;
+    case MSG_GAME_OVER:
+        s->in_match = 0;
+        if (cb && cb->on_game_over)
+            cb->on_game_over(s, payload);
+        break;
+    default:
+        /* an error before the ack means the name was refused */
+        if (type == MSG_ERROR && s->state == BOT_HANDSHAKE)
+        {
+            fprintf(stderr, "%s: %s\n", s->name, payload);
+            session_closed(s);
+            return;
+        }
+        if (cb && cb->on_message)
+            cb->on_message(s, type, payload);
+        break;
+    }
+}
+
+static void read_input(BotSession *s)
+{
+    for (;;)
+    {
+        if (reserve(&s->in, &s->in_cap, s->in_len + BUF_SIZE) < 0)
+        {
+            session_closed(s);
+            return;
+        }
+        ssize_t n = recv(s->sock, s->in + s->in_len, s->in_cap - s->in_len, 0);
+        if (n == 0)
+        {
+            session_closed(s);
+            return;
+        }
+        if (n < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                session_closed(s);
+            break;
+        }
+        s->in_len += (size_t)n;
+        s->bytes_received += n;
+    }
+
+    /* split [size_t length][message] frames */
+    size_t off = 0;
+    while (s->state != BOT_CLOSED && s->in_len - off >= sizeof(size_t))
+    {
+        size_t len;
+        memcpy(&len, s->in + off, sizeof(size_t));
+        if (len > MAX_FRAME_SIZE)
+        {
+            fprintf(stderr, "%s: frame too large (%zu)\n", s->name, len);
+            session_closed(s);
+            return;
+        }
+        if (s->in_len - off - sizeof(size_t) < len)
+            break;
+        char *message = s->in + off + sizeof(size_t);
+        /* terminate in place; the byte belongs to the next frame, restore it */
+        char saved = message[len];
+        message[len] = '\0';
+        dispatch_frame(s, message);
+        if (s->state == BOT_CLOSED)
+            return;
+        message[len] = saved;
+        off += sizeof(size_t) + len;
+    }
+    memmove(s->in, s->in + off, s->in_len - off);
+    s->in_len -= off;
+}
+
+int bot_poll(BotSession *sessions, int count, int timeout_ms)
+{
+    struct pollfd *fds = malloc(sizeof(struct pollfd) * (count > 0 ? count : 1));
+    if (!fds)
+        return -1;
+    for (int i = 0; i < count; i++)
+    {
+        BotSession *s = &sessions[i];
+        fds[i].fd = s->state == BOT_CLOSED ? -1 : s->sock; // poll() skips negative fds
+        fds[i].events = POLLIN;
+        if (s->state == BOT_CONNECTING || s->out_len > 0)
+            fds[i].events |= POLLOUT;
+        fds[i].revents = 0;
+    }
+
+    int ready = poll(fds, count, timeout_ms);
+    if (ready < 0 && errno != EINTR)
+        perror("poll()");
+
+    int open = 0;
+    for (int i = 0; ready > 0 && i < count; i++)
+    {
+        BotSession *s = &sessions[i];
+        if (fds[i].revents == 0 || s->state == BOT_CLOSED)
+            continue;
+        if (s->state == BOT_CONNECTING && (fds[i].revents & (POLLOUT | POLLERR | POLLHUP)))
+        {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(s->sock, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err != 0)
+            {
+                fprintf(stderr, "%s: connect: %s\n", s->name, strerror(err));
+                session_closed(s);
+                continue;
+            }
+            s->state = BOT_HANDSHAKE;
+        }
+        if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+            read_input(s);
+        if (s->state != BOT_CLOSED && s->out_len > 0)
+            flush_output(s);
+    }
+    /* commands queued by callbacks go out without waiting for the next round */
+    for (int i = 0; i < count; i++)
+    {
+        BotSession *s = &sessions[i];
+        if (s->state != BOT_CLOSED && s->state != BOT_CONNECTING && s->out_len > 0)
+            flush_output(s);
+        if (s->state != BOT_CLOSED)
+            open++;
+    }
+    free(fds);
+    return open;
+}
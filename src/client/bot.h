@@ -0,0 +1,76 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include <stddef.h>
+#include "../protocol/protocol.h"
+
+/*
+ * BOT CLIENT LIBRARY
+ * ==================
+ * Non-blocking client sessions for automated players and soak tests.
+ * Commands are queued with bot_send() and written as soon as the socket
+ * accepts them (they are pipelined: nobody waits for a reply), and
+ * bot_poll() drives any number of sessions from a single thread, calling
+ * back into the bot for every message received. Boards are requested in
+ * structured form ("board data") so bots never parse the ANSI rendering.
+ */
+
+typedef struct BotSession BotSession;
+
+typedef struct
+{
+    void (*on_connect)(BotSession *s);                                  // name accepted by the server
+    void (*on_board)(BotSession *s, const BoardState *board);           // every board received
+    void (*on_turn)(BotSession *s, const BoardState *board);            // board where this bot is to move
+    void (*on_game_over)(BotSession *s, const char *text);              // end of the current game
+    void (*on_message)(BotSession *s, MessageType type, const char *payload); // anything else
+    void (*on_close)(BotSession *s);                                    // connection gone
+} BotCallbacks;
+
+typedef enum
+{
+    BOT_CONNECTING, // TCP connect in progress
+    BOT_HANDSHAKE,  // name sent, waiting for MSG_CONNECT_ACK
+    BOT_READY,
+    BOT_CLOSED
+} BotState;
+
+struct BotSession
+{
+    int sock;
+    BotState state;
+    char name[MAX_USERNAME_LEN];
+    const BotCallbacks *callbacks; // any callback may be NULL
+    void *user;                    // free for the bot's own state
+    BoardState board;              // last board received
+    int in_match;
+    // queued commands not yet accepted by the socket
+    char *out;
+    size_t out_len;
+    size_t out_cap;
+    // received bytes not yet forming a complete frame
+    char *in;
+    size_t in_len;
+    size_t in_cap;
+    // counters
+    long long commands_sent;
+    long long frames_received;
+    long long bytes_received;
+    long long resyncs; // keyframes requested after a gap in the board deltas
+};
+
+/* Start connecting a session; the name and "board delta" are queued at once.
+ * Returns 0 on success, -1 on error (the session is then BOT_CLOSED). */
+int bot_open(BotSession *s, const char *address, int port, const char *name, const BotCallbacks *callbacks, void *user);
+
+/* Queue one command (the '\n' terminator is added). Returns -1 if closed. */
+int bot_send(BotSession *s, const char *fmt, ...);
+
+/* Wait up to timeout_ms for activity on any session, then flush queued
+ * commands, read what arrived and run the callbacks. Returns the number of
+ * sessions still open. */
+int bot_poll(BotSession *sessions, int count, int timeout_ms);
+
+void bot_close(BotSession *s);
+
+#endif
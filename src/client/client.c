@@ -54,20 +54,20 @@ int read_from_server(int sock, char *buffer)
     size_t len = 0;
 
     /* Receive message length */
-    if (recv(sock, (char *)&len, sizeof(len), 0) < 0)
+    if (recv(sock, (char *)&len, sizeof(len), MSG_WAITALL) < 0)
     {
         perror("recv() - length");
         return -1;
     }
 
-    if (len > BUF_SIZE - 1)
+    if (len > MAX_FRAME_SIZE - 1)
     {
         fprintf(stderr, "Message too large: %zu\n", len);
         return -1;
     }
 
-    /* Receive actual message */
-    int n = recv(sock, buffer, len, 0);
+    /* Receive actual message (frames can span several TCP segments) */
+    int n = recv(sock, buffer, len, MSG_WAITALL);
     if (n < 0)
     {
         perror("recv() - message");
@@ -87,7 +87,15 @@ void write_to_server(int sock, const char *buffer)
 #ifdef DEBUG
     printf("%s%s[send]%s%s %s%s\n", STYLE_DIM, COLOR_BOLD, COLOR_RESET, STYLE_DIM, buffer, COLOR_RESET);
 #endif
-    if (send(sock, buffer, strlen(buffer), 0) < 0)
+    /* commands are newline terminated */
+    char line[BUF_SIZE + 1];
+    int len = snprintf(line, sizeof(line), "%s\n", buffer);
+    if (len >= (int)sizeof(line))
+    {
+        len = sizeof(line) - 1;
+        line[len - 1] = '\n';
+    }
+    if (send(sock, line, len, 0) < 0)
     {
         perror("send()");
         exit(errno);
@@ -213,6 +221,10 @@ void process_command(int sock, const char *input)
     {
         write_to_server(sock, CMD_GAMES);
     }
+    else if (strcmp(command, CMD_RESUME) == 0)
+    {
+        write_to_server(sock, CMD_RESUME);
+    }
     else if (strcmp(command, CMD_WATCH) == 0)
     {
         if (args == NULL || strlen(args) == 0)
@@ -235,6 +247,17 @@ void process_command(int sock, const char *input)
         snprintf(unwatch_cmd, BUF_SIZE, "%s %s", CMD_UNWATCH, args);
         write_to_server(sock, unwatch_cmd);
     }
+    else if (strcmp(command, CMD_ANALYZE) == 0)
+    {
+        if (args == NULL || strlen(args) == 0)
+        {
+            printf("%s[error]%s Usage: analyze <matchId>\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+            return;
+        }
+        char analyze_cmd[BUF_SIZE];
+        snprintf(analyze_cmd, BUF_SIZE, "%s %s", CMD_ANALYZE, args);
+        write_to_server(sock, analyze_cmd);
+    }
     else if (strcmp(command, CMD_PM) == 0)
     {
         if (args == NULL || strlen(args) == 0 || strchr(args, ' ') == NULL)
@@ -298,35 +321,103 @@ void process_command(int sock, const char *input)
     {
         write_to_server(sock, CMD_RANKING);
     }
+    else if (strcmp(command, CMD_QUEUE) == 0)
+    {
+        write_to_server(sock, CMD_QUEUE);
+    }
+    else if (strcmp(command, CMD_UNQUEUE) == 0)
+    {
+        write_to_server(sock, CMD_UNQUEUE);
+    }
+    else if (strcmp(command, CMD_VARIANT) == 0)
+    {
+        char cmd[BUF_SIZE];
+        if (args == NULL || strlen(args) == 0)
+            snprintf(cmd, BUF_SIZE, "%s", CMD_VARIANT);
+        else
+            snprintf(cmd, BUF_SIZE, "%s %s", CMD_VARIANT, args);
+        write_to_server(sock, cmd);
+    }
     else if (strcmp(command, CMD_WATCH_REPLAY) == 0)
     {
         if (args == NULL || strlen(args) == 0)
         {
-            printf("%s[error]%s Usage: watchreplay <matchId>\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+            printf("%s[error]%s Usage: watchreplay <matchId> [ms per move]\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
             return;
         }
         char cmd[BUF_SIZE];
         snprintf(cmd, BUF_SIZE, "%s %s", CMD_WATCH_REPLAY, args);
         write_to_server(sock, cmd);
     }
+    else if (strcmp(command, CMD_SEEK) == 0 || strcmp(command, CMD_SPEED) == 0)
+    {
+        if (args == NULL || strlen(args) == 0)
+        {
+            printf("%s[error]%s Usage: %s <%s>\n", COLOR_RED COLOR_BOLD, COLOR_RESET, command,
+                   strcmp(command, CMD_SEEK) == 0 ? "ply" : "ms per move");
+            return;
+        }
+        char cmd[BUF_SIZE];
+        snprintf(cmd, BUF_SIZE, "%s %s", strcmp(command, CMD_SEEK) == 0 ? CMD_SEEK : CMD_SPEED, args);
+        write_to_server(sock, cmd);
+    }
+    else if (strcmp(command, CMD_STOP_REPLAY) == 0)
+    {
+        write_to_server(sock, CMD_STOP_REPLAY);
+    }
+    else if (strcmp(command, CMD_JOIN) == 0)
+    {
+        char cmd[BUF_SIZE];
+        if (args == NULL || strlen(args) == 0)
+            snprintf(cmd, BUF_SIZE, "%s", CMD_JOIN);
+        else
+            snprintf(cmd, BUF_SIZE, "%s %s", CMD_JOIN, args);
+        write_to_server(sock, cmd);
+    }
+    else if (strcmp(command, CMD_ROOMS) == 0)
+    {
+        write_to_server(sock, CMD_ROOMS);
+    }
+    else if (strcmp(command, CMD_HISTORY) == 0)
+    {
+        if (args == NULL || strlen(args) == 0)
+        {
+            printf("%s[error]%s Usage: history <user> [count]\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+            return;
+        }
+        char cmd[BUF_SIZE];
+        snprintf(cmd, BUF_SIZE, "%s %s", CMD_HISTORY, args);
+        write_to_server(sock, cmd);
+    }
     else if (strcmp(command, "help") == 0)
     {
         printf("%s[help]%s Available commands:\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET);
-        printf("    msg <message>      - Send a message to all users\n");
-        printf("    list               - Show all online users and their bios\n");
+        printf("    msg <message>      - Send a message to your room\n");
+        printf("    list               - Show the users of your room and their bios\n");
+        printf("    join [room]        - Move to a chat room (no name: the lobby)\n");
+        printf("    rooms              - List the chat rooms\n");
         printf("    challenge <user>   - Challenge a user to a game\n");
         printf("    accept <user>      - Accept a challenge from a user\n");
         printf("    refuse <user>      - Refuse a challenge from a user\n");
         printf("    cancel <user>      - Cancel your pending challenge\n");
+        printf("    queue              - Join matchmaking (paired by rating)\n");
+        printf("    unqueue            - Leave the matchmaking queue\n");
+        printf("    variant [name]     - Show or pick the rules of your games\n");
         printf("    bio <text>         - Set your bio (max 256 characters)\n");
         printf("    pm <user> <msg>    - Send a private message\n");
         printf("    getbio <user>      - Get a user's bio\n");
         printf("    move <pit>         - Make a move (in game)\n");
         printf("    quit               - Quit current game\n");
+        printf("    resume             - Rejoin your game after a server restart\n");
         printf("    games              - List running games\n");
+        printf("    history <user> [n] - A user's last finished games\n");
         printf("    watch <id>         - Spectate a running game\n");
         printf("    unwatch <id>       - Stop spectating a game\n");
-        printf("    watchreplay <id>   - Watch a finished game's replay (5s per move)\n");
+        printf("    analyze <id>       - Best move and evaluation of a game\n");
+        printf("    watchreplay <id> [ms] - Replay a game (default one move per second)\n");
+        printf("    seek <ply>         - Jump the replay to a move\n");
+        printf("    speed <ms>         - Change the replay pace\n");
+        printf("    stopreplay         - Stop the replay\n");
         printf("    addfriend <user>   - Send friend request\n");
         printf("    acceptfriend <u>   - Accept friend request\n");
         printf("    refusefriend <u>   - Refuse friend request\n");
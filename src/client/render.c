@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <string.h>
+#include "render.h"
+#include "../utils/constants.h"
+
+static BoardState views[RENDER_MAX_BOARDS];
+static int view_count = 0;
+
+/* The board drawn once with "##" in place of each number. A render copies
+ * it and writes the 14 numbers (2 characters each) at offsets found on the
+ * first call: no formatting, no allocation. */
+#define RENDER_NUMBER "##"
+#define RENDER_PIT(color) color "[" RENDER_NUMBER "]" COLOR_RESET
+#define RENDER_LABEL(n) STYLE_DIM " " n " " COLOR_RESET
+#define RENDER_RULE STYLE_DIM "=====================================" COLOR_RESET "\n"
+
+static const char board_template[] =
+    "\n" RENDER_RULE
+    COLOR_BOLD COLOR_YELLOW "Player 2:" COLOR_RESET " " COLOR_BOLD COLOR_YELLOW RENDER_NUMBER COLOR_RESET "           " STYLE_DIM "<-- Direction" COLOR_RESET "\n"
+    "     " RENDER_PIT(COLOR_BOLD COLOR_GREEN) RENDER_PIT(COLOR_BOLD COLOR_GREEN) RENDER_PIT(COLOR_BOLD COLOR_GREEN)
+    RENDER_PIT(COLOR_BOLD COLOR_GREEN) RENDER_PIT(COLOR_BOLD COLOR_GREEN) RENDER_PIT(COLOR_BOLD COLOR_GREEN) "\n"
+    STYLE_DIM "Pit:  " COLOR_RESET RENDER_LABEL("11") RENDER_LABEL("10") RENDER_LABEL(" 9") RENDER_LABEL(" 8") RENDER_LABEL(" 7") RENDER_LABEL(" 6") "\n"
+    STYLE_DIM "     -------------------------" COLOR_RESET "\n"
+    STYLE_DIM "Pit:  " COLOR_RESET RENDER_LABEL(" 0") RENDER_LABEL(" 1") RENDER_LABEL(" 2") RENDER_LABEL(" 3") RENDER_LABEL(" 4") RENDER_LABEL(" 5") "\n"
+    "     " RENDER_PIT(COLOR_BOLD COLOR_RED) RENDER_PIT(COLOR_BOLD COLOR_RED) RENDER_PIT(COLOR_BOLD COLOR_RED)
+    RENDER_PIT(COLOR_BOLD COLOR_RED) RENDER_PIT(COLOR_BOLD COLOR_RED) RENDER_PIT(COLOR_BOLD COLOR_RED) "\n"
+    STYLE_DIM "Direction -->" COLOR_RESET "           " COLOR_BOLD COLOR_YELLOW "Player 1: " RENDER_NUMBER COLOR_RESET "\n"
+    RENDER_RULE;
+
+#define RENDER_SLOTS (TOTAL_PITS + 2)
+
+// "%2d" of 0..99, two characters each
+static const char digit_pairs[] =
+    " 0 1 2 3 4 5 6 7 8 910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Offset of each number in board_template, in the order they appear:
+// Player 2's score, pits 11..6, pits 0..5, Player 1's score
+static size_t slot_offsets[RENDER_SLOTS];
+static int slots_found = 0;
+
+static void find_slots(void)
+{
+    const char *p = board_template;
+    for (int slot = 0; slot < RENDER_SLOTS; slot++)
+    {
+        p = strstr(p, RENDER_NUMBER);
+        slot_offsets[slot] = (size_t)(p - board_template);
+        p += 2;
+    }
+    slots_found = 1;
+}
+
+static int slot_value(const BoardState *state, int slot)
+{
+    if (slot == 0)
+        return state->score[1];
+    if (slot <= PITS_PER_PLAYER)
+        return state->pits[TOTAL_PITS - slot];
+    if (slot <= TOTAL_PITS)
+        return state->pits[slot - PITS_PER_PLAYER - 1];
+    return state->score[0];
+}
+
+int render_board(const BoardState *state, char *out, size_t out_size)
+{
+    if (out == NULL || out_size == 0)
+        return 0;
+    if (!slots_found)
+        find_slots();
+    size_t len = sizeof(board_template) - 1;
+    if (len > out_size - 1)
+        len = out_size - 1; // cut, as snprintf would
+    memcpy(out, board_template, len);
+    out[len] = '\0';
+    for (int slot = 0; slot < RENDER_SLOTS; slot++)
+    {
+        size_t at = slot_offsets[slot];
+        if (at + 2 > len)
+            break;
+        int v = slot_value(state, slot);
+        if (v >= 0 && v < 100)
+            memcpy(out + at, digit_pairs + 2 * v, 2);
+        else
+            memcpy(out + at, "??", 2); // not a count of seeds: corrupt board
+    }
+    return (int)len;
+}
+
+int render_board_turn(const BoardState *state, char *out, size_t out_size)
+{
+    int off = render_board(state, out, out_size);
+    if ((size_t)off + 1 >= out_size)
+        return off;
+    int to_move = state->current_player == 1 ? 1 : 0;
+    int n;
+    if (state->seat < 0)
+        n = snprintf(out + off, out_size - off, "Turn: %s (Player %d)", state->players[to_move], to_move + 1);
+    else if (state->current_player == state->seat)
+        n = snprintf(out + off, out_size - off, "%s%sYour turn (Player %d)%s", COLOR_BLUE, COLOR_BOLD, state->seat + 1, COLOR_RESET);
+    else
+        n = snprintf(out + off, out_size - off, "%sWaiting...%s", STYLE_DIM, COLOR_RESET);
+    if (n < 0)
+        return off;
+    return (size_t)(off + n) < out_size ? off + n : (int)out_size - 1;
+}
+
+static BoardState *find_view(int match_id)
+{
+    for (int i = 0; i < view_count; i++)
+    {
+        if (views[i].match_id == match_id)
+            return &views[i];
+    }
+    return NULL;
+}
+
+BoardState *board_view_set(const BoardState *keyframe)
+{
+    BoardState *v = find_view(keyframe->match_id);
+    if (!v)
+    {
+        if (view_count == RENDER_MAX_BOARDS)
+        {
+            // forget the oldest match; a delta for it will ask for a keyframe
+            memmove(views, views + 1, (RENDER_MAX_BOARDS - 1) * sizeof(BoardState));
+            view_count--;
+        }
+        v = &views[view_count++];
+    }
+    *v = *keyframe;
+    return v;
+}
+
+BoardState *board_view_apply(const BoardDelta *delta)
+{
+    BoardState *v = find_view(delta->match_id);
+    if (!v || !protocol_apply_delta(v, delta))
+        return NULL;
+    return v;
+}
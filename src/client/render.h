@@ -0,0 +1,33 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stddef.h>
+#include "../protocol/protocol.h"
+
+/*
+ * BOARD RENDERING
+ * ===============
+ * The server sends boards as data only: a MSG_BOARD_STATE keyframe, then a
+ * MSG_BOARD_DELTA per move. The client keeps the board of every match it
+ * follows (its own, the ones it watches) up to date from them and draws it
+ * itself, so any front end can use the same data.
+ */
+
+#define RENDER_MAX_BOARDS 8 // matches followed at once (the oldest is dropped)
+
+/* Render the board into a buffer and return number of bytes written
+ * (excluding final null terminator). Colors mirror display_board. */
+int render_board(const BoardState *state, char *out, size_t out_size);
+
+/* render_board followed by whose turn it is, as seen from state->seat
+ * ("Your turn" / "Waiting..." for players, the mover's name for watchers) */
+int render_board_turn(const BoardState *state, char *out, size_t out_size);
+
+/* Remember a keyframe; returns the stored board */
+BoardState *board_view_set(const BoardState *keyframe);
+
+/* Bring the board of delta->match_id forward by one move; returns it, or
+ * NULL if the move does not follow the board held (ask for a keyframe) */
+BoardState *board_view_apply(const BoardDelta *delta);
+
+#endif
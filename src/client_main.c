@@ -1,4 +1,5 @@
 #include "client/client.h"
+#include "client/render.h"
 #include "utils/constants.h"
 #include "protocol/protocol.h"
 #include <stdlib.h>
@@ -14,11 +15,12 @@
 
 static void display_help_menu(char *exec_name)
 {
-   printf("Usage: %s --name <pseudo> [--ip <address>] [--port <port>]\n", exec_name);
+   printf("Usage: %s --name <pseudo> [--ip <address>] [--port <port>] [--token <token>]\n", exec_name);
    printf("Options:\n");
    printf("  --name <pseudo>        Username for the client (required)\n");
    printf("  --ip <address>         Server IP address (default: %s)\n", SERVER_ADDR);
    printf("  --port <port>          Server port number (default: %d)\n", SERVER_PORT);
+   printf("  --token <token>        Session token printed at connection: rejoin a dropped game\n");
    printf("  --help                 Show this help message\n");
 }
 
@@ -27,9 +29,10 @@ int main(int argc, char **argv)
    const char *address = SERVER_ADDR;
    int port = SERVER_PORT;
    const char *name = NULL;
+   const char *token = NULL;
 
    // Parse command-line arguments
-   // --name <pseudo> [--ip <address>] [--port <port>] [--help]
+   // --name <pseudo> [--ip <address>] [--port <port>] [--token <token>] [--help]
    // if ip not provided, use default SERVER_ADDR
    // if port not provided, use default SERVER_PORT
    for (int i = 1; i < argc; i++)
@@ -83,6 +86,20 @@ int main(int argc, char **argv)
             return EXIT_FAILURE;
          }
       }
+      else if (strcmp(argv[i], "--token") == 0)
+      {
+         if (i + 1 < argc)
+         {
+            token = argv[i + 1];
+            i++;
+         }
+         else
+         {
+            fprintf(stderr, "%s[error]%s --token requires an argument\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+            display_help_menu(argv[0]);
+            return EXIT_FAILURE;
+         }
+      }
       else if (strcmp(argv[i], "--help") == 0)
       {
          display_help_menu(argv[0]);
@@ -104,14 +121,21 @@ int main(int argc, char **argv)
    }
 
    int sock = init_connection(address, port);
-   char buffer[BUF_SIZE];
-   char payload[BUF_SIZE];
+   static char buffer[MAX_FRAME_SIZE];
+   static char payload[MAX_FRAME_SIZE];
+   static char board_txt[BUF_SIZE]; // boards are rendered here, from data
    MessageType msg_type;
 
    fd_set rdfs;
 
-   /* send our name */
-   write_to_server(sock, name);
+   /* send our name, and the token of the session to take back if we have one */
+   if (token)
+   {
+      snprintf(buffer, BUF_SIZE, "%s %s", name, token);
+      write_to_server(sock, buffer);
+   }
+   else
+      write_to_server(sock, name);
 
    /* Wait for connection acknowledgment */
    int n = read_from_server(sock, buffer);
@@ -120,6 +144,10 @@ int main(int argc, char **argv)
       if (msg_type == MSG_CONNECT_ACK)
       {
          printf("%s[connected]%s Connected to server as '%s'\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET, name);
+         /* payload: "<name> <token>" */
+         const char *session = strrchr(payload, ' ');
+         if (session)
+            printf("%s[session]%s If the connection drops, rejoin within %ds with --token %s\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, RECONNECT_GRACE_MS / 1000, session + 1);
          printf("%s[help]%s Type 'help' for available commands\n\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET);
       }
       else if (msg_type == MSG_ERROR)
@@ -190,7 +218,6 @@ int main(int argc, char **argv)
          }
 
          /* Parse server message */
-         char payload[BUF_SIZE];
          MessageType msg_type;
          if (protocol_parse_message(buffer, &msg_type, payload))
          {
@@ -221,9 +248,34 @@ int main(int argc, char **argv)
             case MSG_CHALLENGE_RESPONSE:
                printf("%s[challenge]%s %s\n", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, payload);
                break;
-            case MSG_BOARD_UPDATE:
-               printf("%s[board]%s%s\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, payload);
+            case MSG_BOARD_STATE:
+            {
+               BoardState state;
+               if (protocol_parse_board(payload, &state))
+               {
+                  render_board_turn(board_view_set(&state), board_txt, sizeof(board_txt));
+                  printf("%s[board]%s%s\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, board_txt);
+               }
+               break;
+            }
+            case MSG_BOARD_DELTA:
+            {
+               BoardDelta delta;
+               if (!protocol_parse_delta(payload, &delta))
+                  break;
+               const BoardState *state = board_view_apply(&delta);
+               if (!state)
+               {
+                  // missed a move: ask for the whole board
+                  char sync[32];
+                  snprintf(sync, sizeof(sync), "%s %d", CMD_SYNC, delta.match_id);
+                  write_to_server(sock, sync);
+                  break;
+               }
+               render_board_turn(state, board_txt, sizeof(board_txt));
+               printf("%s[board]%s%s\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, board_txt);
                break;
+            }
             case MSG_MOVE:
                printf("%s[move]%s %s\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET, payload);
                break;
@@ -242,10 +294,24 @@ int main(int argc, char **argv)
             case MSG_RANK_LIST:
                printf("%s[ranking]%s\n%s", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, payload);
                break;
+            case MSG_HISTORY:
+               printf("%s[history]%s\n%s", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, payload);
+               break;
             case MSG_REPLAY_DATA:
-               printf("%s[replay]%s\n%s\n", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, payload);
-               fflush(stdout);
-               sleep(5); // pace replay steps by 5 seconds between frames
+            {
+               // the position as a BoardState line, then a caption
+               BoardState state;
+               char *caption = strchr(payload, '\n');
+               if (caption)
+                  *caption++ = '\0';
+               if (!protocol_parse_board(payload, &state))
+                  break;
+               render_board(&state, board_txt, sizeof(board_txt));
+               printf("%s[replay]%s %s\n%s\n", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, caption ? caption : "", board_txt);
+               break;
+            }
+            case MSG_ANALYSIS:
+               printf("%s[analysis]%s %s\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, payload);
                break;
             case MSG_GAME_OVER:
                printf("%s[game]%s %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, payload);
@@ -1,16 +1,56 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include "awale.h"
 #include "../utils/constants.h"
 
+#define AWALE_VARIANT_INFO(id, name, seeds, min_capture, max_capture, grand_slam) \
+    {name, seeds, seeds * TOTAL_PITS / 2 + 1, min_capture, max_capture, grand_slam},
+static const VariantInfo variants[VARIANT_COUNT] = {AWALE_VARIANTS(AWALE_VARIANT_INFO)};
+#undef AWALE_VARIANT_INFO
+
+const VariantInfo *variant_info(int variant)
+{
+    if (variant < 0 || variant >= VARIANT_COUNT)
+        variant = VARIANT_ABAPA;
+    return &variants[variant];
+}
+
+int variant_by_name(const char *name)
+{
+    for (int v = 0; v < VARIANT_COUNT; v++)
+    {
+        if (strcmp(variants[v].name, name) == 0)
+            return v;
+    }
+    return -1;
+}
+
+void variant_list(char *out, size_t out_size)
+{
+    size_t off = 0;
+    out[0] = '\0';
+    for (int v = 0; v < VARIANT_COUNT && off < out_size; v++)
+        off += (size_t)snprintf(out + off, out_size - off, v ? ", %s" : "%s", variants[v].name);
+}
+
 // Initialize the board with starting position
 void init_board(Board *board)
 {
-    // Each pit starts with 4 seeds
+    init_board_variant(board, VARIANT_ABAPA);
+}
+
+void init_board_variant(Board *board, int variant)
+{
+    // the variant picks the move kernel: an unknown one plays standard rules
+    if (variant < 0 || variant >= VARIANT_COUNT)
+        variant = VARIANT_ABAPA;
+    board->variant = variant;
+    // Each pit starts with the variant's seeds (4 in the standard game)
     for (int i = 0; i < TOTAL_PITS; i++)
     {
-        board->pits[i] = INITIAL_SEEDS;
+        board->pits[i] = variant_info(variant)->seeds;
     }
     // No seeds captured yet
     board->score[0] = 0;
@@ -62,67 +102,6 @@ void display_board(const Board *board)
     printf("%s=====================================%s\n", STYLE_DIM, COLOR_RESET);
 }
 
-// Render the board to a provided buffer (similar to display_board but as text)
-int render_board(const Board *board, char *out, size_t out_size)
-{
-    if (out == NULL || out_size == 0)
-        return 0;
-    size_t off = 0;
-#define APPENDF(fmt, ...)                                                     \
-    do                                                                        \
-    {                                                                         \
-        if (off < out_size)                                                   \
-        {                                                                     \
-            int _n = snprintf(out + off, out_size - off, fmt, ##__VA_ARGS__); \
-            if (_n > 0)                                                       \
-                off += (size_t)_n;                                            \
-        }                                                                     \
-    } while (0)
-
-    APPENDF("\n");
-    APPENDF("%s=====================================%s\n", STYLE_DIM, COLOR_RESET);
-    APPENDF("%sPlayer 2:%s %s%2d%s           %s<-- Direction%s\n", COLOR_BOLD COLOR_YELLOW, COLOR_RESET, COLOR_BOLD COLOR_YELLOW, board->score[1], COLOR_RESET, STYLE_DIM, COLOR_RESET);
-    APPENDF("     ");
-    for (int i = TOTAL_PITS - 1; i >= PITS_PER_PLAYER; i--)
-    {
-        APPENDF("%s[%2d]%s", COLOR_BOLD COLOR_GREEN, board->pits[i], COLOR_RESET);
-    }
-    APPENDF("\n");
-
-    APPENDF("%sPit:  %s", STYLE_DIM, COLOR_RESET);
-    for (int i = TOTAL_PITS - 1; i >= PITS_PER_PLAYER; i--)
-    {
-        APPENDF("%s %2d %s", STYLE_DIM, i, COLOR_RESET);
-    }
-    APPENDF("\n");
-
-    APPENDF("%s     -------------------------%s\n", STYLE_DIM, COLOR_RESET);
-
-    APPENDF("%sPit:  %s", STYLE_DIM, COLOR_RESET);
-    for (int i = 0; i < PITS_PER_PLAYER; i++)
-    {
-        APPENDF("%s %2d %s", STYLE_DIM, i, COLOR_RESET);
-    }
-    APPENDF("\n");
-
-    APPENDF("     ");
-    for (int i = 0; i < PITS_PER_PLAYER; i++)
-    {
-        APPENDF("%s[%2d]%s", COLOR_BOLD COLOR_RED, board->pits[i], COLOR_RESET);
-    }
-    APPENDF("\n%sDirection -->%s           %sPlayer 1: %2d%s\n", STYLE_DIM, COLOR_RESET, COLOR_BOLD COLOR_YELLOW, board->score[0], COLOR_RESET);
-    APPENDF("%s=====================================%s\n", STYLE_DIM, COLOR_RESET);
-
-#undef APPENDF
-    if (off >= out_size)
-    {
-        // ensure null-termination in worst case
-        out[out_size - 1] = '\0';
-        return (int)(out_size - 1);
-    }
-    return (int)off;
-}
-
 // Check if a move is valid
 bool is_valid_move(const Board *board, int pit)
 {
@@ -204,78 +183,122 @@ bool move_gives_seeds_to_opponent(const Board *board, int pit)
     return false;
 }
 
-// Make a move and handle capturing
-void make_move(Board *board, int pit)
+// Capture backwards from `last`, the pit of the last seed. Only called
+// with constant rules, so every kernel gets its own copy of this code.
+static inline void capture(Board *board, int last, int min_capture, int max_capture, int grand_slam, bool verbose)
 {
-    int seeds = board->pits[pit];
-    board->pits[pit] = 0; // Empty the selected pit
-
-    int current_pit = pit;
-
-    // Sow seeds counter-clockwise
-    for (int i = 0; i < seeds; i++)
-    {
-        current_pit = (current_pit + 1) % TOTAL_PITS;
-        if (current_pit == pit)
-        {
-            current_pit = (current_pit + 1) % TOTAL_PITS; // Skip the starting pit
-        }
-        board->pits[current_pit]++;
-    }
-
-    // Check for capturing
     int player = board->current_player;
     int opponent = 1 - player;
     int opp_start = opponent * PITS_PER_PLAYER;
     int opp_end = opp_start + PITS_PER_PLAYER;
 
     // Only capture if last seed landed in opponent's territory
-    if (current_pit >= opp_start && current_pit < opp_end)
+    if (last < opp_start || last >= opp_end)
+        return;
+
+    // First, count how many seeds would be captured
+    int captured_total = 0;
+    int first = last;
+    while (first >= opp_start && board->pits[first] >= min_capture && board->pits[first] <= max_capture)
     {
-        // Capture backwards while conditions are met
-        int capture_pit = current_pit;
-        int captured_total = 0;
-
-        // First, count how many seeds would be captured
-        int temp_pit = capture_pit;
-        while (temp_pit >= opp_start && temp_pit < opp_end &&
-               (board->pits[temp_pit] == 2 || board->pits[temp_pit] == 3))
-        {
-            captured_total += board->pits[temp_pit];
-            temp_pit--;
-        }
+        captured_total += board->pits[first];
+        first--;
+    }
+    if (captured_total == 0)
+        return;
 
-        // Check if capturing would leave opponent with no seeds
+    // Without the grand slam rule, a capture of all the opponent's seeds is forfeited
+    if (!grand_slam)
+    {
         int opponent_remaining = 0;
         for (int i = opp_start; i < opp_end; i++)
         {
             opponent_remaining += board->pits[i];
         }
+        if (opponent_remaining - captured_total <= 0)
+            return;
+    }
 
-        // Only capture if opponent would still have seeds left
-        if (opponent_remaining - captured_total > 0)
-        {
-            while (capture_pit >= opp_start && capture_pit < opp_end &&
-                   (board->pits[capture_pit] == 2 || board->pits[capture_pit] == 3))
-            {
-                board->score[player] += board->pits[capture_pit];
-                printf("[CAPTURE] Player %d captures %d seeds from pit %d!\n",
-                       player + 1, board->pits[capture_pit], capture_pit);
-                board->pits[capture_pit] = 0;
-                capture_pit--;
-            }
-        }
+    for (int pit = last; pit > first; pit--)
+    {
+        board->score[player] += board->pits[pit];
+        if (verbose)
+            printf("[CAPTURE] Player %d captures %d seeds from pit %d!\n",
+                   player + 1, board->pits[pit], pit);
+        board->pits[pit] = 0;
     }
+}
 
-    // Switch player
-    board->current_player = opponent;
+// Sowing from `pit`: every other pit gets seeds / 11 plus one for the first
+// seeds % 11 pits after it (the starting pit is skipped), unrolled over the
+// 11 pits.
+#define SOW(d) board->pits[(d) < wrap ? pit + 1 + (d) : pit + (d) - (TOTAL_PITS - 1)] += laps + ((d) < rest)
+
+#define AWALE_KERNEL(id, name, seeds_per_pit, min_capture, max_capture, grand_slam)     \
+    static void play_move_##id(Board *board, int pit, bool verbose)                      \
+    {                                                                                    \
+        int seeds = board->pits[pit];                                                    \
+        int laps = seeds / (TOTAL_PITS - 1);                                             \
+        int rest = seeds % (TOTAL_PITS - 1);                                             \
+        int wrap = TOTAL_PITS - 1 - pit; /* pits after `pit` before index 0 */          \
+        board->pits[pit] = 0;                                                            \
+        SOW(0); SOW(1); SOW(2); SOW(3); SOW(4); SOW(5);                                  \
+        SOW(6); SOW(7); SOW(8); SOW(9); SOW(10);                                         \
+        int last = (pit + 1 + (seeds - 1) % (TOTAL_PITS - 1)) % TOTAL_PITS;              \
+        capture(board, last, min_capture, max_capture, grand_slam, verbose);             \
+        board->current_player = 1 - board->current_player;                              \
+    }
+AWALE_VARIANTS(AWALE_KERNEL)
+#undef AWALE_KERNEL
+#undef SOW
+
+#define AWALE_KERNEL_ENTRY(id, name, seeds, min_capture, max_capture, grand_slam) play_move_##id,
+static void (*const play_move_kernels[VARIANT_COUNT])(Board *, int, bool) = {AWALE_VARIANTS(AWALE_KERNEL_ENTRY)};
+#undef AWALE_KERNEL_ENTRY
+
+// Sow the seeds of `pit`, capture and pass the turn (verbose: print captures)
+static void play_move(Board *board, int pit, bool verbose)
+{
+    play_move_kernels[board->variant](board, pit, verbose);
+}
+
+// Make a move and handle capturing
+void make_move(Board *board, int pit)
+{
+    play_move(board, pit, true);
+}
+
+// Same as make_move without any output (engines, simulations)
+void apply_move(Board *board, int pit)
+{
+    play_move(board, pit, false);
+}
+
+// Legal moves of the side to move, in pit order; returns how many were stored
+int legal_moves(const Board *board, int moves[PITS_PER_PLAYER])
+{
+    int player = board->current_player;
+    int start_pit = player * PITS_PER_PLAYER;
+    bool must_feed = !opponent_has_seeds(board, player);
+    int count = 0;
+
+    for (int pit = start_pit; pit < start_pit + PITS_PER_PLAYER; pit++)
+    {
+        if (board->pits[pit] == 0)
+            continue;
+        if (must_feed && !move_gives_seeds_to_opponent(board, pit))
+            continue;
+        moves[count++] = pit;
+    }
+    return count;
 }
 
 // Check if game is over
 bool is_game_over(const Board *board)
 {
-    // Someone has won by capturing 25+ seeds
-    if (board->score[0] >= MIN_SEEDS_TO_WIN || board->score[1] >= MIN_SEEDS_TO_WIN)
+    // Someone has won by capturing more than half of the seeds (25+ in the standard game)
+    int win_seeds = variant_info(board->variant)->win_seeds;
+    if (board->score[0] >= win_seeds || board->score[1] >= win_seeds)
     {
         return true;
     }
@@ -13,6 +13,11 @@
  * 8. If opponent has no seeds, you must give them seeds if possible (if it not possible player having the seeds takes all the seeds)
  * 9. Game ends when one player captures 25+ seeds or no more moves possible
  * 10. Player with most seeds wins
+ *
+ * VARIANTS: the seeds per pit, the capture window (rule 5) and rule 7 vary
+ * between rule sets. Each entry of AWALE_VARIANTS gets its own move kernel
+ * with those values compiled in; a Board only carries the variant tag that
+ * picks the kernel. The 6 pits per side are common to all of them.
  */
 
 #ifndef AWALE_H
@@ -22,23 +27,64 @@
 #include <stddef.h>
 #include "../utils/constants.h"
 
+/* X(id, name, seeds per pit, min capture, max capture, grand slam)
+ * grand slam 1: capturing all the opponent's seeds is allowed;
+ *            0: such a move is played but captures nothing (Abapa) */
+#define AWALE_VARIANTS(X)                              \
+    X(VARIANT_ABAPA, "abapa", 4, 2, 3, 0)              \
+    X(VARIANT_GRAND_SLAM, "grandslam", 4, 2, 3, 1)     \
+    X(VARIANT_FIVE_SEEDS, "five", 5, 2, 3, 0)
+
+/* Largest seeds per pit in AWALE_VARIANTS: the size of a union with one
+ * char[seeds] member per variant, so a new variant cannot outgrow it */
+#define AWALE_VARIANT_SEEDS(id, name, seeds, min_capture, max_capture, grand_slam) char id[seeds];
+#define MAX_INITIAL_SEEDS ((int)sizeof(union { AWALE_VARIANTS(AWALE_VARIANT_SEEDS) }))
+#define MAX_TOTAL_SEEDS (MAX_INITIAL_SEEDS * TOTAL_PITS)
+
+#define AWALE_VARIANT_ENUM(id, name, seeds, min_capture, max_capture, grand_slam) id,
+typedef enum
+{
+    AWALE_VARIANTS(AWALE_VARIANT_ENUM)
+    VARIANT_COUNT
+} Variant;
+#undef AWALE_VARIANT_ENUM
+
+typedef struct
+{
+    const char *name;
+    int seeds;       // per pit at the start
+    int win_seeds;   // captures needed to win: more than half of all seeds
+    int min_capture; // a pit is captured with min_capture..max_capture seeds
+    int max_capture;
+    int grand_slam;
+} VariantInfo;
+
 // Structure to represent the game board
 typedef struct
 {
     int pits[TOTAL_PITS]; // Pits 0-5: Player 1, Pits 6-11: Player 2
     int score[2];         // Captured seeds for each player
     int current_player;   // 0 for Player 1, 1 for Player 2
+    int variant;          // Variant: which rules kernel plays the moves
 } Board;
 
-void init_board(Board *board);
+const VariantInfo *variant_info(int variant);
+// Variant with this name, -1 if there is none
+int variant_by_name(const char *name);
+// Write "abapa, grandslam, ..." into out
+void variant_list(char *out, size_t out_size);
+
+void init_board(Board *board); // standard (Abapa) rules
+void init_board_variant(Board *board, int variant);
 void display_board(const Board *board);
 bool is_valid_move(const Board *board, int pit);
 bool opponent_has_seeds(const Board *board, int player);
 bool move_gives_seeds_to_opponent(const Board *board, int pit);
-// Render the board into a buffer and return number of bytes written (excluding final null terminator).
-// The rendering mirrors display_board, including colors, but as text for network/clients.
-int render_board(const Board *board, char *out, size_t out_size);
 void make_move(Board *board, int pit);
+// Silent versions for engines: apply_move does not print captures and
+// legal_moves fills `moves` with the playable pits, returning their count.
+void apply_move(Board *board, int pit);
+int legal_moves(const Board *board, int moves[PITS_PER_PLAYER]);
 bool is_game_over(const Board *board);
 void display_winner(const Board *board);
 int get_player_input(const Board *board);
@@ -0,0 +1,163 @@
+#include <string.h>
+#include "awale_batch.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void awale_pack(const Board *board, PackedBoard *packed)
+{
+    memset(packed, 0, sizeof(*packed));
+    for (int i = 0; i < TOTAL_PITS; i++)
+        packed->cells[i] = (uint8_t)board->pits[i];
+    packed->cells[PACKED_SCORE] = (uint8_t)board->score[0];
+    packed->cells[PACKED_SCORE + 1] = (uint8_t)board->score[1];
+    packed->cells[PACKED_PLAYER] = (uint8_t)board->current_player;
+    packed->cells[PACKED_VARIANT] = (uint8_t)board->variant;
+}
+
+void awale_unpack(const PackedBoard *packed, Board *board)
+{
+    for (int i = 0; i < TOTAL_PITS; i++)
+        board->pits[i] = packed->cells[i];
+    board->score[0] = packed->cells[PACKED_SCORE];
+    board->score[1] = packed->cells[PACKED_SCORE + 1];
+    board->current_player = packed->cells[PACKED_PLAYER];
+    board->variant = packed->cells[PACKED_VARIANT];
+}
+
+// Pit of the last seed sown from `pit` (the start pit is skipped)
+static int last_pit(int pit, int seeds)
+{
+    return (pit + 1 + (seeds - 1) % (TOTAL_PITS - 1)) % TOTAL_PITS;
+}
+
+static void apply_scalar(uint8_t *c, int pit)
+{
+    int seeds = c[pit];
+    int laps = seeds / (TOTAL_PITS - 1);
+    int rest = seeds % (TOTAL_PITS - 1);
+    c[pit] = 0;
+    for (int d = 0; d < TOTAL_PITS - 1; d++)
+        c[(pit + 1 + d) % TOTAL_PITS] += (uint8_t)(laps + (d < rest));
+
+    const VariantInfo *rules = variant_info(c[PACKED_VARIANT]);
+    int player = c[PACKED_PLAYER];
+    int opp_start = (1 - player) * PITS_PER_PLAYER;
+    int last = last_pit(pit, seeds);
+    if (last >= opp_start && last < opp_start + PITS_PER_PLAYER)
+    {
+        int first = last;
+        int captured = 0;
+        while (first >= opp_start && c[first] >= rules->min_capture && c[first] <= rules->max_capture)
+            captured += c[first--];
+        int remaining = 0;
+        for (int i = opp_start; i < opp_start + PITS_PER_PLAYER; i++)
+            remaining += c[i];
+        // no capture that would leave the opponent without seeds, unless grand slams are allowed
+        if (captured > 0 && (rules->grand_slam || remaining - captured > 0))
+        {
+            for (int i = first + 1; i <= last; i++)
+                c[i] = 0;
+            c[PACKED_SCORE + player] += (uint8_t)captured;
+        }
+    }
+    c[PACKED_PLAYER] = (uint8_t)(1 - player);
+}
+
+void awale_batch_apply_scalar(PackedBoard *boards, const uint8_t *moves, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        apply_scalar(boards[i].cells, moves[i]);
+}
+
+#if defined(__SSE2__)
+
+// Sum of the bytes of v selected by mask
+static int masked_sum(__m128i v, __m128i mask)
+{
+    __m128i s = _mm_sad_epu8(_mm_and_si128(v, mask), _mm_setzero_si128());
+    return _mm_cvtsi128_si32(s) + _mm_extract_epi16(s, 4);
+}
+
+// Lanes lo..hi (inclusive) of a byte index vector
+static __m128i lane_range(__m128i index, int lo, int hi)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(index, _mm_set1_epi8((char)(lo - 1))),
+                         _mm_cmplt_epi8(index, _mm_set1_epi8((char)(hi + 1))));
+}
+
+static void apply_sse2(PackedBoard *b, int pit)
+{
+    const __m128i index = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i not_pits = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 127, 127, 127, 127);
+    __m128i v = _mm_loadu_si128((const __m128i *)b->cells);
+    int seeds = b->cells[pit];
+    int player = b->cells[PACKED_PLAYER];
+    const VariantInfo *rules = variant_info(b->cells[PACKED_VARIANT]);
+
+    // sowing distance of every pit from the start: 0..10, 11 for the start
+    // pit itself and 127 for the non-pit lanes
+    __m128i d = _mm_sub_epi8(index, _mm_set1_epi8((char)(pit + 1)));
+    d = _mm_add_epi8(d, _mm_and_si128(_mm_cmplt_epi8(d, _mm_setzero_si128()), _mm_set1_epi8(TOTAL_PITS)));
+    d = _mm_or_si128(d, not_pits);
+
+    __m128i start = _mm_cmpeq_epi8(d, _mm_set1_epi8(TOTAL_PITS - 1));
+    __m128i sown = _mm_cmplt_epi8(d, _mm_set1_epi8(TOTAL_PITS - 1));
+    __m128i add = _mm_and_si128(sown, _mm_set1_epi8((char)(seeds / (TOTAL_PITS - 1))));
+    add = _mm_add_epi8(add, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8((char)(seeds % (TOTAL_PITS - 1))), d), _mm_set1_epi8(1)));
+    v = _mm_add_epi8(_mm_andnot_si128(start, v), add);
+
+    int opp_start = (1 - player) * PITS_PER_PLAYER;
+    int last = last_pit(pit, seeds);
+    int captured = 0;
+    if (last >= opp_start && last < opp_start + PITS_PER_PLAYER)
+    {
+        // pits in the capture window, on the opponent's side, up to the last one
+        __m128i takeable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)(rules->min_capture - 1))),
+                                         _mm_cmplt_epi8(v, _mm_set1_epi8((char)(rules->max_capture + 1))));
+        unsigned int upto = (2u << last) - 1;
+        unsigned int bits = (unsigned int)_mm_movemask_epi8(takeable) & (0x3Fu << opp_start) & upto;
+        if (bits >> last & 1)
+        {
+            // the capture runs down to just above the highest gap
+            unsigned int gaps = ~bits & upto;
+            int first = gaps ? 31 - __builtin_clz(gaps) : -1;
+            __m128i run = lane_range(index, first + 1, last);
+            captured = masked_sum(v, run);
+            int remaining = masked_sum(v, lane_range(index, opp_start, opp_start + PITS_PER_PLAYER - 1));
+            if (rules->grand_slam || remaining - captured > 0)
+                v = _mm_andnot_si128(run, v);
+            else
+                captured = 0;
+        }
+    }
+    _mm_storeu_si128((__m128i *)b->cells, v);
+    b->cells[PACKED_SCORE + player] += (uint8_t)captured;
+    b->cells[PACKED_PLAYER] = (uint8_t)(1 - player);
+}
+
+void awale_batch_apply(PackedBoard *boards, const uint8_t *moves, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        apply_sse2(&boards[i], moves[i]);
+}
+
+const char *awale_batch_impl(void)
+{
+    return "sse2";
+}
+
+#else
+
+void awale_batch_apply(PackedBoard *boards, const uint8_t *moves, size_t count)
+{
+    awale_batch_apply_scalar(boards, moves, count);
+}
+
+const char *awale_batch_impl(void)
+{
+    return "scalar";
+}
+
+#endif
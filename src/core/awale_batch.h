@@ -0,0 +1,43 @@
+/*
+ * BATCH MOVE GENERATION
+ *
+ * Applies one move to each of many independent boards (self-play, endgame
+ * tables, training data). Every board is packed into 16 bytes so that it
+ * fits a single SSE register:
+ *   cells[0..11]  pits (same numbering as Board)
+ *   cells[12..13] scores of Player 1 / Player 2
+ *   cells[14]     side to move
+ *   cells[15]     rules variant
+ * Sowing is done in closed form (every other pit gets seeds / 11 plus one
+ * for the first seeds % 11 pits after the start) instead of seed by seed,
+ * and captures use lane masks. The rules are exactly those of apply_move,
+ * read from each board's variant; moves must be legal, as for apply_move.
+ */
+
+#ifndef AWALE_BATCH_H
+#define AWALE_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "awale.h"
+
+#define PACKED_SCORE 12  // cells[PACKED_SCORE + player]
+#define PACKED_PLAYER 14
+#define PACKED_VARIANT 15
+
+typedef struct
+{
+    uint8_t cells[16];
+} PackedBoard;
+
+void awale_pack(const Board *board, PackedBoard *packed);
+void awale_unpack(const PackedBoard *packed, Board *board);
+
+// Play moves[i] on boards[i] for every i < count (vector path when available)
+void awale_batch_apply(PackedBoard *boards, const uint8_t *moves, size_t count);
+// Portable version of the same, also used when SSE2 is not available
+void awale_batch_apply_scalar(PackedBoard *boards, const uint8_t *moves, size_t count);
+// "sse2" or "scalar": the path taken by awale_batch_apply
+const char *awale_batch_impl(void);
+
+#endif
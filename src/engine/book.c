@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "book.h"
+
+#define BOOK_MAGIC "AWBK"
+#define BOOK_VERSION 1
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t count; // entries following the header
+} BookHeader;
+
+int book_open(Book *book, const char *path)
+{
+    memset(book, 0, sizeof(*book));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    void *map = size >= sizeof(BookHeader) ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        if (size < sizeof(BookHeader))
+            errno = EINVAL;
+        return -1;
+    }
+    const BookHeader *h = map;
+    if (memcmp(h->magic, BOOK_MAGIC, 4) != 0 || h->version != BOOK_VERSION ||
+        h->count > (size - sizeof(BookHeader)) / sizeof(BookEntry))
+    {
+        munmap(map, size);
+        errno = EINVAL;
+        return -1;
+    }
+    book->map = map;
+    book->size = size;
+    book->entries = (const BookEntry *)((const char *)map + sizeof(BookHeader));
+    book->count = (size_t)h->count;
+    return 0;
+}
+
+void book_close(Book *book)
+{
+    if (book->map)
+        munmap(book->map, book->size);
+    memset(book, 0, sizeof(*book));
+}
+
+const BookEntry *book_probe(const Book *book, const Board *board)
+{
+    if (!book->entries || book->count == 0)
+        return NULL;
+    uint64_t key = engine_hash(board);
+    const BookEntry *e = book->entries;
+    size_t lo = 0;
+    size_t hi = book->count - 1;
+    // keys are uniform: guess the position from the key instead of halving
+    while (lo <= hi && key >= e[lo].key && key <= e[hi].key)
+    {
+        size_t mid = lo;
+        if (e[hi].key != e[lo].key)
+            mid += (size_t)((double)(key - e[lo].key) / (double)(e[hi].key - e[lo].key) * (double)(hi - lo));
+        if (e[mid].key == key)
+            return &e[mid];
+        if (e[mid].key < key)
+            lo = mid + 1;
+        else if (mid == 0)
+            break;
+        else
+            hi = mid - 1;
+    }
+    return NULL;
+}
+
+const BookEntry *book_analyze(const Book *book, const Board *board, EngineAnalysis *analysis)
+{
+    const BookEntry *entry = book_probe(book, board);
+    if (!entry || !is_valid_move(board, entry->best_move))
+        return NULL;
+    analysis->best_move = entry->best_move;
+    analysis->score = entry->score >= BOOK_SCORE_WIN ? ENGINE_WIN : (entry->score <= -BOOK_SCORE_WIN ? -ENGINE_WIN : entry->score);
+    analysis->depth = entry->depth;
+    analysis->nodes = 0;
+    analysis->pv_length = 0;
+    // the line goes on as long as the book has the position it leads to
+    Board b = *board;
+    const BookEntry *e = entry;
+    while (e && analysis->pv_length < ENGINE_MAX_DEPTH && !is_game_over(&b) && is_valid_move(&b, e->best_move))
+    {
+        analysis->pv[analysis->pv_length++] = e->best_move;
+        apply_move(&b, e->best_move);
+        e = book_probe(book, &b);
+    }
+    return entry;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    uint64_t ka = ((const BookEntry *)a)->key;
+    uint64_t kb = ((const BookEntry *)b)->key;
+    return ka < kb ? -1 : (ka > kb);
+}
+
+int book_write(const char *path, BookEntry *entries, size_t count)
+{
+    qsort(entries, count, sizeof(BookEntry), compare_entries);
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+    BookHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, BOOK_MAGIC, 4);
+    h.version = BOOK_VERSION;
+    h.count = count;
+    size_t bytes = count * sizeof(BookEntry);
+    int ok = write(fd, &h, sizeof(h)) == (ssize_t)sizeof(h) &&
+             write(fd, entries, bytes) == (ssize_t)bytes && fdatasync(fd) == 0;
+    int saved = errno;
+    close(fd);
+    // the rename is atomic: a server mapping the old book keeps it intact
+    if (!ok || rename(tmp_path, path) != 0)
+    {
+        saved = ok ? errno : saved;
+        unlink(tmp_path);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
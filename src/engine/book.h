@@ -0,0 +1,58 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+
+/*
+ * OPENING BOOK
+ * ============
+ * Every game starts from the same board, so its first plies only reach a
+ * few hundred positions, which the engine would otherwise search again in
+ * every game. bin/bookgen searches each of them once, deeply, plays
+ * self-play games through them, and writes the results to a book file:
+ *   header | BookEntry records sorted by key
+ * where the key is the position's engine_hash (which covers the variant
+ * and the side to move). The file is memory-mapped read-only; the keys are
+ * uniform, so a lookup is an interpolation search of a few probes.
+ */
+
+#define BOOK_SCORE_WIN 32000 // stored score of a forced win (scores are clamped to it)
+
+typedef struct
+{
+    uint64_t key;      // engine_hash of the position
+    int16_t score;     // of the deep search, for the side to move
+    uint8_t best_move; // pit
+    uint8_t depth;     // of the deep search
+    uint16_t games;    // self-play games through the position (saturates)
+    uint16_t wins;     // of them, won by the side to move
+} BookEntry;
+
+typedef struct
+{
+    const BookEntry *entries; // NULL: no book
+    size_t count;
+    void *map;
+    size_t size;
+} Book;
+
+/* Map a book file. Returns 0 on success, -1 with errno set otherwise
+ * (EINVAL: not a book). */
+int book_open(Book *book, const char *path);
+void book_close(Book *book);
+
+/* Entry of the position, NULL if it is not in the book */
+const BookEntry *book_probe(const Book *book, const Board *board);
+
+/* Answer from the book: best move, score and depth of the entry, and the
+ * line of book moves that follows it as the principal variation. Returns
+ * the entry, or NULL if the position is not in the book. */
+const BookEntry *book_analyze(const Book *book, const Board *board, EngineAnalysis *analysis);
+
+/* Sort `entries` by key and write them as a book file (to a temporary file
+ * renamed over `path`). Returns 0 on success, -1 with errno set otherwise. */
+int book_write(const char *path, BookEntry *entries, size_t count);
+
+#endif
@@ -0,0 +1,463 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "engine.h"
+#include "../utils/clock.h"
+
+void engine_default_params(EngineParams *params)
+{
+    params->depth = 6;
+    params->score_weight = 100;
+    params->seeds_weight = 2;
+    params->mobility_weight = 5;
+}
+
+int engine_parse_params(const char *spec, EngineParams *params)
+{
+    char buf[256];
+    strncpy(buf, spec, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    for (char *item = strtok(buf, ","); item; item = strtok(NULL, ","))
+    {
+        char *eq = strchr(item, '=');
+        if (!eq)
+            return 0;
+        *eq = '\0';
+        char *end;
+        long value = strtol(eq + 1, &end, 10);
+        if (*end != '\0')
+            return 0;
+
+        if (strcmp(item, "depth") == 0 && value >= 1 && value <= ENGINE_MAX_DEPTH)
+            params->depth = (int)value;
+        else if (strcmp(item, "score") == 0)
+            params->score_weight = (int)value;
+        else if (strcmp(item, "seeds") == 0)
+            params->seeds_weight = (int)value;
+        else if (strcmp(item, "mobility") == 0)
+            params->mobility_weight = (int)value;
+        else
+            return 0;
+    }
+    return 1;
+}
+
+int engine_format_params(const EngineParams *params, char *out, size_t out_size)
+{
+    return snprintf(out, out_size, "depth=%d,score=%d,seeds=%d,mobility=%d",
+                    params->depth, params->score_weight, params->seeds_weight, params->mobility_weight);
+}
+
+int engine_evaluate(const Board *board, const EngineParams *params)
+{
+    int me = board->current_player;
+    int opp = 1 - me;
+    int my_seeds = 0;
+    int opp_seeds = 0;
+    for (int i = 0; i < PITS_PER_PLAYER; i++)
+    {
+        my_seeds += board->pits[me * PITS_PER_PLAYER + i];
+        opp_seeds += board->pits[opp * PITS_PER_PLAYER + i];
+    }
+    int moves[PITS_PER_PLAYER];
+    int mobility = legal_moves(board, moves);
+
+    return params->score_weight * (board->score[me] - board->score[opp]) +
+           params->seeds_weight * (my_seeds - opp_seeds) +
+           params->mobility_weight * mobility;
+}
+
+/* ZOBRIST KEYS */
+
+static uint64_t zobrist_pits[TOTAL_PITS][MAX_TOTAL_SEEDS + 1];
+static uint64_t zobrist_score[2][MAX_TOTAL_SEEDS + 1];
+static uint64_t zobrist_side;
+static uint64_t zobrist_variant[VARIANT_COUNT];
+static pthread_once_t zobrist_once = PTHREAD_ONCE_INIT;
+
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static void zobrist_init(void)
+{
+    uint64_t state = 0x41574C45; // fixed: keys are the same in every run
+    for (int p = 0; p < TOTAL_PITS; p++)
+        for (int n = 0; n <= MAX_TOTAL_SEEDS; n++)
+            zobrist_pits[p][n] = splitmix64(&state);
+    for (int s = 0; s < 2; s++)
+        for (int n = 0; n <= MAX_TOTAL_SEEDS; n++)
+            zobrist_score[s][n] = splitmix64(&state);
+    zobrist_side = splitmix64(&state);
+    for (int v = 1; v < VARIANT_COUNT; v++) // standard rules: no variant key
+        zobrist_variant[v] = splitmix64(&state);
+}
+
+uint64_t engine_hash(const Board *board)
+{
+    pthread_once(&zobrist_once, zobrist_init);
+    uint64_t key = board->current_player ? zobrist_side : 0;
+    for (int p = 0; p < TOTAL_PITS; p++)
+        key ^= zobrist_pits[p][board->pits[p]];
+    key ^= zobrist_score[0][board->score[0]];
+    key ^= zobrist_score[1][board->score[1]];
+    key ^= zobrist_variant[board->variant];
+    return key;
+}
+
+/* TRANSPOSITION TABLE
+ * data = score (32 bits) | depth << 32 | bound << 40 | move << 44 */
+
+enum
+{
+    BOUND_NONE,
+    BOUND_EXACT,
+    BOUND_LOWER, // fail high: score >= value
+    BOUND_UPPER  // fail low: score <= value
+};
+
+#define NO_MOVE 15
+
+int engine_table_init(EngineTable *table, size_t size_mb)
+{
+    size_t count = 1;
+    while (count * 2 * sizeof(table->entries[0]) <= size_mb * 1024 * 1024)
+        count *= 2;
+    table->entries = calloc(count, sizeof(table->entries[0]));
+    table->mask = count - 1;
+    return table->entries ? 0 : -1;
+}
+
+void engine_table_clear(EngineTable *table)
+{
+    memset(table->entries, 0, (table->mask + 1) * sizeof(table->entries[0]));
+}
+
+void engine_table_free(EngineTable *table)
+{
+    free(table->entries);
+    table->entries = NULL;
+    table->mask = 0;
+}
+
+static int table_probe(EngineTable *table, uint64_t key, uint64_t *data)
+{
+    uint64_t *e = table->entries[key & table->mask];
+    uint64_t check = __atomic_load_n(&e[0], __ATOMIC_RELAXED);
+    uint64_t d = __atomic_load_n(&e[1], __ATOMIC_RELAXED);
+    if ((check ^ d) != key || d == 0)
+        return 0;
+    *data = d;
+    return 1;
+}
+
+static void table_store(EngineTable *table, uint64_t key, int depth, int bound, int move, int score)
+{
+    uint64_t *e = table->entries[key & table->mask];
+    uint64_t old = __atomic_load_n(&e[1], __ATOMIC_RELAXED);
+    uint64_t old_key = __atomic_load_n(&e[0], __ATOMIC_RELAXED) ^ old;
+    // keep a deeper result for the same position
+    if (old_key == key && (int)((old >> 32) & 0xFF) > depth && bound != BOUND_EXACT)
+        return;
+    uint64_t data = (uint64_t)(uint32_t)score | ((uint64_t)depth << 32) |
+                    ((uint64_t)bound << 40) | ((uint64_t)(move < 0 ? NO_MOVE : move) << 44);
+    __atomic_store_n(&e[0], key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&e[1], data, __ATOMIC_RELAXED);
+}
+
+/* SEARCH */
+
+typedef struct
+{
+    const EngineParams *params;
+    EngineTable *table;      // shared, may be NULL
+    int history[TOTAL_PITS]; // per thread: bonus of moves that caused cutoffs
+    long long nodes;
+    int win_seeds;           // of the root's variant
+    int *stop;               // set when the search must give up
+    long long deadline;      // monotonic ms after which the main thread stops (0: none)
+    int depth_done;          // last iteration completed by search_root
+    int pv[ENGINE_MAX_DEPTH]; // principal variation of that iteration
+    int pv_length;
+    // triangular PV: line[ply] is the best line found below the node at ply
+    int line[ENGINE_MAX_DEPTH + 2][ENGINE_MAX_DEPTH + 1];
+    int line_length[ENGINE_MAX_DEPTH + 2];
+} SearchThread;
+
+// Score of a finished game for the side to move
+static int terminal_score(const Board *board)
+{
+    int diff = board->score[board->current_player] - board->score[1 - board->current_player];
+    if (diff > 0)
+        return ENGINE_WIN + diff;
+    if (diff < 0)
+        return -ENGINE_WIN + diff;
+    return 0;
+}
+
+static int stopped(const SearchThread *t)
+{
+    // the first iteration always completes so there is a move to return
+    if (t->deadline && t->depth_done > 0 && (t->nodes & 1023) == 0 && monotonic_ms() >= t->deadline)
+        __atomic_store_n(t->stop, 1, __ATOMIC_RELAXED);
+    return t->stop && __atomic_load_n(t->stop, __ATOMIC_RELAXED);
+}
+
+// Generate the children of `board` ordered best first; returns their count
+static int ordered_children(const SearchThread *t, const Board *board, int tt_move, int moves[PITS_PER_PLAYER], Board children[PITS_PER_PLAYER])
+{
+    int count = legal_moves(board, moves);
+    int keys[PITS_PER_PLAYER];
+    int me = board->current_player;
+    for (int i = 0; i < count; i++)
+    {
+        children[i] = *board;
+        apply_move(&children[i], moves[i]);
+        int gain = children[i].score[me] - board->score[me];
+        keys[i] = moves[i] == tt_move ? 1 << 30 : (gain << 20) + t->history[moves[i]];
+    }
+    for (int i = 1; i < count; i++)
+    {
+        for (int j = i; j > 0 && keys[j] > keys[j - 1]; j--)
+        {
+            int k = keys[j];
+            keys[j] = keys[j - 1];
+            keys[j - 1] = k;
+            int m = moves[j];
+            moves[j] = moves[j - 1];
+            moves[j - 1] = m;
+            Board b = children[j];
+            children[j] = children[j - 1];
+            children[j - 1] = b;
+        }
+    }
+    return count;
+}
+
+// Make line[ply] = move followed by line[ply + 1]
+static void update_line(SearchThread *t, int ply, int move)
+{
+    int length = t->line_length[ply + 1];
+    if (length > ENGINE_MAX_DEPTH - 1)
+        length = ENGINE_MAX_DEPTH - 1;
+    t->line[ply][0] = move;
+    memcpy(&t->line[ply][1], t->line[ply + 1], sizeof(int) * length);
+    t->line_length[ply] = length + 1;
+}
+
+static int negamax(SearchThread *t, const Board *board, int depth, int ply, int alpha, int beta)
+{
+    t->nodes++;
+    t->line_length[ply] = 0;
+    if (board->score[0] >= t->win_seeds || board->score[1] >= t->win_seeds)
+        return terminal_score(board);
+    if (depth == 0)
+    {
+        int moves[PITS_PER_PLAYER];
+        if (legal_moves(board, moves) == 0)
+            return terminal_score(board);
+        return engine_evaluate(board, t->params);
+    }
+    if ((t->nodes & 1023) == 0 && stopped(t))
+        return 0;
+
+    int alpha_orig = alpha;
+    int tt_move = -1;
+    uint64_t key = 0;
+    if (t->table)
+    {
+        uint64_t data;
+        key = engine_hash(board);
+        if (table_probe(t->table, key, &data))
+        {
+            int tt_score = (int32_t)(uint32_t)data;
+            int tt_depth = (int)((data >> 32) & 0xFF);
+            int bound = (int)((data >> 40) & 0x3);
+            int m = (int)((data >> 44) & 0xF);
+            tt_move = m == NO_MOVE ? -1 : m;
+            if (tt_depth >= depth)
+            {
+                if (bound == BOUND_EXACT)
+                    return tt_score;
+                if (bound == BOUND_LOWER && tt_score >= beta)
+                    return tt_score;
+                if (bound == BOUND_UPPER && tt_score <= alpha)
+                    return tt_score;
+            }
+        }
+    }
+
+    int moves[PITS_PER_PLAYER];
+    Board children[PITS_PER_PLAYER];
+    int count = ordered_children(t, board, tt_move, moves, children);
+    if (count == 0)
+        return terminal_score(board);
+
+    int best = -2 * ENGINE_WIN;
+    int best_move = -1;
+    for (int i = 0; i < count; i++)
+    {
+        int value = -negamax(t, &children[i], depth - 1, ply + 1, -beta, -alpha);
+        if (stopped(t))
+            return 0;
+        if (value > best)
+        {
+            best = value;
+            best_move = moves[i];
+        }
+        if (value > alpha)
+        {
+            alpha = value;
+            update_line(t, ply, moves[i]);
+        }
+        if (alpha >= beta)
+        {
+            t->history[moves[i]] += depth * depth;
+            break;
+        }
+    }
+
+    if (t->table)
+    {
+        int bound = best <= alpha_orig ? BOUND_UPPER : (best >= beta ? BOUND_LOWER : BOUND_EXACT);
+        table_store(t->table, key, depth, bound, best_move, best);
+    }
+    return best;
+}
+
+// Iterative deepening up to `depth`; returns the score, best move in *best_move
+static int search_root(SearchThread *t, const Board *board, int depth, int *best_move)
+{
+    int score = 0;
+    int root_move = -1;
+    *best_move = -1;
+    t->depth_done = 0;
+    t->pv_length = 0;
+    for (int d = 1; d <= depth; d++)
+    {
+        int moves[PITS_PER_PLAYER];
+        Board children[PITS_PER_PLAYER];
+        int count = ordered_children(t, board, root_move, moves, children);
+        t->nodes++;
+        if (count == 0)
+            return terminal_score(board);
+
+        int alpha = -2 * ENGINE_WIN;
+        int beta = 2 * ENGINE_WIN;
+        int iteration_move = -1;
+        for (int i = 0; i < count; i++)
+        {
+            int value = -negamax(t, &children[i], d - 1, 1, -beta, -alpha);
+            if (stopped(t))
+                return score; // keep the last complete iteration
+            if (value > alpha || iteration_move < 0)
+            {
+                alpha = value;
+                iteration_move = moves[i];
+                update_line(t, 0, moves[i]);
+            }
+        }
+        score = alpha;
+        root_move = iteration_move;
+        *best_move = root_move;
+        t->depth_done = d;
+        t->pv_length = t->line_length[0];
+        memcpy(t->pv, t->line[0], sizeof(int) * t->pv_length);
+    }
+    return score;
+}
+
+int engine_search(const Board *board, const EngineParams *params, EngineStats *stats, int *best_move)
+{
+    return engine_search_parallel(board, params, NULL, 1, stats, best_move);
+}
+
+typedef struct
+{
+    SearchThread search;
+    const Board *board;
+    int depth;
+    int best_move;
+    int score;
+} Helper;
+
+static void *helper_main(void *arg)
+{
+    Helper *h = arg;
+    h->score = search_root(&h->search, h->board, h->depth, &h->best_move);
+    return NULL;
+}
+
+// Lazy SMP driver shared by the fixed-depth and the timed searches
+static int search_threads(const Board *board, const EngineParams *params, EngineTable *table, int threads, long long deadline, EngineStats *stats, int *best_move, SearchThread *main_thread)
+{
+    if (threads < 1)
+        threads = 1;
+    if (threads > ENGINE_MAX_THREADS)
+        threads = ENGINE_MAX_THREADS;
+
+    int stop = 0;
+    Helper helpers[ENGINE_MAX_THREADS];
+    pthread_t ids[ENGINE_MAX_THREADS];
+    int started = 0;
+    // helpers search one ply deeper every other thread so they diverge
+    for (int i = 1; i < threads; i++)
+    {
+        Helper *h = &helpers[i];
+        memset(&h->search, 0, sizeof(h->search));
+        h->search.params = params;
+        h->search.win_seeds = variant_info(board->variant)->win_seeds;
+        h->search.table = table;
+        h->search.stop = &stop;
+        h->board = board;
+        h->depth = params->depth + (i & 1);
+        if (h->depth > ENGINE_MAX_DEPTH)
+            h->depth = ENGINE_MAX_DEPTH;
+        if (pthread_create(&ids[started + 1], NULL, helper_main, h) != 0)
+            break;
+        started++;
+    }
+
+    // the main thread only stops on its own deadline, helpers when it is done
+    memset(main_thread, 0, sizeof(*main_thread));
+    main_thread->params = params;
+    main_thread->win_seeds = variant_info(board->variant)->win_seeds;
+    main_thread->table = table;
+    main_thread->stop = &stop;
+    main_thread->deadline = deadline;
+    int score = search_root(main_thread, board, params->depth, best_move);
+
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    stats->nodes += main_thread->nodes;
+    for (int i = 1; i <= started; i++)
+    {
+        pthread_join(ids[i], NULL);
+        stats->nodes += helpers[i].search.nodes;
+    }
+    return score;
+}
+
+int engine_search_parallel(const Board *board, const EngineParams *params, EngineTable *table, int threads, EngineStats *stats, int *best_move)
+{
+    SearchThread main_thread;
+    return search_threads(board, params, table, threads, 0, stats, best_move, &main_thread);
+}
+
+int engine_analyze(const Board *board, const EngineParams *params, EngineTable *table, int threads, int time_ms, EngineAnalysis *analysis)
+{
+    EngineStats stats = {0};
+    SearchThread main_thread;
+    long long deadline = time_ms > 0 ? monotonic_ms() + time_ms : 0;
+    analysis->score = search_threads(board, params, table, threads, deadline, &stats, &analysis->best_move, &main_thread);
+    analysis->depth = main_thread.depth_done;
+    analysis->nodes = stats.nodes;
+    analysis->pv_length = main_thread.pv_length;
+    memcpy(analysis->pv, main_thread.pv, sizeof(int) * main_thread.pv_length);
+    return analysis->score;
+}
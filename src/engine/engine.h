@@ -0,0 +1,97 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdint.h>
+#include "../core/awale.h"
+
+/*
+ * AWALE ENGINE
+ * ============
+ * Iterative-deepening alpha-beta (negamax) over the core Board rules, using
+ * the silent apply_move/legal_moves. The evaluation is a weighted sum seen
+ * from the side to move; the weights and the depth are the tunable
+ * parameters compared by bin/selfplay.
+ *
+ * engine_search_parallel() runs Lazy SMP: every thread searches the same
+ * root and they only cooperate through a shared transposition table, which
+ * is lock-free (each entry stores key ^ data next to data, so a torn write
+ * is detected as a key mismatch instead of being trusted). Move ordering
+ * uses the table move, captures and a per-thread history table.
+ *
+ * engine_analyze() is the same search bounded by a time budget as well as
+ * a depth, and also reports the principal variation; the server uses it
+ * for the analyze command.
+ */
+
+#define ENGINE_WIN 100000 // terminal positions score beyond any evaluation
+#define ENGINE_MAX_DEPTH 32
+#define ENGINE_MAX_THREADS 64
+
+typedef struct
+{
+    int depth;           // plies searched
+    int score_weight;    // per captured seed
+    int seeds_weight;    // per seed on our side of the board
+    int mobility_weight; // per legal move of the side to move
+} EngineParams;
+
+typedef struct
+{
+    long long nodes; // positions visited
+} EngineStats;
+
+/* Result of engine_analyze */
+typedef struct
+{
+    int best_move;             // -1 if the game is over
+    int score;                 // for the side to move
+    int depth;                 // last completed iteration
+    int pv[ENGINE_MAX_DEPTH];  // expected line, starting with best_move
+    int pv_length;
+    long long nodes;
+} EngineAnalysis;
+
+/* Shared transposition table (power-of-two number of two-word entries) */
+typedef struct
+{
+    uint64_t (*entries)[2]; // { key ^ data, data }
+    size_t mask;
+} EngineTable;
+
+void engine_default_params(EngineParams *params);
+
+/* Parse "depth=6,score=100,seeds=2,mobility=5" over the current values.
+ * Returns 1 on success, 0 on an unknown key or bad value. */
+int engine_parse_params(const char *spec, EngineParams *params);
+
+/* Write the parameters back in the format read by engine_parse_params */
+int engine_format_params(const EngineParams *params, char *out, size_t out_size);
+
+/* Static evaluation from the point of view of the side to move */
+int engine_evaluate(const Board *board, const EngineParams *params);
+
+/* Zobrist key of a position (pits, scores, side to move and variant) */
+uint64_t engine_hash(const Board *board);
+
+/* Allocate about size_mb megabytes of table; returns 0 on success */
+int engine_table_init(EngineTable *table, size_t size_mb);
+void engine_table_clear(EngineTable *table);
+void engine_table_free(EngineTable *table);
+
+/* Single-threaded search without a table; stores the best pit in
+ * *best_move (-1 if the game is over) and returns its score for the side
+ * to move. */
+int engine_search(const Board *board, const EngineParams *params, EngineStats *stats, int *best_move);
+
+/* Lazy SMP search on `threads` threads sharing `table` (NULL: no table).
+ * The move returned is the main thread's; helper threads only make it
+ * faster by filling the table. */
+int engine_search_parallel(const Board *board, const EngineParams *params, EngineTable *table, int threads, EngineStats *stats, int *best_move);
+
+/* Iterative deepening up to params->depth, stopping after about time_ms
+ * (<= 0: no limit) once at least one iteration is done. The principal
+ * variation can be shorter than the depth where a table hit cut it off.
+ * Returns the score for the side to move. */
+int engine_analyze(const Board *board, const EngineParams *params, EngineTable *table, int threads, int time_ms, EngineAnalysis *analysis);
+
+#endif
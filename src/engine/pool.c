@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "pool.h"
+
+// A worker's remaining tasks [begin, end) packed as begin | end << 32
+typedef struct
+{
+    uint64_t range;
+    char pad[64 - sizeof(uint64_t)]; // one cache line per worker
+} WorkerRange;
+
+typedef struct
+{
+    WorkerRange *ranges;
+    int threads;
+    PoolTask fn;
+    void *ctx;
+} Pool;
+
+typedef struct
+{
+    Pool *pool;
+    int index;
+} Worker;
+
+static uint64_t pack(uint32_t begin, uint32_t end)
+{
+    return (uint64_t)begin | ((uint64_t)end << 32);
+}
+
+// Take the first task of our own range; -1 if it is empty
+static int pop_own(WorkerRange *own)
+{
+    uint64_t r = __atomic_load_n(&own->range, __ATOMIC_ACQUIRE);
+    for (;;)
+    {
+        uint32_t begin = (uint32_t)r;
+        uint32_t end = (uint32_t)(r >> 32);
+        if (begin >= end)
+            return -1;
+        if (__atomic_compare_exchange_n(&own->range, &r, pack(begin + 1, end), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            return (int)begin;
+    }
+}
+
+// Move the back half of some victim's range into ours; 0 if all are empty
+static int steal(Pool *pool, int self)
+{
+    for (int k = 1; k < pool->threads; k++)
+    {
+        WorkerRange *victim = &pool->ranges[(self + k) % pool->threads];
+        uint64_t r = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+        for (;;)
+        {
+            uint32_t begin = (uint32_t)r;
+            uint32_t end = (uint32_t)(r >> 32);
+            if (begin >= end)
+                break;
+            uint32_t take = (end - begin + 1) / 2;
+            if (__atomic_compare_exchange_n(&victim->range, &r, pack(begin, end - take), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                // our range is empty, so nobody else is writing it
+                __atomic_store_n(&pool->ranges[self].range, pack(end - take, end), __ATOMIC_RELEASE);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *w = arg;
+    Pool *pool = w->pool;
+    WorkerRange *own = &pool->ranges[w->index];
+    for (;;)
+    {
+        int task = pop_own(own);
+        if (task >= 0)
+        {
+            pool->fn(task, w->index, pool->ctx);
+            continue;
+        }
+        // tasks never get added: once every range is empty we are done
+        if (!steal(pool, w->index))
+            break;
+    }
+    return NULL;
+}
+
+int pool_run(int threads, int task_count, PoolTask fn, void *ctx)
+{
+    if (threads < 1)
+        threads = 1;
+    if (threads > POOL_MAX_THREADS)
+        threads = POOL_MAX_THREADS;
+    if (task_count <= 0)
+        return 0;
+
+    Pool pool;
+    pool.threads = threads;
+    pool.fn = fn;
+    pool.ctx = ctx;
+    void *ranges = NULL;
+    if (posix_memalign(&ranges, 64, sizeof(WorkerRange) * threads) != 0)
+        ranges = NULL;
+    pool.ranges = ranges;
+    pthread_t *ids = malloc(sizeof(pthread_t) * threads);
+    Worker *workers = malloc(sizeof(Worker) * threads);
+    if (!pool.ranges || !ids || !workers)
+    {
+        free(pool.ranges);
+        free(ids);
+        free(workers);
+        return -1;
+    }
+
+    // start from an even split; stealing fixes the imbalance
+    for (int i = 0; i < threads; i++)
+    {
+        uint32_t begin = (uint32_t)((long long)task_count * i / threads);
+        uint32_t end = (uint32_t)((long long)task_count * (i + 1) / threads);
+        pool.ranges[i].range = pack(begin, end);
+        workers[i].pool = &pool;
+        workers[i].index = i;
+    }
+
+    int started = 0;
+    for (; started < threads; started++)
+    {
+        if (pthread_create(&ids[started], NULL, worker_main, &workers[started]) != 0)
+            break;
+    }
+    // if some threads failed to start, the ones running steal their tasks
+    if (started == 0)
+    {
+        perror("pthread_create()");
+        free(pool.ranges);
+        free(ids);
+        free(workers);
+        return -1;
+    }
+    for (int i = 0; i < started; i++)
+        pthread_join(ids[i], NULL);
+
+    free(pool.ranges);
+    free(ids);
+    free(workers);
+    return 0;
+}
+
+int pool_default_threads(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
@@ -0,0 +1,26 @@
+#ifndef POOL_H
+#define POOL_H
+
+/*
+ * WORK-STEALING TASK POOL
+ * =======================
+ * Runs tasks 0..task_count-1 on a fixed number of threads. Each worker owns
+ * a contiguous range of task indices packed in one 64-bit word: the owner
+ * takes tasks from the front, and an idle worker steals the back half of a
+ * victim's range with a single compare-and-swap, so there are no locks and
+ * long tasks (games) balance out across cores.
+ */
+
+#define POOL_MAX_THREADS 256
+
+/* Called once per task; `worker` is the index of the running thread */
+typedef void (*PoolTask)(int task, int worker, void *ctx);
+
+/* Run every task and return when all are done. Returns 0, or -1 if the
+ * threads could not be started (nothing has run then). */
+int pool_run(int threads, int task_count, PoolTask fn, void *ctx);
+
+/* Number of online CPUs (at least 1) */
+int pool_default_threads(void);
+
+#endif
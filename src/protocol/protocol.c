@@ -55,6 +55,7 @@ int protocol_is_command(const char *input)
         strncmp(input, CMD_PM, strlen(CMD_PM)) == 0 ||
         strcmp(input, CMD_GAMES) == 0 ||
         strncmp(input, CMD_WATCH, strlen(CMD_WATCH)) == 0 ||
+        strncmp(input, CMD_ANALYZE, strlen(CMD_ANALYZE)) == 0 ||
         strncmp(input, CMD_UNWATCH, strlen(CMD_UNWATCH)) == 0 ||
         strncmp(input, CMD_ADD_FRIEND, strlen(CMD_ADD_FRIEND)) == 0 ||
         strncmp(input, CMD_ACCEPT_FRIEND, strlen(CMD_ACCEPT_FRIEND)) == 0 ||
@@ -62,13 +63,90 @@ int protocol_is_command(const char *input)
         strncmp(input, CMD_PRIVATE, strlen(CMD_PRIVATE)) == 0 ||
         strcmp(input, CMD_FRIENDS) == 0 ||
         strcmp(input, CMD_RANKING) == 0 ||
-        strncmp(input, CMD_WATCH_REPLAY, strlen(CMD_WATCH_REPLAY)) == 0)
+        strncmp(input, CMD_WATCH_REPLAY, strlen(CMD_WATCH_REPLAY)) == 0 ||
+        strcmp(input, CMD_QUEUE) == 0 ||
+        strcmp(input, CMD_UNQUEUE) == 0 ||
+        strncmp(input, CMD_BOARD, strlen(CMD_BOARD)) == 0 ||
+        strncmp(input, CMD_VARIANT, strlen(CMD_VARIANT)) == 0 ||
+        strcmp(input, CMD_RESUME) == 0 ||
+        strncmp(input, CMD_SEEK, strlen(CMD_SEEK)) == 0 ||
+        strncmp(input, CMD_SPEED, strlen(CMD_SPEED)) == 0 ||
+        strcmp(input, CMD_STOP_REPLAY) == 0 ||
+        strncmp(input, CMD_JOIN, strlen(CMD_JOIN)) == 0 ||
+        strcmp(input, CMD_ROOMS) == 0 ||
+        strncmp(input, CMD_SYNC, strlen(CMD_SYNC)) == 0 ||
+        strncmp(input, CMD_HISTORY, strlen(CMD_HISTORY)) == 0)
     {
         return 1;
     }
     return 0;
 }
 
+int protocol_format_board(char *buffer, size_t buf_size, const BoardState *state)
+{
+    const int *p = state->pits;
+    return snprintf(buffer, buf_size, "%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %s %s",
+                    state->match_id, state->ply, state->seat, state->current_player,
+                    p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9], p[10], p[11],
+                    state->score[0], state->score[1], state->players[0], state->players[1]);
+}
+
+int protocol_parse_board(const char *payload, BoardState *state)
+{
+    int *p = state->pits;
+    /* names are bounded by MAX_USERNAME_LEN (32) */
+    int n = sscanf(payload, "%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %31s %31s",
+                   &state->match_id, &state->ply, &state->seat, &state->current_player,
+                   &p[0], &p[1], &p[2], &p[3], &p[4], &p[5], &p[6], &p[7], &p[8], &p[9], &p[10], &p[11],
+                   &state->score[0], &state->score[1], state->players[0], state->players[1]);
+    return n == 20;
+}
+
+int protocol_format_delta(char *buffer, size_t buf_size, const BoardDelta *delta)
+{
+    int n = snprintf(buffer, buf_size, "%d %d %d %d %d %d %d",
+                     delta->match_id, delta->ply, delta->pit, delta->current_player,
+                     delta->captured, delta->score[0], delta->score[1]);
+    for (int i = 0; i < delta->changed && n >= 0 && (size_t)n < buf_size; i++)
+        n += snprintf(buffer + n, buf_size - (size_t)n, "%c%d=%d", i == 0 ? ' ' : ',', delta->pits[i], delta->seeds[i]);
+    return n;
+}
+
+int protocol_parse_delta(const char *payload, BoardDelta *delta)
+{
+    int used = 0;
+    if (sscanf(payload, "%d %d %d %d %d %d %d%n",
+               &delta->match_id, &delta->ply, &delta->pit, &delta->current_player,
+               &delta->captured, &delta->score[0], &delta->score[1], &used) != 7)
+        return 0;
+    const char *p = payload + used;
+    delta->changed = 0;
+    while (*p == ' ' || *p == ',')
+    {
+        int pit, seeds, len = 0;
+        if (delta->changed == TOTAL_PITS || sscanf(p + 1, "%d=%d%n", &pit, &seeds, &len) != 2 || pit < 0 || pit >= TOTAL_PITS)
+            return 0;
+        delta->pits[delta->changed] = pit;
+        delta->seeds[delta->changed] = seeds;
+        delta->changed++;
+        p += 1 + len;
+    }
+    return *p == '\0';
+}
+
+int protocol_apply_delta(BoardState *state, const BoardDelta *delta)
+{
+    if (delta->match_id != state->match_id || delta->ply != state->ply + 1)
+        return 0;
+    for (int i = 0; i < delta->changed; i++)
+        state->pits[delta->pits[i]] = delta->seeds[i];
+    state->ply = delta->ply;
+    state->current_player = delta->current_player;
+    state->score[0] = delta->score[0];
+    state->score[1] = delta->score[1];
+    return 1;
+}
+
 void protocol_parse_command(const char *input, char *command, char *args, size_t cmd_size, size_t args_size)
 {
     strncpy(command, input, cmd_size - 1);
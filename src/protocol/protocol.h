@@ -2,6 +2,7 @@
 #define PROTOCOL_H
 
 #include <stddef.h>
+#include "../utils/constants.h"
 
 /*
  * MESSAGE PROTOCOL
@@ -9,20 +10,44 @@
  * Format: "TYPE|payload" of "<command> <args...>"
  *
  * Examples:
- *  Server sends:  "0|Welcome alice!"                    (MSG_CONNECT_ACK)
+ *  Server sends:  "0|alice 9f86d081884c7d65"           (MSG_CONNECT_ACK: name, session token)
  *  Server sends:  "2|alice,bob,charlie"                (MSG_LIST_USERS)
  *  Server sends:  "1|alice: Hello everyone"            (MSG_CHAT)
  *  Server sends:  "8|Error: invalid move"              (MSG_ERROR)
  *
  * Client sends (keywords):
- *  "list"                     → requests user list
- *  "msg hello everyone"       → chat message
+ *  "list"                     → requests the user list of our room
+ *  "msg hello everyone"       → chat message to our room
+ *  "join openings"            → move to chat room "openings" (no name:
+ *                               back to the lobby)
+ *  "rooms"                    → list the chat rooms
  *  "challenge alice"          → challenge a player
  *  "accept alice"             → accept a challenge
  *  "bio my bio text"          → set bio
  *  "getbio alice"             → get user's bio
  *  "pm alice hello"           → private message to a user
  *  "games"                    → list running games
+ *  "queue"                    → join the matchmaking queue
+ *  "board data"               → receive boards as MSG_BOARD_STATE
+ *  "board delta"              → receive a MSG_BOARD_STATE keyframe, then
+ *                               one MSG_BOARD_DELTA per move
+ *  "sync 3"                   → keyframe of match 3 (no id: our match)
+ *  "history alice 20"         → alice's last 20 finished games
+ *  "analyze 3"                → best move and evaluation of match 3
+ *  "variant grandslam"        → rules of the matches we start
+ *  "resume"                   → take our seat back in a match restored
+ *                               after a server restart
+ *  "watchreplay 3 500"        → replay match 3, one move every 500 ms
+ *  "seek 20"                  → jump the running replay to ply 20
+ *  "speed 200"                → change the pace of the running replay
+ *  "stopreplay"               → end the running replay
+ *
+ * The first line a client sends is its name. "alice 9f86d081884c7d65" (name
+ * and session token) instead takes back alice's session after a dropped
+ * connection, seat in a running match included.
+ *
+ * Client commands are terminated by '\n', so several of them can be sent
+ * back to back without waiting for the replies.
  */
 
 /* MESSAGE TYPES - Server to Client responses */
@@ -34,7 +59,7 @@ typedef enum
     MSG_CHALLENGE = 3,
     MSG_CHALLENGE_RESPONSE = 4,
     MSG_MOVE = 5,
-    MSG_BOARD_UPDATE = 6,
+    MSG_BOARD_UPDATE = 6, // no longer sent: boards go out as MSG_BOARD_STATE / MSG_BOARD_DELTA
     MSG_GAME_OVER = 7,
     MSG_ERROR = 8,
     MSG_INFO = 9,
@@ -46,9 +71,46 @@ typedef enum
     MSG_FRIEND_RESPONSE = 15,
     MSG_FRIEND_LIST = 16,
     MSG_RANK_LIST = 17,
-    MSG_REPLAY_DATA = 18
+    MSG_REPLAY_DATA = 18,
+    MSG_BOARD_STATE = 19,
+    MSG_ANALYSIS = 20,
+    MSG_BOARD_DELTA = 21,
+    MSG_HISTORY = 22
 } MessageType;
 
+/* Structured board (MSG_BOARD_STATE payload), see protocol_format_board:
+ *  "<match> <ply> <seat> <to_move> <pit0> ... <pit11> <score0> <score1> <player1> <player2>"
+ * seat is 0/1 for the players and -1 for watchers. */
+typedef struct
+{
+    int match_id;
+    int ply;
+    int seat;
+    int current_player;
+    int pits[TOTAL_PITS];
+    int score[2];
+    char players[2][MAX_USERNAME_LEN];
+} BoardState;
+
+/* Board change of one move (MSG_BOARD_DELTA payload), see protocol_format_delta:
+ *  "<match> <ply> <pit> <to_move> <captured> <score0> <score1> <pit>=<seeds>,..."
+ * ply is the sequence number: the ply the move leads to. Only the pits whose
+ * seed count changed are listed. A delta applies to the board at ply - 1;
+ * a client that missed one asks for a keyframe (MSG_BOARD_STATE) with
+ * "sync". */
+typedef struct
+{
+    int match_id;
+    int ply;
+    int pit; // pit played
+    int current_player;
+    int captured; // seeds taken by the move
+    int score[2];
+    int changed; // entries used in pits / seeds
+    int pits[TOTAL_PITS];
+    int seeds[TOTAL_PITS];
+} BoardDelta;
+
 /* CLIENT COMMANDS - Client to Server requests */
 #define CMD_MSG "msg"
 #define CMD_LIST_USERS "list"
@@ -57,6 +119,7 @@ typedef enum
 #define CMD_REFUSE "refuse"
 #define CMD_MOVE "move"
 #define CMD_WATCH "watch"
+#define CMD_ANALYZE "analyze"
 #define CMD_SET_BIO "bio"
 #define CMD_GET_BIO "getbio"
 #define CMD_PM "pm"
@@ -71,6 +134,18 @@ typedef enum
 #define CMD_FRIENDS "friends"
 #define CMD_RANKING "ranking"
 #define CMD_WATCH_REPLAY "watchreplay"
+#define CMD_QUEUE "queue"
+#define CMD_UNQUEUE "unqueue"
+#define CMD_BOARD "board"
+#define CMD_VARIANT "variant"
+#define CMD_RESUME "resume"
+#define CMD_SEEK "seek"
+#define CMD_SPEED "speed"
+#define CMD_STOP_REPLAY "stopreplay"
+#define CMD_JOIN "join"
+#define CMD_ROOMS "rooms"
+#define CMD_SYNC "sync"
+#define CMD_HISTORY "history"
 
 /* Create a formatted message from type and payload */
 void protocol_create_message(char *buffer, size_t buf_size, MessageType type, const char *payload);
@@ -81,6 +156,22 @@ int protocol_parse_message(const char *buffer, MessageType *type, char *payload)
 /* Check if a client input is a recognized command */
 int protocol_is_command(const char *input);
 
+/* Write a BoardState as a MSG_BOARD_STATE payload; returns snprintf's length */
+int protocol_format_board(char *buffer, size_t buf_size, const BoardState *state);
+
+/* Parse a MSG_BOARD_STATE payload - returns 1 on success */
+int protocol_parse_board(const char *payload, BoardState *state);
+
+/* Write a BoardDelta as a MSG_BOARD_DELTA payload; returns snprintf's length */
+int protocol_format_delta(char *buffer, size_t buf_size, const BoardDelta *delta);
+
+/* Parse a MSG_BOARD_DELTA payload - returns 1 on success */
+int protocol_parse_delta(const char *payload, BoardDelta *delta);
+
+/* Bring `state` forward by one move. Returns 0, leaving it untouched, if
+ * the delta is for another match or does not follow state->ply (a gap). */
+int protocol_apply_delta(BoardState *state, const BoardDelta *delta);
+
 /* Extract command keyword and arguments */
 void protocol_parse_command(const char *input, char *command, char *args, size_t cmd_size, size_t args_size);
 
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "core/awale.h"
+#include "engine/engine.h"
+#include "engine/pool.h"
+#include "utils/clock.h"
+#include "utils/constants.h"
+
+/*
+ * Engine-vs-engine tournament: every game is one pool task. Games come in
+ * pairs sharing a random opening, with engine A playing first in one and
+ * second in the other, so neither the opening nor the first move favours
+ * a side.
+ */
+
+typedef struct
+{
+    long long nodes;
+    char pad[64 - sizeof(long long)]; // one cache line per worker
+} WorkerNodes;
+
+typedef struct
+{
+    EngineParams a;
+    EngineParams b;
+    int opening_plies;
+    int max_plies;
+    unsigned int seed;
+    signed char *results; // per game, from A's point of view: 1, 0, -1
+    WorkerNodes *nodes;
+} Tournament;
+
+static void display_help_menu(char *exec_name)
+{
+    printf("Usage: %s [--games <n>] [--threads <n>] [--a <params>] [--b <params>]\n", exec_name);
+    printf("Options:\n");
+    printf("  --games <n>            Number of games, rounded up to an even number (default: 1000)\n");
+    printf("  --threads <n>          Worker threads (default: number of CPUs)\n");
+    printf("  --a <params>           Engine A, e.g. depth=6,score=100,seeds=2,mobility=5\n");
+    printf("  --b <params>           Engine B (same format, default parameters otherwise)\n");
+    printf("  --opening <plies>      Random plies played before the engines take over (default: 4)\n");
+    printf("  --max-plies <n>        Adjudicate on captured seeds after this many plies (default: 400)\n");
+    printf("  --seed <n>             Seed of the random openings (default: 1)\n");
+    printf("  --help                 Show this help message\n");
+}
+
+static unsigned int next_random(unsigned int *state)
+{
+    /* xorshift32 */
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// Random opening shared by both games of a pair (retried if it ends the game)
+static void random_opening(Board *board, unsigned int seed, int plies)
+{
+    unsigned int rng = seed * 2654435761u + 1;
+    for (int attempt = 0; attempt < 16; attempt++)
+    {
+        init_board(board);
+        int ply = 0;
+        for (; ply < plies; ply++)
+        {
+            int moves[PITS_PER_PLAYER];
+            int count = legal_moves(board, moves);
+            if (count == 0)
+                break;
+            apply_move(board, moves[next_random(&rng) % count]);
+        }
+        if (ply == plies && !is_game_over(board))
+            return;
+    }
+}
+
+static void play_game(int game, int worker, void *ctx)
+{
+    Tournament *t = ctx;
+    Board board;
+    random_opening(&board, t->seed + (unsigned int)(game / 2), t->opening_plies);
+
+    // in odd games engine A takes the other side of the same opening
+    int a_player = (game % 2 == 0) ? board.current_player : 1 - board.current_player;
+    EngineStats stats = {0};
+    for (int ply = 0; ply < t->max_plies && !is_game_over(&board); ply++)
+    {
+        const EngineParams *params = board.current_player == a_player ? &t->a : &t->b;
+        int pit;
+        engine_search(&board, params, &stats, &pit);
+        if (pit < 0)
+            break;
+        apply_move(&board, pit);
+    }
+
+    int diff = board.score[a_player] - board.score[1 - a_player];
+    t->results[game] = diff > 0 ? 1 : (diff < 0 ? -1 : 0);
+    t->nodes[worker].nodes += stats.nodes;
+}
+
+// Elo difference for an expected score in (0, 1)
+static double elo_of(double score)
+{
+    if (score <= 0.0)
+        score = 1e-6;
+    if (score >= 1.0)
+        score = 1.0 - 1e-6;
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+int main(int argc, char **argv)
+{
+    Tournament t;
+    engine_default_params(&t.a);
+    engine_default_params(&t.b);
+    t.opening_plies = 4;
+    t.max_plies = 400;
+    t.seed = 1;
+    int games = 1000;
+    int threads = pool_default_threads();
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        int ok = value != NULL;
+        if (strcmp(argv[i], "--help") == 0)
+        {
+            display_help_menu(argv[0]);
+            return EXIT_SUCCESS;
+        }
+        else if (ok && strcmp(argv[i], "--games") == 0)
+            games = atoi(value);
+        else if (ok && strcmp(argv[i], "--threads") == 0)
+            threads = atoi(value);
+        else if (ok && strcmp(argv[i], "--a") == 0)
+            ok = engine_parse_params(value, &t.a);
+        else if (ok && strcmp(argv[i], "--b") == 0)
+            ok = engine_parse_params(value, &t.b);
+        else if (ok && strcmp(argv[i], "--opening") == 0)
+            t.opening_plies = atoi(value);
+        else if (ok && strcmp(argv[i], "--max-plies") == 0)
+            t.max_plies = atoi(value);
+        else if (ok && strcmp(argv[i], "--seed") == 0)
+            t.seed = (unsigned int)strtoul(value, NULL, 10);
+        else
+            ok = 0;
+        if (!ok)
+        {
+            fprintf(stderr, "%s[error]%s Invalid argument: %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, argv[i]);
+            display_help_menu(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i++;
+    }
+    if (games < 2 || threads < 1 || t.opening_plies < 0 || t.max_plies < 1)
+    {
+        fprintf(stderr, "%s[error]%s Need at least 2 games, 1 thread and positive ply limits\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+        return EXIT_FAILURE;
+    }
+    games += games % 2;
+    if (threads > POOL_MAX_THREADS)
+        threads = POOL_MAX_THREADS;
+
+    t.results = calloc(games, sizeof(signed char));
+    void *nodes = NULL;
+    if (posix_memalign(&nodes, 64, sizeof(WorkerNodes) * threads) != 0 || !t.results)
+    {
+        fprintf(stderr, "%s[error]%s Out of memory\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+        return EXIT_FAILURE;
+    }
+    t.nodes = nodes;
+    memset(t.nodes, 0, sizeof(WorkerNodes) * threads);
+
+    char a_desc[128];
+    char b_desc[128];
+    engine_format_params(&t.a, a_desc, sizeof(a_desc));
+    engine_format_params(&t.b, b_desc, sizeof(b_desc));
+    printf("%s[selfplay]%s A (%s) vs B (%s): %d games on %d threads\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, a_desc, b_desc, games, threads);
+
+    long long start = monotonic_ms();
+    if (pool_run(threads, games, play_game, &t) != 0)
+    {
+        fprintf(stderr, "%s[error]%s Could not start worker threads\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+        return EXIT_FAILURE;
+    }
+    double seconds = (monotonic_ms() - start) / 1000.0;
+    if (seconds <= 0)
+        seconds = 0.001;
+
+    int wins = 0, draws = 0, losses = 0;
+    for (int g = 0; g < games; g++)
+    {
+        if (t.results[g] > 0)
+            wins++;
+        else if (t.results[g] < 0)
+            losses++;
+        else
+            draws++;
+    }
+    long long total_nodes = 0;
+    for (int w = 0; w < threads; w++)
+        total_nodes += t.nodes[w].nodes;
+
+    // 95% interval of A's score from the per-game variance (win=1, draw=1/2, loss=0)
+    double n = games;
+    double score = (wins + 0.5 * draws) / n;
+    double variance = (wins * (1.0 - score) * (1.0 - score) +
+                       draws * (0.5 - score) * (0.5 - score) +
+                       losses * score * score) / n;
+    double margin = 1.96 * sqrt(variance / n);
+
+    printf("%s[selfplay]%s W/D/L for A: %d/%d/%d in %.2fs\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET, wins, draws, losses, seconds);
+    printf("%s[selfplay]%s score %.1f%% +/- %.1f%%, Elo %+.1f [%+.1f, %+.1f]\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET,
+           100.0 * score, 100.0 * margin, elo_of(score), elo_of(score - margin), elo_of(score + margin));
+    printf("%s[selfplay]%s %lld nodes, %.2f Mnodes/s (%.2f per thread)\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET,
+           total_nodes, total_nodes / seconds / 1e6, total_nodes / seconds / 1e6 / threads);
+
+    free(t.results);
+    free(t.nodes);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+#include <string.h>
+#include <pthread.h>
+#include "analysis.h"
+
+typedef struct
+{
+   int match_id;
+   int ply;
+   Board board;
+} AnalysisJob;
+
+static struct
+{
+   EngineTable table;
+   int table_ready;
+   AnalysisJob queue[ANALYSIS_QUEUE]; // waiting searches, oldest at head
+   int head;
+   int count;
+   // the search on the worker thread
+   AnalysisJob current;
+   int has_current;
+   int running; // __atomic: cleared by the worker when the result is ready
+   pthread_t worker;
+   int worker_started;
+   EngineAnalysis result;
+} an;
+
+static void *worker_main(void *arg)
+{
+   (void)arg;
+   EngineParams params;
+   engine_default_params(&params);
+   params.depth = ENGINE_MAX_DEPTH;
+   engine_analyze(&an.current.board, &params, &an.table, ANALYSIS_THREADS, ANALYSIS_TIME_MS, &an.result);
+   __atomic_store_n(&an.running, 0, __ATOMIC_RELEASE);
+   return NULL;
+}
+
+static void start_next(void)
+{
+   if (an.has_current || an.count == 0)
+      return;
+   an.current = an.queue[an.head];
+   an.head = (an.head + 1) % ANALYSIS_QUEUE;
+   an.count--;
+   an.has_current = 1;
+   __atomic_store_n(&an.running, 1, __ATOMIC_RELEASE);
+   if (pthread_create(&an.worker, NULL, worker_main, NULL) == 0)
+      an.worker_started = 1;
+   else
+      worker_main(NULL); // no thread: search on the loop rather than never answer
+}
+
+static int same_job(const AnalysisJob *job, int match_id, int ply)
+{
+   return job->match_id == match_id && job->ply == ply;
+}
+
+int analysis_submit(int match_id, int ply, const Board *board)
+{
+   if (!an.table_ready)
+   {
+      if (engine_table_init(&an.table, ANALYSIS_HASH_MB) != 0)
+         return -1;
+      an.table_ready = 1;
+   }
+   if (an.has_current && same_job(&an.current, match_id, ply))
+      return 1;
+   for (int i = 0; i < an.count; i++)
+   {
+      if (same_job(&an.queue[(an.head + i) % ANALYSIS_QUEUE], match_id, ply))
+         return 1;
+   }
+   if (an.count == ANALYSIS_QUEUE)
+      return 0;
+   AnalysisJob *job = &an.queue[(an.head + an.count) % ANALYSIS_QUEUE];
+   job->match_id = match_id;
+   job->ply = ply;
+   job->board = *board;
+   an.count++;
+   start_next();
+   return 1;
+}
+
+int analysis_busy(void)
+{
+   return an.has_current || an.count > 0;
+}
+
+int analysis_poll(int *match_id, int *ply, Board *board, EngineAnalysis *result)
+{
+   if (!an.has_current || __atomic_load_n(&an.running, __ATOMIC_ACQUIRE))
+      return 0;
+   if (an.worker_started)
+      pthread_join(an.worker, NULL);
+   an.worker_started = 0;
+   *match_id = an.current.match_id;
+   *ply = an.current.ply;
+   *board = an.current.board;
+   *result = an.result;
+   an.has_current = 0;
+   start_next();
+   return 1;
+}
+
+void analysis_close(void)
+{
+   if (an.worker_started)
+      pthread_join(an.worker, NULL);
+   if (an.table_ready)
+      engine_table_free(&an.table);
+   memset(&an, 0, sizeof(an));
+}
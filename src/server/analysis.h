@@ -0,0 +1,35 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "../core/awale.h"
+#include "../engine/engine.h"
+
+/*
+ * BACKGROUND ANALYSIS
+ * ===================
+ * The searches of the analyze command run on a worker thread, so the event
+ * loop never waits ANALYSIS_TIME_MS for one. A request is queued with a
+ * copy of the position; the loop collects the result with analysis_poll()
+ * on a TIMER_ANALYSIS tick and answers everybody who asked for it. Only one
+ * search runs at a time, which caps what analyze takes from the server at
+ * ANALYSIS_THREADS cores however many clients ask, and a request for a
+ * position that is already queued or being searched joins it.
+ */
+
+/* Queue a search of `board`, the position of match `match_id` at `ply`,
+ * and start it if the worker is idle. Returns 1 if it is queued (or was
+ * already), 0 if ANALYSIS_QUEUE searches are waiting, -1 if the search
+ * table cannot be allocated. */
+int analysis_submit(int match_id, int ply, const Board *board);
+
+/* 1 while a search is running or queued */
+int analysis_busy(void);
+
+/* A finished search: its match, ply, position and result. Returns 1, or 0
+ * if none has finished; the next queued search is started. */
+int analysis_poll(int *match_id, int *ply, Board *board, EngineAnalysis *result);
+
+/* Wait for the running search, drop the queue and free the table */
+void analysis_close(void);
+
+#endif
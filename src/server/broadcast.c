@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include "broadcast.h"
+#include "../protocol/protocol.h"
+
+int broadcast_init(BroadcastLog *log, int capacity)
+{
+   log->entries = calloc((size_t)capacity, sizeof(BroadcastEntry));
+   log->capacity = capacity;
+   log->head = 0;
+   return log->entries ? 0 : -1;
+}
+
+void broadcast_free(BroadcastLog *log)
+{
+   free(log->entries);
+   log->entries = NULL;
+}
+
+void broadcast_append(BroadcastLog *log, int sender_id, const char *frame, size_t len)
+{
+   if (!log->entries || len < sizeof(size_t))
+      return;
+   BroadcastEntry *e = &log->entries[log->head % log->capacity];
+   if (len > sizeof(e->data))
+      len = sizeof(e->data);
+   memcpy(e->data, frame, len);
+   size_t message_len = len - sizeof(size_t); // the prefix follows a cut
+   memcpy(e->data, &message_len, sizeof(size_t));
+   e->len = len;
+   e->sender_id = sender_id;
+   e->seq = log->head++;
+}
+
+/* The rest of a frame the socket could only take part of. It goes out
+ * before anything else is written to that socket, so frames stay whole. */
+typedef struct
+{
+   char data[sizeof(((BroadcastEntry *)0)->data) + 128];
+   size_t len;
+   size_t off;
+} Spill;
+
+static Spill *spills[FD_SETSIZE]; // by socket, allocated on first use
+
+// Send what the socket takes without blocking; returns 1 if all of it went,
+// 0 if the rest was spilled, -1 on a dead connection
+static int send_some(int sock, const char *data, size_t len)
+{
+   ssize_t n = send(sock, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+   if (n < 0)
+   {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+         return -1; // the read side notices the dead connection
+      n = 0;
+   }
+   if ((size_t)n == len)
+      return 1;
+   if (sock >= FD_SETSIZE || (!spills[sock] && !(spills[sock] = malloc(sizeof(Spill)))))
+      return -1;
+   Spill *sp = spills[sock];
+   sp->len = len - (size_t)n;
+   sp->off = 0;
+   memcpy(sp->data, data + n, sp->len);
+   return 0;
+}
+
+// Push out a spilled remainder; 1 once there is none left
+static int send_spill(int sock, int block)
+{
+   Spill *sp = sock >= 0 && sock < FD_SETSIZE ? spills[sock] : NULL;
+   while (sp && sp->off < sp->len)
+   {
+      ssize_t n = send(sock, sp->data + sp->off, sp->len - sp->off, (block ? 0 : MSG_DONTWAIT) | MSG_NOSIGNAL);
+      if (n < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         if (errno != EAGAIN && errno != EWOULDBLOCK)
+            sp->off = sp->len; // dead connection, nothing to keep
+         return sp->off >= sp->len;
+      }
+      sp->off += (size_t)n;
+   }
+   return 1;
+}
+
+void broadcast_flush(int sock)
+{
+   send_spill(sock, 1);
+}
+
+int broadcast_spilled(int sock)
+{
+   return sock >= 0 && sock < FD_SETSIZE && spills[sock] && spills[sock]->off < spills[sock]->len;
+}
+
+void broadcast_forget(int sock)
+{
+   if (sock >= 0 && sock < FD_SETSIZE && spills[sock])
+      spills[sock]->len = spills[sock]->off = 0;
+}
+
+int broadcast_deliver(BroadcastLog *log, int sock, int reader_id, uint64_t *cursor)
+{
+   if (!log->entries || sock < 0)
+      return 0;
+   if (!send_spill(sock, 0))
+      return 1;
+   if (log->head - *cursor > (uint64_t)log->capacity)
+   {
+      // overwritten before this reader got them
+      uint64_t missed = log->head - log->capacity - *cursor;
+      *cursor = log->head - log->capacity;
+      char notice[sizeof(size_t) + 128];
+      int n = snprintf(notice + sizeof(size_t), sizeof(notice) - sizeof(size_t), "%d|%llu chat messages skipped (connection too slow)",
+                       MSG_INFO, (unsigned long long)missed);
+      size_t message_len = (size_t)n;
+      memcpy(notice, &message_len, sizeof(size_t));
+      int sent = send_some(sock, notice, sizeof(size_t) + message_len);
+      if (sent <= 0)
+         return sent == 0;
+   }
+   while (*cursor < log->head)
+   {
+      const BroadcastEntry *e = &log->entries[*cursor % log->capacity];
+      (*cursor)++;
+      if (e->sender_id == reader_id)
+         continue;
+      int sent = send_some(sock, e->data, e->len);
+      if (sent < 0)
+      {
+         *cursor = log->head;
+         return 0;
+      }
+      if (sent == 0)
+         return 1; // the entry is spilled, the socket is full
+   }
+   return 0;
+}
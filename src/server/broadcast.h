@@ -0,0 +1,62 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../utils/constants.h"
+
+/*
+ * BROADCAST LOG
+ * =============
+ * Messages for a group of readers (a chat room: its chat and the server
+ * notices) are appended once, already framed, to a ring of entries. Every
+ * reader owns a cursor (the sequence number of the next entry it should
+ * get) and is served from the log when its socket can take more: a message
+ * costs one copy however many clients receive it, and the sender never
+ * waits for the recipients.
+ *
+ * Delivery never blocks: what a full socket does not take of an entry is
+ * kept aside (one frame at most per socket) and sent first the next time,
+ * and broadcast_flush() completes it before a direct reply is written, so
+ * frames never interleave. A reader that falls more than the ring behind
+ * skips to the oldest entry still kept and is told how many messages it
+ * missed.
+ */
+
+typedef struct
+{
+   uint64_t seq;
+   int sender_id; // reader that does not get its own message (-1: nobody)
+   size_t len;    // framed bytes in data
+   char data[sizeof(size_t) + BUF_SIZE + MAX_USERNAME_LEN + 16];
+} BroadcastEntry;
+
+typedef struct
+{
+   BroadcastEntry *entries; // ring of capacity entries
+   int capacity;
+   uint64_t head;           // sequence number of the next entry
+} BroadcastLog;
+
+/* A log keeping the last `capacity` messages. Returns 0 on success, -1 if
+ * out of memory */
+int broadcast_init(BroadcastLog *log, int capacity);
+void broadcast_free(BroadcastLog *log);
+
+/* Append a framed message ([size_t length]["TYPE|payload"]); longer
+ * messages are cut to fit an entry */
+void broadcast_append(BroadcastLog *log, int sender_id, const char *frame, size_t len);
+
+/* Send `sock` what it can take of the log from *cursor on, advancing the
+ * cursor. Returns 1 while entries remain (wait until the socket is
+ * writable), 0 once the reader is up to date. */
+int broadcast_deliver(BroadcastLog *log, int sock, int reader_id, uint64_t *cursor);
+
+/* Finish (blocking) the frame cut on `sock`, before writing to it directly */
+void broadcast_flush(int sock);
+/* Whether part of a frame still waits to go out on `sock` */
+int broadcast_spilled(int sock);
+/* Drop what is left for `sock`; call before closing it (fds are reused) */
+void broadcast_forget(int sock);
+
+#endif
@@ -0,0 +1,616 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "history.h"
+
+#define HISTORY_MAGIC "AWHI"
+#define HISTORY_VERSION 2
+#define HISTORY_LOG "history.log"
+#define HISTORY_MERGING "history.merging"
+#define HISTORY_INDEX "history.idx"
+#define HISTORY_IO_RECORDS 1024 // records per read or write while merging
+
+typedef struct
+{
+   char magic[4];
+   uint32_t version;
+   uint64_t count;      // records following the header, sorted by key
+   uint64_t merged_seq; // highest seq among them (0: none)
+} HistoryHeader;
+
+typedef struct
+{
+   uint64_t player;
+   int64_t ended_at;
+   uint64_t seq;
+} HistoryKey;
+
+typedef struct
+{
+   HistoryRecord *items;
+   size_t count;
+   size_t capacity;
+} RecordList;
+
+static struct
+{
+   int enabled;
+   char dir[1024];
+   int log_fd;
+   uint64_t next_seq;
+   // sorted file
+   int index_fd; // -1: no merge yet
+   uint64_t index_count;
+   uint64_t merged_seq;
+   HistoryKey *sparse; // key of record i * HISTORY_SPARSE_EVERY
+   size_t sparse_count;
+   // in memory, sorted by key
+   RecordList tail;    // recorded since the last merge started
+   RecordList merging; // being merged (read-only while the merger runs)
+   // background merge, installed by the main thread once done
+   pthread_t merger;
+   int merger_started;
+   int merger_running; // __atomic
+   int merge_ok;
+   HistoryKey *new_sparse;
+   uint64_t new_count;
+   uint64_t new_merged_seq;
+} hist;
+
+static HistoryKey key_of(const HistoryRecord *r)
+{
+   HistoryKey k = {r->player, r->ended_at, r->seq};
+   return k;
+}
+
+static int compare_keys(const HistoryKey *a, const HistoryKey *b)
+{
+   if (a->player != b->player)
+      return a->player < b->player ? -1 : 1;
+   if (a->ended_at != b->ended_at)
+      return a->ended_at < b->ended_at ? -1 : 1;
+   return a->seq < b->seq ? -1 : (a->seq > b->seq);
+}
+
+static int compare_records(const void *a, const void *b)
+{
+   HistoryKey ka = key_of(a);
+   HistoryKey kb = key_of(b);
+   return compare_keys(&ka, &kb);
+}
+
+static void history_path(char *out, size_t size, const char *name)
+{
+   snprintf(out, size, "%s/%s", hist.dir, name);
+}
+
+static void report(const char *what)
+{
+   fprintf(stderr, "%s[history]%s %s: %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, what, strerror(errno));
+}
+
+static int list_reserve(RecordList *list, size_t count)
+{
+   if (count <= list->capacity)
+      return 0;
+   size_t capacity = list->capacity ? list->capacity : HISTORY_MERGE_RECORDS;
+   while (capacity < count)
+      capacity *= 2;
+   HistoryRecord *grown = realloc(list->items, capacity * sizeof(HistoryRecord));
+   if (!grown)
+      return -1;
+   list->items = grown;
+   list->capacity = capacity;
+   return 0;
+}
+
+// Index of the first record with a key above `key` (list sorted by key)
+static size_t upper_bound(const HistoryRecord *items, size_t count, const HistoryKey *key)
+{
+   size_t lo = 0, hi = count;
+   while (lo < hi)
+   {
+      size_t mid = lo + (hi - lo) / 2;
+      HistoryKey k = key_of(&items[mid]);
+      if (compare_keys(&k, key) <= 0)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   return lo;
+}
+
+static int list_insert(RecordList *list, const HistoryRecord *r)
+{
+   if (list_reserve(list, list->count + 1) != 0)
+      return -1;
+   HistoryKey k = key_of(r);
+   size_t at = upper_bound(list->items, list->count, &k);
+   memmove(&list->items[at + 1], &list->items[at], (list->count - at) * sizeof(HistoryRecord));
+   list->items[at] = *r;
+   list->count++;
+   return 0;
+}
+
+static int write_all(int fd, const void *data, size_t len)
+{
+   const char *p = data;
+   while (len > 0)
+   {
+      ssize_t n = write(fd, p, len);
+      if (n < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         return -1;
+      }
+      p += n;
+      len -= (size_t)n;
+   }
+   return 0;
+}
+
+uint64_t history_player_key(const char *name)
+{
+   /* FNV-1a */
+   uint64_t h = 14695981039346656037ULL;
+   for (const unsigned char *p = (const unsigned char *)name; *p; p++)
+   {
+      h ^= *p;
+      h *= 1099511628211ULL;
+   }
+   return h;
+}
+
+/* ---- loading ---- */
+
+static int load_index(void)
+{
+   char path[1100];
+   history_path(path, sizeof(path), HISTORY_INDEX);
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return errno == ENOENT ? 0 : -1;
+   HistoryHeader h;
+   struct stat st;
+   if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || fstat(fd, &st) != 0 ||
+       memcmp(h.magic, HISTORY_MAGIC, 4) != 0 || h.version != HISTORY_VERSION ||
+       (uint64_t)st.st_size < sizeof(h) + h.count * sizeof(HistoryRecord))
+   {
+      close(fd);
+      errno = EINVAL;
+      return -1;
+   }
+   size_t sparse_count = (size_t)((h.count + HISTORY_SPARSE_EVERY - 1) / HISTORY_SPARSE_EVERY);
+   HistoryKey *sparse = malloc((sparse_count ? sparse_count : 1) * sizeof(HistoryKey));
+   if (!sparse)
+   {
+      close(fd);
+      return -1;
+   }
+   for (size_t i = 0; i < sparse_count; i++)
+   {
+      HistoryRecord r;
+      off_t at = (off_t)(sizeof(h) + (uint64_t)i * HISTORY_SPARSE_EVERY * sizeof(HistoryRecord));
+      if (pread(fd, &r, sizeof(r), at) != (ssize_t)sizeof(r))
+      {
+         free(sparse);
+         close(fd);
+         errno = EIO;
+         return -1;
+      }
+      sparse[i] = key_of(&r);
+   }
+   hist.index_fd = fd;
+   hist.index_count = h.count;
+   hist.merged_seq = h.merged_seq;
+   hist.sparse = sparse;
+   hist.sparse_count = sparse_count;
+   return 0;
+}
+
+// Records of a log not merged yet go to the tail (unsorted until open ends)
+static int load_log(const char *name)
+{
+   char path[1100];
+   history_path(path, sizeof(path), name);
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return errno == ENOENT ? 0 : -1;
+   HistoryRecord buf[64];
+   ssize_t n;
+   while ((n = read(fd, buf, sizeof(buf))) > 0)
+   {
+      // a record cut by a crash is dropped
+      for (size_t i = 0; i < (size_t)n / sizeof(HistoryRecord); i++)
+      {
+         if (buf[i].seq <= hist.merged_seq)
+            continue;
+         if (list_reserve(&hist.tail, hist.tail.count + 1) != 0)
+         {
+            close(fd);
+            return -1;
+         }
+         hist.tail.items[hist.tail.count++] = buf[i];
+         if (buf[i].seq >= hist.next_seq)
+            hist.next_seq = buf[i].seq + 1;
+      }
+   }
+   close(fd);
+   return n < 0 ? -1 : 0;
+}
+
+// Replace the log with the records of the tail
+static int rewrite_log(void)
+{
+   char path[1100], tmp[1100];
+   history_path(path, sizeof(path), HISTORY_LOG);
+   history_path(tmp, sizeof(tmp), HISTORY_LOG ".tmp");
+   int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0)
+      return -1;
+   int ok = write_all(fd, hist.tail.items, hist.tail.count * sizeof(HistoryRecord)) == 0 && fdatasync(fd) == 0;
+   close(fd);
+   if (!ok || rename(tmp, path) != 0)
+   {
+      unlink(tmp);
+      return -1;
+   }
+   return 0;
+}
+
+static int open_log(void)
+{
+   char path[1100];
+   history_path(path, sizeof(path), HISTORY_LOG);
+   hist.log_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+   return hist.log_fd < 0 ? -1 : 0;
+}
+
+int history_open(const char *dir)
+{
+   if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+      return -1;
+   memset(&hist, 0, sizeof(hist));
+   hist.index_fd = -1;
+   hist.log_fd = -1;
+   hist.next_seq = 1;
+   snprintf(hist.dir, sizeof(hist.dir), "%s", dir);
+   char path[1100];
+   history_path(path, sizeof(path), HISTORY_INDEX ".tmp");
+   unlink(path); // leftover of an interrupted merge
+   if (load_index() != 0)
+      return -1;
+   if (hist.merged_seq >= hist.next_seq)
+      hist.next_seq = hist.merged_seq + 1;
+   // a log set aside by an interrupted merge is folded back into the live one
+   if (load_log(HISTORY_MERGING) != 0 || load_log(HISTORY_LOG) != 0 || rewrite_log() != 0 || open_log() != 0)
+   {
+      history_close();
+      return -1;
+   }
+   history_path(path, sizeof(path), HISTORY_MERGING);
+   unlink(path);
+   if (hist.tail.count > 1)
+      qsort(hist.tail.items, hist.tail.count, sizeof(HistoryRecord), compare_records);
+   hist.enabled = 1;
+   return 0;
+}
+
+/* ---- merging ---- */
+
+// Merge the sorted file and the `merging` records into a new sorted file
+static int merge_index(void)
+{
+   char path[1100], tmp[1100];
+   history_path(path, sizeof(path), HISTORY_INDEX);
+   history_path(tmp, sizeof(tmp), HISTORY_INDEX ".tmp");
+   uint64_t total = hist.index_count + hist.merging.count;
+   uint64_t merged_seq = hist.merged_seq;
+   for (size_t j = 0; j < hist.merging.count; j++)
+      merged_seq = hist.merging.items[j].seq > merged_seq ? hist.merging.items[j].seq : merged_seq;
+
+   HistoryRecord *in = malloc(HISTORY_IO_RECORDS * sizeof(HistoryRecord));
+   HistoryRecord *out = malloc(HISTORY_IO_RECORDS * sizeof(HistoryRecord));
+   hist.new_sparse = malloc((size_t)((total + HISTORY_SPARSE_EVERY - 1) / HISTORY_SPARSE_EVERY + 1) * sizeof(HistoryKey));
+   int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   int ok = in && out && hist.new_sparse && fd >= 0;
+   HistoryHeader h;
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, HISTORY_MAGIC, 4);
+   h.version = HISTORY_VERSION;
+   h.count = total;
+   h.merged_seq = merged_seq;
+   ok = ok && write_all(fd, &h, sizeof(h)) == 0;
+
+   uint64_t read_at = 0; // next record of the old file to read
+   size_t in_len = 0, in_pos = 0, out_len = 0, j = 0;
+   for (uint64_t n = 0; ok && n < total; n++)
+   {
+      if (in_pos == in_len && read_at < hist.index_count)
+      {
+         uint64_t left = hist.index_count - read_at;
+         in_len = (size_t)(left < HISTORY_IO_RECORDS ? left : HISTORY_IO_RECORDS);
+         in_pos = 0;
+         off_t at = (off_t)(sizeof(h) + read_at * sizeof(HistoryRecord));
+         ok = pread(hist.index_fd, in, in_len * sizeof(HistoryRecord), at) == (ssize_t)(in_len * sizeof(HistoryRecord));
+         read_at += in_len;
+         if (!ok)
+            break;
+      }
+      const HistoryRecord *r;
+      if (in_pos < in_len && (j == hist.merging.count || compare_records(&in[in_pos], &hist.merging.items[j]) <= 0))
+         r = &in[in_pos++];
+      else
+         r = &hist.merging.items[j++];
+      if (n % HISTORY_SPARSE_EVERY == 0)
+         hist.new_sparse[n / HISTORY_SPARSE_EVERY] = key_of(r);
+      out[out_len++] = *r;
+      if (out_len == HISTORY_IO_RECORDS || n + 1 == total)
+      {
+         ok = write_all(fd, out, out_len * sizeof(HistoryRecord)) == 0;
+         out_len = 0;
+      }
+   }
+   ok = ok && fdatasync(fd) == 0;
+   if (fd >= 0)
+      close(fd);
+   free(in);
+   free(out);
+   // the rename is atomic: a crash leaves the old file or the new one
+   if (!ok || rename(tmp, path) != 0)
+   {
+      unlink(tmp);
+      return -1;
+   }
+   hist.new_count = total;
+   hist.new_merged_seq = merged_seq;
+   return 0;
+}
+
+static void *merger_main(void *arg)
+{
+   (void)arg;
+   hist.merge_ok = merge_index() == 0;
+   __atomic_store_n(&hist.merger_running, 0, __ATOMIC_RELEASE);
+   return NULL;
+}
+
+// Put the merged records back into the log and the tail after a failure
+static void abandon_merge(void)
+{
+   for (size_t j = 0; j < hist.merging.count; j++)
+      list_insert(&hist.tail, &hist.merging.items[j]);
+   if (write_all(hist.log_fd, hist.merging.items, hist.merging.count * sizeof(HistoryRecord)) != 0)
+      report("write");
+   char path[1100];
+   history_path(path, sizeof(path), HISTORY_MERGING);
+   unlink(path);
+   free(hist.merging.items);
+   memset(&hist.merging, 0, sizeof(hist.merging));
+   free(hist.new_sparse);
+   hist.new_sparse = NULL;
+}
+
+// Wait for the merger and install what it wrote (main thread)
+static void finish_merge(void)
+{
+   pthread_join(hist.merger, NULL);
+   hist.merger_started = 0;
+   char path[1100];
+   history_path(path, sizeof(path), HISTORY_INDEX);
+   int fd = hist.merge_ok ? open(path, O_RDONLY) : -1;
+   if (fd < 0)
+   {
+      report("merge");
+      abandon_merge();
+      return;
+   }
+   if (hist.index_fd >= 0)
+      close(hist.index_fd);
+   hist.index_fd = fd;
+   hist.index_count = hist.new_count;
+   hist.merged_seq = hist.new_merged_seq;
+   free(hist.sparse);
+   hist.sparse = hist.new_sparse;
+   hist.sparse_count = (size_t)((hist.new_count + HISTORY_SPARSE_EVERY - 1) / HISTORY_SPARSE_EVERY);
+   hist.new_sparse = NULL;
+   free(hist.merging.items);
+   memset(&hist.merging, 0, sizeof(hist.merging));
+   history_path(path, sizeof(path), HISTORY_MERGING);
+   unlink(path);
+}
+
+static void poll_merge(void)
+{
+   if (hist.merger_started && !__atomic_load_n(&hist.merger_running, __ATOMIC_ACQUIRE))
+      finish_merge();
+}
+
+// Set the log aside and merge its records in the background
+static void start_merge(void)
+{
+   if (hist.merger_started)
+      return;
+   char log_path[1100], merging_path[1100];
+   history_path(log_path, sizeof(log_path), HISTORY_LOG);
+   history_path(merging_path, sizeof(merging_path), HISTORY_MERGING);
+   if (rename(log_path, merging_path) != 0)
+   {
+      report("merge");
+      return;
+   }
+   close(hist.log_fd);
+   if (open_log() != 0)
+      report("open log");
+   hist.merging = hist.tail;
+   memset(&hist.tail, 0, sizeof(hist.tail));
+   __atomic_store_n(&hist.merger_running, 1, __ATOMIC_RELEASE);
+   if (pthread_create(&hist.merger, NULL, merger_main, NULL) != 0)
+   {
+      __atomic_store_n(&hist.merger_running, 0, __ATOMIC_RELEASE);
+      abandon_merge();
+      return;
+   }
+   hist.merger_started = 1;
+}
+
+void history_close(void)
+{
+   if (hist.merger_started)
+      finish_merge();
+   if (hist.log_fd >= 0)
+      close(hist.log_fd);
+   if (hist.index_fd >= 0)
+      close(hist.index_fd);
+   hist.log_fd = hist.index_fd = -1;
+   free(hist.sparse);
+   free(hist.tail.items);
+   free(hist.merging.items);
+   memset(&hist.tail, 0, sizeof(hist.tail));
+   memset(&hist.merging, 0, sizeof(hist.merging));
+   hist.sparse = NULL;
+   hist.enabled = 0;
+}
+
+int history_enabled(void)
+{
+   return hist.enabled;
+}
+
+void history_add_game(int match_id, int variant, const char players[2][MAX_USERNAME_LEN], const int score[2], int64_t ended_at)
+{
+   if (!hist.enabled)
+      return;
+   poll_merge();
+   HistoryRecord r[2];
+   memset(r, 0, sizeof(r));
+   for (int seat = 0; seat < 2; seat++)
+   {
+      r[seat].player = history_player_key(players[seat]);
+      r[seat].ended_at = ended_at;
+      r[seat].seq = hist.next_seq++;
+      r[seat].match_id = match_id;
+      r[seat].variant = (uint8_t)variant;
+      r[seat].seat = (uint8_t)seat;
+      r[seat].score[0] = (int16_t)score[seat];
+      r[seat].score[1] = (int16_t)score[1 - seat];
+      snprintf(r[seat].name, sizeof(r[seat].name), "%s", players[seat]);
+      snprintf(r[seat].opponent, sizeof(r[seat].opponent), "%s", players[1 - seat]);
+   }
+   if (write_all(hist.log_fd, r, sizeof(r)) != 0)
+      report("write");
+   if (list_insert(&hist.tail, &r[0]) != 0 || list_insert(&hist.tail, &r[1]) != 0)
+      report("memory");
+   if (hist.tail.count >= HISTORY_MERGE_RECORDS)
+      start_merge();
+}
+
+/* ---- queries ---- */
+
+/* Walks one sorted source backward from the last record <= a key */
+typedef struct
+{
+   const HistoryRecord *items; // in-memory source, NULL for the file
+   int64_t pos;                // current record, -1 once past the start
+   HistoryRecord block[HISTORY_SPARSE_EVERY]; // file records [block_start, block_start + block_len)
+   int64_t block_start;
+   int block_len;
+} Cursor;
+
+static int load_block(Cursor *c, int64_t pos)
+{
+   int64_t start = pos - pos % HISTORY_SPARSE_EVERY;
+   uint64_t left = hist.index_count - (uint64_t)start;
+   int len = left < HISTORY_SPARSE_EVERY ? (int)left : HISTORY_SPARSE_EVERY;
+   off_t at = (off_t)(sizeof(HistoryHeader) + (uint64_t)start * sizeof(HistoryRecord));
+   if (pread(hist.index_fd, c->block, (size_t)len * sizeof(HistoryRecord), at) != (ssize_t)(len * sizeof(HistoryRecord)))
+      return -1;
+   c->block_start = start;
+   c->block_len = len;
+   return 0;
+}
+
+static void cursor_memory(Cursor *c, const RecordList *list, const HistoryKey *key)
+{
+   c->items = list->items;
+   c->pos = (int64_t)upper_bound(list->items, list->count, key) - 1;
+}
+
+static void cursor_file(Cursor *c, const HistoryKey *key)
+{
+   c->items = NULL;
+   c->pos = -1;
+   c->block_len = 0;
+   if (hist.index_fd < 0 || hist.sparse_count == 0 || compare_keys(&hist.sparse[0], key) > 0)
+      return;
+   // last block starting at or below the key
+   size_t lo = 0, hi = hist.sparse_count - 1;
+   while (lo < hi)
+   {
+      size_t mid = lo + (hi - lo + 1) / 2;
+      if (compare_keys(&hist.sparse[mid], key) <= 0)
+         lo = mid;
+      else
+         hi = mid - 1;
+   }
+   if (load_block(c, (int64_t)lo * HISTORY_SPARSE_EVERY) != 0)
+      return;
+   c->pos = c->block_start + (int64_t)upper_bound(c->block, (size_t)c->block_len, key) - 1;
+}
+
+static const HistoryRecord *cursor_peek(Cursor *c)
+{
+   if (c->pos < 0)
+      return NULL;
+   if (c->items)
+      return &c->items[c->pos];
+   if ((c->pos < c->block_start || c->pos >= c->block_start + c->block_len) && load_block(c, c->pos) != 0)
+   {
+      c->pos = -1;
+      return NULL;
+   }
+   return &c->block[c->pos - c->block_start];
+}
+
+int history_query(const char *name, int64_t since, int64_t until, HistoryRecord *out, int max)
+{
+   if (!hist.enabled)
+      return 0;
+   poll_merge();
+   uint64_t player = history_player_key(name);
+   HistoryKey key = {player, until, UINT64_MAX};
+   Cursor c[3];
+   cursor_memory(&c[0], &hist.tail, &key);
+   cursor_memory(&c[1], &hist.merging, &key);
+   cursor_file(&c[2], &key);
+   int n = 0;
+   while (n < max)
+   {
+      // the newest of the three sources' current records
+      const HistoryRecord *best = NULL;
+      int from = -1;
+      for (int s = 0; s < 3; s++)
+      {
+         const HistoryRecord *r = cursor_peek(&c[s]);
+         if (!r || r->player != player || r->ended_at < since)
+            continue;
+         if (!best || compare_records(r, best) > 0)
+         {
+            best = r;
+            from = s;
+         }
+      }
+      if (!best)
+         break;
+      if (strcmp(best->name, name) == 0) // not another name with the same hash
+         out[n++] = *best;
+      c[from].pos--;
+   }
+   return n;
+}
@@ -0,0 +1,60 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../utils/constants.h"
+
+/*
+ * MATCH HISTORY
+ * =============
+ * An index of finished games by player and end time, for the history
+ * command. Every finished game adds one record per player, keyed by
+ * (player, ended_at). Players have no numeric id, so the key is a 64-bit
+ * hash of the name; records also keep the name itself, and a query skips
+ * the records of another name with the same hash.
+ *
+ * Records are appended to history.log in the data directory as games end,
+ * and kept in memory in key order (the tail). Once HISTORY_MERGE_RECORDS
+ * have gathered, a background thread merges them into history.idx, a file
+ * of records sorted by key, written next to the old one and swapped in with
+ * a rename. The log is set aside (history.merging) while the merge runs.
+ * history.idx records its highest sequence number, so records it already
+ * holds are not loaded from a log again after a crash.
+ *
+ * The sorted file is read with pread through an in-memory sparse index
+ * (the key of every HISTORY_SPARSE_EVERY-th record). A lookup is a binary
+ * search of that index plus one block read, and then the k results are
+ * read backward from there: O(log n + k). The in-memory records are
+ * searched the same way, and the sources are merged newest first.
+ */
+
+typedef struct
+{
+   uint64_t player;  // history_player_key() of the player's name
+   int64_t ended_at; // seconds since the epoch
+   uint64_t seq;     // order of recording, unique
+   int32_t match_id;
+   uint8_t variant;
+   uint8_t seat;     // 0: the player was Player 1
+   int16_t score[2]; // the player's, the opponent's
+   char name[MAX_USERNAME_LEN]; // the player's
+   char opponent[MAX_USERNAME_LEN];
+} HistoryRecord;
+
+/* Open (or create) the index in `dir`. Returns 0, or -1 with errno set. */
+int history_open(const char *dir);
+/* Wait for a running merge and close the files */
+void history_close(void);
+int history_enabled(void);
+
+uint64_t history_player_key(const char *name);
+
+/* Record a finished game: one record for each player */
+void history_add_game(int match_id, int variant, const char players[2][MAX_USERNAME_LEN], const int score[2], int64_t ended_at);
+
+/* Up to `max` games of `name` that ended in [since, until], newest first.
+ * Returns how many were written to `out`. */
+int history_query(const char *name, int64_t since, int64_t until, HistoryRecord *out, int max);
+
+#endif
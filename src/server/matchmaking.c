@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <string.h>
+#include "matchmaking.h"
+#include "../utils/constants.h"
+
+void matchmaker_init(Matchmaker *mm)
+{
+   memset(mm, 0, sizeof(*mm));
+}
+
+void matchmaker_free(Matchmaker *mm)
+{
+   free(mm->order);
+   free(mm->prev);
+   free(mm->next);
+   free(mm->by_wait);
+   free(mm->bucket_count);
+   memset(mm, 0, sizeof(*mm));
+}
+
+int matchmaker_band(long long wait_ms)
+{
+   long long band = MATCHMAKING_INITIAL_BAND + wait_ms * MATCHMAKING_BAND_GROWTH_PER_SEC / 1000;
+   return band > MATCHMAKING_MAX_BAND ? MATCHMAKING_MAX_BAND : (int)band;
+}
+
+long long matchmaker_average_wait(const Matchmaker *mm)
+{
+   if (mm->pairs_made == 0)
+      return 0;
+   return mm->total_wait_ms / (mm->pairs_made * 2);
+}
+
+static int reserve(Matchmaker *mm, int n, int buckets)
+{
+   if (n > mm->capacity)
+   {
+      int *order = realloc(mm->order, (size_t)n * sizeof(int));
+      if (order)
+         mm->order = order;
+      int *prev = realloc(mm->prev, (size_t)n * sizeof(int));
+      if (prev)
+         mm->prev = prev;
+      int *next = realloc(mm->next, (size_t)n * sizeof(int));
+      if (next)
+         mm->next = next;
+      int *by_wait = realloc(mm->by_wait, (size_t)n * sizeof(int));
+      if (by_wait)
+         mm->by_wait = by_wait;
+      if (!order || !prev || !next || !by_wait)
+         return 0;
+      mm->capacity = n;
+   }
+   // per bucket: next free slot, followed by the bucket's first slot
+   if (2 * (buckets + 1) > mm->bucket_capacity)
+   {
+      int *counts = realloc(mm->bucket_count, (size_t)(2 * (buckets + 1)) * sizeof(int));
+      if (!counts)
+         return 0;
+      mm->bucket_count = counts;
+      mm->bucket_capacity = 2 * (buckets + 1);
+   }
+   return 1;
+}
+
+static const QueueEntry *sort_entries;
+
+static int compare_wait(const void *a, const void *b)
+{
+   long long ta = sort_entries[*(const int *)a].queued_at;
+   long long tb = sort_entries[*(const int *)b].queued_at;
+   return (ta > tb) - (ta < tb);
+}
+
+int matchmaker_pair(Matchmaker *mm, const QueueEntry *entries, int n, long long now, QueuePair *pairs)
+{
+   if (n < 2)
+      return 0;
+
+   int min_rating = entries[0].rating;
+   int max_rating = entries[0].rating;
+   for (int i = 1; i < n; i++)
+   {
+      if (entries[i].rating < min_rating)
+         min_rating = entries[i].rating;
+      if (entries[i].rating > max_rating)
+         max_rating = entries[i].rating;
+   }
+   int buckets = (max_rating - min_rating) / MATCHMAKING_BUCKET_WIDTH + 1;
+   if (!reserve(mm, n, buckets))
+      return 0;
+
+   /* Bucket sort by rating (counting sort on the bucket, insertion sort inside) */
+   int *count = mm->bucket_count;
+   memset(count, 0, (size_t)(buckets + 1) * sizeof(int));
+   for (int i = 0; i < n; i++)
+      count[(entries[i].rating - min_rating) / MATCHMAKING_BUCKET_WIDTH + 1]++;
+   for (int b = 0; b < buckets; b++)
+      count[b + 1] += count[b];
+   int *first = count + buckets + 1;
+   memcpy(first, count, (size_t)(buckets + 1) * sizeof(int));
+   for (int i = 0; i < n; i++)
+   {
+      int b = (entries[i].rating - min_rating) / MATCHMAKING_BUCKET_WIDTH;
+      int pos = count[b]++;
+      // keep the bucket sorted: shift larger ratings of the same bucket right
+      int start = first[b];
+      while (pos > start && entries[mm->order[pos - 1]].rating > entries[i].rating)
+      {
+         mm->order[pos] = mm->order[pos - 1];
+         pos--;
+      }
+      mm->order[pos] = i;
+   }
+
+   /* Doubly linked list of unpaired entries in rating order */
+   for (int k = 0; k < n; k++)
+   {
+      int e = mm->order[k];
+      mm->prev[e] = (k > 0) ? mm->order[k - 1] : -1;
+      mm->next[e] = (k < n - 1) ? mm->order[k + 1] : -1;
+      mm->by_wait[k] = e;
+   }
+
+   /* Longest waiting players choose first */
+   sort_entries = entries;
+   qsort(mm->by_wait, (size_t)n, sizeof(int), compare_wait);
+
+   int pair_count = 0;
+   for (int k = 0; k < n; k++)
+   {
+      int p = mm->by_wait[k];
+      if (mm->prev[p] == -2) // already paired
+         continue;
+      int band_p = matchmaker_band(now - entries[p].queued_at);
+      int best = -1;
+      int best_gap = 0;
+      int candidates[2] = {mm->prev[p], mm->next[p]};
+      for (int c = 0; c < 2; c++)
+      {
+         int q = candidates[c];
+         if (q < 0)
+            continue;
+         int gap = abs(entries[p].rating - entries[q].rating);
+         int band_q = matchmaker_band(now - entries[q].queued_at);
+         int band = band_p > band_q ? band_p : band_q;
+         if (gap <= band && (best == -1 || gap < best_gap))
+         {
+            best = q;
+            best_gap = gap;
+         }
+      }
+      if (best == -1)
+         continue;
+
+      /* Unlink both players (O(1) each) */
+      int unlink[2] = {p, best};
+      for (int u = 0; u < 2; u++)
+      {
+         int e = unlink[u];
+         if (mm->prev[e] >= 0)
+            mm->next[mm->prev[e]] = mm->next[e];
+         if (mm->next[e] >= 0)
+            mm->prev[mm->next[e]] = mm->prev[e];
+         mm->prev[e] = -2;
+         mm->next[e] = -2;
+      }
+
+      pairs[pair_count].a = entries[p].id;
+      pairs[pair_count].b = entries[best].id;
+      pair_count++;
+   }
+   return pair_count;
+}
+
+void matchmaker_record_wait(Matchmaker *mm, long long wait_a, long long wait_b)
+{
+   mm->pairs_made++;
+   mm->total_wait_ms += wait_a + wait_b;
+   if (wait_a > mm->max_wait_ms)
+      mm->max_wait_ms = wait_a;
+   if (wait_b > mm->max_wait_ms)
+      mm->max_wait_ms = wait_b;
+}
@@ -0,0 +1,57 @@
+#ifndef MATCHMAKING_H
+#define MATCHMAKING_H
+
+/*
+ * MATCHMAKING
+ * ===========
+ * Players waiting in the queue are paired in periodic batches. Each batch
+ * bucket-sorts the queue by rating, links the entries in rating order and
+ * then, starting with the player who waited longest, pairs every player
+ * with its closest still-unpaired neighbour if the rating gap fits in the
+ * acceptance band. The band starts narrow and widens with waiting time, so
+ * outliers are eventually matched too. A batch costs O(n) plus the
+ * in-bucket sorts, independent of how wide the bands have become.
+ */
+
+typedef struct
+{
+   int id;              // caller-defined identifier (e.g. client index)
+   int rating;
+   long long queued_at; // monotonic ms when the player joined the queue
+} QueueEntry;
+
+typedef struct
+{
+   int a; // ids of the paired entries
+   int b;
+} QueuePair;
+
+typedef struct
+{
+   // time-to-game statistics
+   long long pairs_made;
+   long long total_wait_ms; // summed over both players of every pair
+   long long max_wait_ms;
+   // scratch space reused between batches
+   int capacity;
+   int *order;
+   int *prev;
+   int *next;
+   int *by_wait;
+   int *bucket_count;
+   int bucket_capacity;
+} Matchmaker;
+
+void matchmaker_init(Matchmaker *mm);
+void matchmaker_free(Matchmaker *mm);
+/* Band (max accepted rating gap) for a player who has waited wait_ms */
+int matchmaker_band(long long wait_ms);
+/* Pair queued entries; returns the number of pairs written (at most n / 2) */
+int matchmaker_pair(Matchmaker *mm, const QueueEntry *entries, int n, long long now, QueuePair *pairs);
+/* Count a pair whose match did start (a pair left without a match slot is
+ * paired again by a later batch) */
+void matchmaker_record_wait(Matchmaker *mm, long long wait_a, long long wait_b);
+/* Average time-to-game in ms over all players matched so far */
+long long matchmaker_average_wait(const Matchmaker *mm);
+
+#endif
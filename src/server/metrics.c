@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include "metrics.h"
+#include "../utils/constants.h"
+
+static uint64_t counters[METRIC_COUNT];
+static uint64_t logged[METRIC_COUNT]; // values at the last metrics_log()
+
+static const char *const names[METRIC_COUNT] = {
+    [METRIC_COMMANDS] = "commands",
+    [METRIC_COMMANDS_REFUSED] = "refused",
+    [METRIC_READS_PAUSED] = "paused",
+    [METRIC_FLOOD_DISCONNECTS] = "flood-kicks",
+};
+
+void metrics_add(Metric metric, uint64_t n)
+{
+   counters[metric] += n;
+}
+
+uint64_t metrics_get(Metric metric)
+{
+   return counters[metric];
+}
+
+void metrics_log(void)
+{
+   int changed = 0;
+   for (int m = 0; m < METRIC_COUNT; m++)
+      changed |= counters[m] != logged[m];
+   if (!changed)
+      return;
+   printf("%s[metrics]%s", COLOR_BLUE COLOR_BOLD, COLOR_RESET);
+   for (int m = 0; m < METRIC_COUNT; m++)
+   {
+      printf(" %s %llu (+%llu)", names[m], (unsigned long long)counters[m], (unsigned long long)(counters[m] - logged[m]));
+      logged[m] = counters[m];
+   }
+   printf("\n");
+}
@@ -0,0 +1,27 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+/*
+ * SERVER METRICS
+ * ==============
+ * Process-wide event counters, bumped from the event loop and logged every
+ * METRICS_LOG_INTERVAL_MS when they moved.
+ */
+
+typedef enum
+{
+   METRIC_COMMANDS,          // commands run
+   METRIC_COMMANDS_REFUSED,  // refused by a command class rate limit
+   METRIC_READS_PAUSED,      // connections paused by their rate limit
+   METRIC_FLOOD_DISCONNECTS, // clients dropped for flooding
+   METRIC_COUNT
+} Metric;
+
+void metrics_add(Metric metric, uint64_t n);
+uint64_t metrics_get(Metric metric);
+/* Print the counters if any changed since the last call */
+void metrics_log(void);
+
+#endif
@@ -0,0 +1,390 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "persist.h"
+
+#define JOURNAL_FILE "moves.journal"
+#define SNAPSHOT_FILE "matches.snap"
+#define QUEUE_INITIAL_RECORDS 256
+
+/* Work handed from the event loop to the writer. Slots queued by a snapshot
+ * reflect every journal record before `mark`, so those records can be
+ * dropped from the journal once the slots are synced. */
+typedef struct
+{
+   JournalRecord *records;
+   int record_count;
+   int record_capacity;
+   MatchRecord *slots;
+   int slot_count;
+   int slot_capacity;
+   int mark; // records[0..mark) are covered by the queued slots
+} PersistQueue;
+
+static struct
+{
+   int enabled;
+   int journal_fd;
+   int snapshot_fd;
+   pthread_t writer;
+   pthread_mutex_t lock;
+   pthread_cond_t wake;
+   int stopping;
+   PersistQueue queued;  // filled by the event loop
+   PersistQueue writing; // drained by the writer
+   uint32_t sequence[MAX_MATCHES]; // last sequence written to each slot
+} persist;
+
+/* FNV-1a over everything after the checksum field */
+static uint32_t checksum(const void *data, size_t size)
+{
+   const unsigned char *p = (const unsigned char *)data + sizeof(uint32_t);
+   uint32_t h = 2166136261u;
+   for (size_t i = sizeof(uint32_t); i < size; i++, p++)
+   {
+      h ^= *p;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+static void data_path(char *out, size_t size, const char *dir, const char *file)
+{
+   snprintf(out, size, "%s/%s", dir, file);
+}
+
+static void report(const char *what)
+{
+   fprintf(stderr, "%s[persist]%s %s: %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, what, strerror(errno));
+}
+
+// Grow a queue array to hold `needed` items; returns the (possibly moved)
+// array, or NULL if it could not grow (the old one is still valid then)
+static void *reserve(void *items, int *capacity, int needed, size_t item_size)
+{
+   if (needed <= *capacity)
+      return items;
+   int capacity_next = *capacity ? *capacity * 2 : QUEUE_INITIAL_RECORDS;
+   while (capacity_next < needed)
+      capacity_next *= 2;
+   void *grown = realloc(items, (size_t)capacity_next * item_size);
+   if (grown)
+      *capacity = capacity_next;
+   return grown;
+}
+
+/* ---- recovery ---- */
+
+static void apply_journal_record(const JournalRecord *j, MatchRecord *records, int max_records, int *used)
+{
+   if (j->slot < 0 || j->slot >= max_records)
+      return;
+   MatchRecord *r = &records[j->slot];
+   switch (j->type)
+   {
+   case JOURNAL_START:
+      if (j->variant < 0 || j->variant >= VARIANT_COUNT)
+         return; // not a rule set of this build
+      // a start in the journal is always newer than any snapshot of the slot
+      memset(r, 0, sizeof(*r));
+      r->match_id = j->match_id;
+      r->slot = j->slot;
+      r->is_active = 1;
+      r->first_player = j->first_player;
+      r->clock_ms[0] = j->clock_ms[0];
+      r->clock_ms[1] = j->clock_ms[1];
+      r->increment_ms = j->increment_ms;
+      init_board_variant(&r->board, j->variant);
+      r->board.current_player = j->first_player;
+      memcpy(r->players, j->players, sizeof(r->players));
+      if (j->slot + 1 > *used)
+         *used = j->slot + 1;
+      break;
+   case JOURNAL_MOVE:
+      // moves already in the snapshot are skipped
+      if (r->match_id != j->match_id || !r->is_active || j->ply != r->ply + 1)
+         return;
+      if (!is_valid_move(&r->board, j->pit))
+         return;
+      apply_move(&r->board, j->pit);
+      if (r->ply < MAX_MOVES)
+         r->moves[r->ply] = (uint8_t)j->pit;
+      r->ply++;
+      r->clock_ms[0] = j->clock_ms[0];
+      r->clock_ms[1] = j->clock_ms[1];
+      break;
+   case JOURNAL_END:
+      if (r->match_id == j->match_id)
+         r->is_active = 0;
+      break;
+   case JOURNAL_PRIVATE:
+      if (r->match_id == j->match_id)
+         r->private_mode = j->pit;
+      break;
+   }
+}
+
+int persist_load(const char *dir, MatchRecord *records, int max_records)
+{
+   char path[1024];
+   int used = 0;
+   for (int i = 0; i < max_records; i++)
+      records[i].match_id = -1;
+   memset(persist.sequence, 0, sizeof(persist.sequence));
+
+   data_path(path, sizeof(path), dir, SNAPSHOT_FILE);
+   int fd = open(path, O_RDONLY);
+   if (fd >= 0)
+   {
+      MatchRecord copy[2];
+      for (int slot = 0; slot < max_records && slot < MAX_MATCHES; slot++)
+      {
+         if (read(fd, copy, sizeof(copy)) != (ssize_t)sizeof(copy))
+            break;
+         int best = -1;
+         for (int c = 0; c < 2; c++)
+         {
+            if (copy[c].slot != slot || copy[c].checksum != checksum(&copy[c], sizeof(copy[c])))
+               continue;
+            if (copy[c].board.variant < 0 || copy[c].board.variant >= VARIANT_COUNT)
+               continue; // not a rule set of this build
+            if (best < 0 || copy[c].sequence > copy[best].sequence)
+               best = c;
+         }
+         if (best < 0)
+            continue;
+         records[slot] = copy[best];
+         persist.sequence[slot] = copy[best].sequence;
+         used = slot + 1;
+      }
+      close(fd);
+   }
+
+   data_path(path, sizeof(path), dir, JOURNAL_FILE);
+   fd = open(path, O_RDONLY);
+   if (fd >= 0)
+   {
+      JournalRecord j;
+      // the first torn or corrupt record ends the journal
+      while (read(fd, &j, sizeof(j)) == (ssize_t)sizeof(j) && j.checksum == checksum(&j, sizeof(j)))
+         apply_journal_record(&j, records, max_records, &used);
+      close(fd);
+   }
+   return used;
+}
+
+/* ---- writer thread ---- */
+
+static int write_all(int fd, const void *data, size_t size)
+{
+   const char *p = data;
+   while (size > 0)
+   {
+      ssize_t n = write(fd, p, size);
+      if (n < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         return -1;
+      }
+      p += n;
+      size -= (size_t)n;
+   }
+   return 0;
+}
+
+static void append_records(JournalRecord *records, int count)
+{
+   if (count <= 0)
+      return;
+   for (int i = 0; i < count; i++)
+      records[i].checksum = checksum(&records[i], sizeof(records[i]));
+   if (write_all(persist.journal_fd, records, (size_t)count * sizeof(JournalRecord)) != 0)
+      report("journal write");
+   else if (fdatasync(persist.journal_fd) != 0)
+      report("journal sync");
+}
+
+static void write_slots(MatchRecord *slots, int count)
+{
+   for (int i = 0; i < count; i++)
+   {
+      MatchRecord *s = &slots[i];
+      if (s->slot < 0 || s->slot >= MAX_MATCHES)
+         continue;
+      // alternate between the two copies so the previous one stays intact
+      s->sequence = ++persist.sequence[s->slot];
+      s->checksum = checksum(s, sizeof(*s));
+      off_t offset = (off_t)((size_t)s->slot * 2 + (s->sequence & 1)) * (off_t)sizeof(MatchRecord);
+      if (pwrite(persist.snapshot_fd, s, sizeof(*s), offset) != (ssize_t)sizeof(*s))
+      {
+         report("snapshot write");
+         return;
+      }
+   }
+   if (fdatasync(persist.snapshot_fd) != 0)
+   {
+      report("snapshot sync");
+      return;
+   }
+   // the journal so far is covered by the snapshot
+   if (ftruncate(persist.journal_fd, 0) != 0)
+      report("journal truncate");
+}
+
+static void write_batch(PersistQueue *q)
+{
+   if (q->slot_count > 0)
+   {
+      append_records(q->records, q->mark);
+      write_slots(q->slots, q->slot_count);
+      append_records(q->records + q->mark, q->record_count - q->mark);
+   }
+   else
+      append_records(q->records, q->record_count);
+   q->record_count = 0;
+   q->slot_count = 0;
+   q->mark = 0;
+}
+
+static int queue_empty(const PersistQueue *q)
+{
+   return q->record_count == 0 && q->slot_count == 0;
+}
+
+static void *writer_main(void *arg)
+{
+   (void)arg;
+   pthread_mutex_lock(&persist.lock);
+   for (;;)
+   {
+      while (!persist.stopping && queue_empty(&persist.queued))
+         pthread_cond_wait(&persist.wake, &persist.lock);
+      if (!persist.stopping)
+      {
+         // let more records arrive so that one sync commits them all
+         struct timespec until;
+         clock_gettime(CLOCK_REALTIME, &until);
+         until.tv_nsec += (long)PERSIST_FLUSH_MS * 1000000L;
+         until.tv_sec += until.tv_nsec / 1000000000L;
+         until.tv_nsec %= 1000000000L;
+         while (!persist.stopping && pthread_cond_timedwait(&persist.wake, &persist.lock, &until) == 0)
+            ;
+      }
+      PersistQueue batch = persist.queued;
+      persist.queued = persist.writing; // empty, keeps its buffers
+      persist.writing = batch;
+      int stopping = persist.stopping;
+      pthread_mutex_unlock(&persist.lock);
+
+      write_batch(&persist.writing);
+
+      pthread_mutex_lock(&persist.lock);
+      if (stopping && queue_empty(&persist.queued))
+         break;
+   }
+   pthread_mutex_unlock(&persist.lock);
+   return NULL;
+}
+
+/* ---- event loop side ---- */
+
+int persist_open(const char *dir)
+{
+   char path[1024];
+   if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+      return -1;
+   data_path(path, sizeof(path), dir, JOURNAL_FILE);
+   persist.journal_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+   if (persist.journal_fd < 0)
+      return -1;
+   data_path(path, sizeof(path), dir, SNAPSHOT_FILE);
+   persist.snapshot_fd = open(path, O_WRONLY | O_CREAT, 0644);
+   if (persist.snapshot_fd < 0)
+   {
+      close(persist.journal_fd);
+      return -1;
+   }
+   memset(&persist.queued, 0, sizeof(persist.queued));
+   memset(&persist.writing, 0, sizeof(persist.writing));
+   persist.stopping = 0;
+   pthread_mutex_init(&persist.lock, NULL);
+   pthread_cond_init(&persist.wake, NULL);
+   int err = pthread_create(&persist.writer, NULL, writer_main, NULL);
+   if (err != 0)
+   {
+      close(persist.journal_fd);
+      close(persist.snapshot_fd);
+      errno = err;
+      return -1;
+   }
+   persist.enabled = 1;
+   return 0;
+}
+
+void persist_close(void)
+{
+   if (!persist.enabled)
+      return;
+   pthread_mutex_lock(&persist.lock);
+   persist.stopping = 1;
+   pthread_cond_signal(&persist.wake);
+   pthread_mutex_unlock(&persist.lock);
+   pthread_join(persist.writer, NULL);
+   close(persist.journal_fd);
+   close(persist.snapshot_fd);
+   free(persist.queued.records);
+   free(persist.queued.slots);
+   free(persist.writing.records);
+   free(persist.writing.slots);
+   persist.enabled = 0;
+}
+
+int persist_enabled(void)
+{
+   return persist.enabled;
+}
+
+void persist_journal(const JournalRecord *record)
+{
+   if (!persist.enabled)
+      return;
+   PersistQueue *q = &persist.queued;
+   pthread_mutex_lock(&persist.lock);
+   int was_empty = queue_empty(q);
+   JournalRecord *records = reserve(q->records, &q->record_capacity, q->record_count + 1, sizeof(JournalRecord));
+   if (records)
+   {
+      q->records = records;
+      q->records[q->record_count++] = *record;
+   }
+   if (was_empty)
+      pthread_cond_signal(&persist.wake);
+   pthread_mutex_unlock(&persist.lock);
+}
+
+void persist_snapshot(const MatchRecord *records, int count)
+{
+   if (!persist.enabled || count <= 0)
+      return;
+   PersistQueue *q = &persist.queued;
+   pthread_mutex_lock(&persist.lock);
+   int was_empty = queue_empty(q);
+   MatchRecord *slots = reserve(q->slots, &q->slot_capacity, q->slot_count + count, sizeof(MatchRecord));
+   if (slots)
+   {
+      q->slots = slots;
+      memcpy(q->slots + q->slot_count, records, (size_t)count * sizeof(MatchRecord));
+      q->slot_count += count;
+      q->mark = q->record_count;
+   }
+   if (was_empty)
+      pthread_cond_signal(&persist.wake);
+   pthread_mutex_unlock(&persist.lock);
+}
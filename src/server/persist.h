@@ -0,0 +1,88 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <stdint.h>
+#include "../core/awale.h"
+#include "../utils/constants.h"
+
+/*
+ * MATCH PERSISTENCE
+ * =================
+ * Running matches survive a server crash or restart. Two files live in the
+ * data directory:
+ *   moves.journal  append-only log of fixed-size records (match started,
+ *                  move played, privacy changed, match ended), each with a
+ *                  checksum
+ *   matches.snap   two MatchRecord copies per match table slot, written alternately
+ *                  (a torn write only loses the newer copy) and only for
+ *                  the matches that changed since the last snapshot
+ * The event loop never touches the disk: persist_journal() and
+ * persist_snapshot() copy their data into a queue under a mutex and return.
+ * A writer thread drains the queue every PERSIST_FLUSH_MS with one write()
+ * and one fdatasync() per batch (group commit). Once a snapshot is on disk
+ * every journal record before it is redundant, so the journal is truncated.
+ *
+ * On restart persist_load() reads the snapshot, replays the journal on top
+ * of it (a torn or corrupt tail record ends the replay) and returns the
+ * recovered matches; their players reattach with the resume command.
+ */
+
+/* Durable state of one match: a snapshot slot and the result of recovery */
+typedef struct
+{
+   uint32_t checksum;
+   uint32_t sequence; // newer copy of the slot wins (set by the writer)
+   int32_t match_id;  // -1: unused slot
+   int32_t slot;      // index in the server's match table
+   int32_t is_active;
+   int32_t private_mode;
+   int32_t first_player; // side that moved first (replays start from it)
+   int32_t ply;
+   int64_t clock_ms[2];
+   int64_t increment_ms; // < 0: untimed
+   Board board;
+   char players[2][MAX_USERNAME_LEN];
+   uint8_t moves[MAX_MOVES];
+} MatchRecord;
+
+typedef enum
+{
+   JOURNAL_START = 1, // players, variant, first player and clocks
+   JOURNAL_MOVE,      // pit played, ply after it and both clocks
+   JOURNAL_END,
+   JOURNAL_PRIVATE // private mode switched (pit: new mode)
+} JournalType;
+
+typedef struct
+{
+   uint32_t checksum;
+   int32_t type; // JournalType
+   int32_t match_id;
+   int32_t slot; // of the match in the server's match table
+   int32_t ply;
+   int32_t pit;
+   int32_t variant;
+   int32_t first_player;
+   int64_t clock_ms[2];
+   int64_t increment_ms;
+   char players[2][MAX_USERNAME_LEN];
+} JournalRecord;
+
+/* Recover the matches saved in `dir` into records[0..max_records-1]
+ * (indexed by slot, unused slots have match_id -1). Returns the number of
+ * slots in use (highest slot + 1), 0 if there is nothing to recover. */
+int persist_load(const char *dir, MatchRecord *records, int max_records);
+
+/* Open (creating if needed) the data files and start the writer thread.
+ * Returns 0 on success, -1 with errno set otherwise. */
+int persist_open(const char *dir);
+/* Flush everything queued, then stop the writer thread */
+void persist_close(void);
+int persist_enabled(void);
+
+/* Queue a journal record (copied; the writer fills in the checksum) */
+void persist_journal(const JournalRecord *record);
+/* Queue snapshot slots (copied; the writer fills in sequence and checksum) */
+void persist_snapshot(const MatchRecord *records, int count);
+
+#endif
@@ -0,0 +1,95 @@
+#include <string.h>
+#include "rate_limit.h"
+#include "../protocol/protocol.h"
+#include "../utils/constants.h"
+
+typedef struct
+{
+   int burst;
+   int per_sec;
+} RateRule;
+
+static const RateRule connection_rule = {RATE_CONNECTION_BURST, RATE_CONNECTION_PER_SEC};
+static const RateRule class_rules[RATE_CLASS_COUNT] = {
+    [RATE_CLASS_NONE] = {0, 0},
+    [RATE_CLASS_CHAT] = {RATE_CHAT_BURST, RATE_CHAT_PER_SEC},
+    [RATE_CLASS_WATCH] = {RATE_WATCH_BURST, RATE_WATCH_PER_SEC},
+};
+
+static void bucket_fill(TokenBucket *b, const RateRule *rule, long long now_ms)
+{
+   b->level = (long long)rule->burst * 1000;
+   b->updated_ms = now_ms;
+}
+
+static void bucket_refill(TokenBucket *b, const RateRule *rule, long long now_ms)
+{
+   long long max = (long long)rule->burst * 1000;
+   if (now_ms > b->updated_ms)
+   {
+      b->level += (now_ms - b->updated_ms) * rule->per_sec; // per_sec tokens = per_sec thousandths per ms
+      if (b->level > max)
+         b->level = max;
+      b->updated_ms = now_ms;
+   }
+}
+
+void rate_limits_init(RateLimits *r, long long now_ms)
+{
+   bucket_fill(&r->connection, &connection_rule, now_ms);
+   for (int c = 0; c < RATE_CLASS_COUNT; c++)
+      bucket_fill(&r->classes[c], &class_rules[c], now_ms);
+   r->strikes = 0;
+}
+
+int rate_admit_connection(RateLimits *r, long long now_ms, long long *wait_ms)
+{
+   bucket_refill(&r->connection, &connection_rule, now_ms);
+   if (r->connection.level >= 1000)
+   {
+      r->connection.level -= 1000;
+      return 1;
+   }
+   // round up: the token must be whole when the reads resume
+   *wait_ms = (1000 - r->connection.level + connection_rule.per_sec - 1) / connection_rule.per_sec;
+   return 0;
+}
+
+RateClass rate_class_of(const char *command)
+{
+   static const struct
+   {
+      const char *command;
+      RateClass rate_class;
+   } table[] = {
+       {CMD_MSG, RATE_CLASS_CHAT},
+       {CMD_PM, RATE_CLASS_CHAT},
+       {CMD_WATCH, RATE_CLASS_WATCH},
+       {CMD_UNWATCH, RATE_CLASS_WATCH},
+       {CMD_ANALYZE, RATE_CLASS_WATCH},
+       {CMD_WATCH_REPLAY, RATE_CLASS_WATCH},
+       {CMD_HISTORY, RATE_CLASS_WATCH},
+   };
+   for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+   {
+      if (strcmp(command, table[i].command) == 0)
+         return table[i].rate_class;
+   }
+   return RATE_CLASS_NONE;
+}
+
+int rate_admit_command(RateLimits *r, RateClass rate_class, long long now_ms)
+{
+   if (rate_class == RATE_CLASS_NONE)
+      return 1;
+   TokenBucket *b = &r->classes[rate_class];
+   bucket_refill(b, &class_rules[rate_class], now_ms);
+   if (b->level < 1000)
+   {
+      r->strikes++;
+      return 0;
+   }
+   b->level -= 1000;
+   r->strikes = 0;
+   return 1;
+}
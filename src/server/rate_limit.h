@@ -0,0 +1,53 @@
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+/*
+ * RATE LIMITING
+ * =============
+ * Every connection owns token buckets: one for all its commands and one per
+ * class of costly commands (chat fans out to every client, watching and
+ * analysis touch matches and the engine). A bucket holds at most `burst`
+ * tokens and regains `per_sec` tokens a second; a command takes one.
+ *
+ * The connection bucket paces a client instead of refusing it: when it is
+ * empty the server stops reading that socket until a token is back, so a
+ * flood backs up in the client's own TCP buffers. A class bucket refuses
+ * the command; a client that keeps sending refused commands is dropped.
+ */
+
+typedef enum
+{
+   RATE_CLASS_NONE,  // only the connection bucket
+   RATE_CLASS_CHAT,  // msg, pm (and plain text, which is sent as chat)
+   RATE_CLASS_WATCH, // watch, unwatch, analyze, watchreplay
+   RATE_CLASS_COUNT
+} RateClass;
+
+typedef struct
+{
+   long long level;      // thousandths of a token
+   long long updated_ms; // monotonic ms of the last refill
+} TokenBucket;
+
+typedef struct
+{
+   TokenBucket connection;
+   TokenBucket classes[RATE_CLASS_COUNT];
+   int strikes; // refused commands in a row
+} RateLimits;
+
+/* Full buckets */
+void rate_limits_init(RateLimits *r, long long now_ms);
+
+/* Take a token for one more command of the connection. Returns 0 when the
+ * bucket is empty, with the ms until a token is back in *wait_ms. */
+int rate_admit_connection(RateLimits *r, long long now_ms, long long *wait_ms);
+
+/* Class of a command word (RATE_CLASS_NONE if it is not a costly one) */
+RateClass rate_class_of(const char *command);
+
+/* Take a token of the command's class. Returns 1 if it may run, 0 if it is
+ * refused (r->strikes counts the refusals in a row). */
+int rate_admit_command(RateLimits *r, RateClass rate_class, long long now_ms);
+
+#endif
@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include <string.h>
+#include "replay_session.h"
+
+static ReplayStream *streams[MAX_REPLAYS];
+static int stream_count = 0;
+static ReplayViewer viewers[MAX_CLIENTS];
+static int viewer_count = 0;
+
+static void release_stream(ReplayStream *s)
+{
+   if (--s->refs > 0)
+      return;
+   for (int i = 0; i < stream_count; i++)
+   {
+      if (streams[i] == s)
+      {
+         streams[i] = streams[--stream_count];
+         break;
+      }
+   }
+   free(s);
+}
+
+ReplayStream *replay_stream_find(int match_id, int move_count)
+{
+   for (int i = 0; i < stream_count; i++)
+   {
+      if (streams[i]->match_id == match_id && streams[i]->move_count == move_count)
+         return streams[i];
+   }
+   return NULL;
+}
+
+ReplayStream *replay_stream_create(const ReplayGame *game, const uint8_t *moves)
+{
+   if (stream_count >= MAX_REPLAYS)
+      return NULL;
+   ReplayStream *s = malloc(sizeof(*s));
+   if (!s)
+      return NULL;
+   s->match_id = game->match_id;
+   s->refs = 0;
+   s->variant = (Variant)game->variant;
+   s->first_player = game->first_player;
+   memcpy(s->players, game->players, sizeof(s->players));
+   s->move_count = game->move_count < MAX_MOVES ? game->move_count : MAX_MOVES;
+   memcpy(s->moves, moves, (size_t)s->move_count);
+
+   Board b;
+   init_board_variant(&b, s->variant);
+   b.current_player = s->first_player;
+   for (int ply = 0; ply < s->move_count; ply++)
+   {
+      if (ply % REPLAY_KEYFRAME_INTERVAL == 0)
+         s->keyframes[ply / REPLAY_KEYFRAME_INTERVAL] = b;
+      if (!is_valid_move(&b, s->moves[ply]))
+      {
+         s->move_count = ply; // damaged record: stop at the last good position
+         break;
+      }
+      apply_move(&b, s->moves[ply]);
+   }
+   if (s->move_count % REPLAY_KEYFRAME_INTERVAL == 0)
+      s->keyframes[s->move_count / REPLAY_KEYFRAME_INTERVAL] = b;
+   streams[stream_count++] = s;
+   return s;
+}
+
+ReplayViewer *replay_viewer_find(int client_id)
+{
+   for (int i = 0; i < viewer_count; i++)
+   {
+      if (viewers[i].client_id == client_id)
+         return &viewers[i];
+   }
+   return NULL;
+}
+
+TimerId replay_viewer_detach(int client_id)
+{
+   TimerId none = {0, 0};
+   ReplayViewer *v = replay_viewer_find(client_id);
+   if (!v)
+      return none;
+   TimerId timer = v->timer;
+   release_stream(v->stream);
+   *v = viewers[--viewer_count];
+   return timer;
+}
+
+ReplayViewer *replay_viewer_attach(int client_id, ReplayStream *stream, int interval_ms)
+{
+   ReplayViewer *v = replay_viewer_find(client_id);
+   if (v)
+   {
+      // the stream is taken before the old one is released: it may be the same
+      stream->refs++;
+      release_stream(v->stream);
+   }
+   else
+   {
+      if (viewer_count >= MAX_CLIENTS)
+      {
+         if (stream->refs == 0)
+            release_stream(stream);
+         return NULL;
+      }
+      v = &viewers[viewer_count++];
+      stream->refs++;
+   }
+   v->client_id = client_id;
+   v->stream = stream;
+   v->interval_ms = interval_ms;
+   v->timer.index = 0;
+   v->timer.generation = 0;
+   replay_viewer_seek(v, 0);
+   return v;
+}
+
+void replay_viewer_seek(ReplayViewer *v, int ply)
+{
+   const ReplayStream *s = v->stream;
+   if (ply < 0)
+      ply = 0;
+   if (ply > s->move_count)
+      ply = s->move_count;
+   int from = ply - ply % REPLAY_KEYFRAME_INTERVAL;
+   v->board = s->keyframes[from / REPLAY_KEYFRAME_INTERVAL];
+   for (int i = from; i < ply; i++)
+      apply_move(&v->board, s->moves[i]);
+   v->ply = ply;
+}
+
+int replay_viewer_step(ReplayViewer *v)
+{
+   if (v->ply >= v->stream->move_count)
+      return 0;
+   apply_move(&v->board, v->stream->moves[v->ply]);
+   v->ply++;
+   return 1;
+}
@@ -0,0 +1,68 @@
+#ifndef REPLAY_SESSION_H
+#define REPLAY_SESSION_H
+
+#include <stdint.h>
+#include "../core/awale.h"
+#include "../utils/constants.h"
+#include "../utils/timer_wheel.h"
+#include "replay_store.h"
+
+/*
+ * REPLAY SESSIONS
+ * ===============
+ * A replay is streamed one position at a time, paced by a timer on the
+ * server's wheel, instead of being sent in one burst.
+ *
+ * A game is decoded once into a ReplayStream: its moves plus a keyframe
+ * (the board) every REPLAY_KEYFRAME_INTERVAL plies. Every viewer of the
+ * same game shares the stream (reference counted) and only keeps its own
+ * position, pace and timer. Seeking rebuilds the board from the nearest
+ * keyframe at or before the target, so it costs at most
+ * REPLAY_KEYFRAME_INTERVAL - 1 moves whatever the length of the game.
+ *
+ * Viewers are keyed by client id (stable across remove_client), one replay
+ * per client.
+ */
+
+typedef struct
+{
+   int match_id;
+   int refs; // viewers sharing the stream
+   Variant variant;
+   int first_player;
+   int move_count;
+   char players[2][MAX_USERNAME_LEN];
+   uint8_t moves[MAX_MOVES];
+   Board keyframes[MAX_MOVES / REPLAY_KEYFRAME_INTERVAL + 1]; // board before ply k * interval
+} ReplayStream;
+
+typedef struct
+{
+   int client_id;
+   ReplayStream *stream;
+   int ply;         // position last sent (0: initial board)
+   Board board;     // board at `ply`
+   int interval_ms; // pace, per move
+   TimerId timer;   // next step (zero handle once the end is reached)
+} ReplayViewer;
+
+/* Stream of a game already decoded for another viewer, NULL if none.
+ * move_count tells a running match's replay apart from a later one. */
+ReplayStream *replay_stream_find(int match_id, int move_count);
+/* Decode a game (moves[i]: pit of ply i, game->moves is ignored); NULL if
+ * MAX_REPLAYS streams are open. A stream without viewers is freed. */
+ReplayStream *replay_stream_create(const ReplayGame *game, const uint8_t *moves);
+
+/* Start `client_id` on `stream` at ply 0, ending its previous replay.
+ * The caller arms the timer. NULL if out of viewers. */
+ReplayViewer *replay_viewer_attach(int client_id, ReplayStream *stream, int interval_ms);
+ReplayViewer *replay_viewer_find(int client_id);
+/* End the client's replay, if any; returns its timer so the caller can
+ * cancel it */
+TimerId replay_viewer_detach(int client_id);
+/* Move the viewer to `ply` (clamped to the game) */
+void replay_viewer_seek(ReplayViewer *v, int ply);
+/* Play the next move; returns 0 at the end of the game */
+int replay_viewer_step(ReplayViewer *v);
+
+#endif
@@ -0,0 +1,470 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "replay_store.h"
+#include "../core/awale.h"
+
+#define SEGMENT_MAGIC "AWRS"
+#define SEGMENT_VERSION 1
+#define SEGMENT_SLOT_BYTES (MAX_MOVES / 2) // packed moves reserved per game while filling
+
+typedef struct
+{
+   char magic[4];
+   uint32_t version;
+   uint32_t first_id;  // match id of index entry 0
+   uint32_t games;     // index entries (REPLAY_SEGMENT_GAMES)
+   uint32_t compacted; // 1: moves packed back to back, read-only
+   uint32_t data_offset;
+   uint32_t data_size;
+   uint32_t reserved;
+} SegmentHeader;
+
+typedef struct
+{
+   uint32_t offset; // of the packed moves, from data_offset
+   uint16_t move_count;
+   uint8_t variant;
+   uint8_t first_player;
+   uint8_t present; // written last: the entry is complete
+   uint8_t reserved[3];
+   int16_t score[2];
+   char players[2][MAX_USERNAME_LEN];
+} SegmentEntry;
+
+/* A mapped segment file */
+typedef struct
+{
+   uint8_t *map; // NULL: not mapped yet
+   size_t size;
+   int writable; // mapped read-write (still being filled)
+} Segment;
+
+static struct
+{
+   int enabled;
+   char dir[1024];
+   Segment *segments; // indexed by segment number
+   int segment_capacity;
+   int next_id;
+   // background compaction
+   pthread_t compactor;
+   int compactor_started;
+   int compacting;        // __atomic: the compactor thread is running
+   int compacted_through; // __atomic: segments below this one are compacted on disk
+   int compact_to;        // the running compactor stops before this segment
+} store;
+
+static size_t index_size(void)
+{
+   return (size_t)REPLAY_SEGMENT_GAMES * sizeof(SegmentEntry);
+}
+
+static size_t filling_size(void)
+{
+   return sizeof(SegmentHeader) + index_size() + (size_t)REPLAY_SEGMENT_GAMES * SEGMENT_SLOT_BYTES;
+}
+
+static void segment_path(char *out, size_t size, int segment, const char *suffix)
+{
+   snprintf(out, size, "%s/replays-%06d.seg%s", store.dir, segment, suffix);
+}
+
+static void report(const char *what, int segment)
+{
+   fprintf(stderr, "%s[replays]%s %s (segment %d): %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, what, segment, strerror(errno));
+}
+
+static const SegmentHeader *header_of(const Segment *s)
+{
+   return (const SegmentHeader *)s->map;
+}
+
+static SegmentEntry *entries_of(const Segment *s)
+{
+   return (SegmentEntry *)(s->map + sizeof(SegmentHeader));
+}
+
+static void unmap_segment(Segment *s)
+{
+   if (s->map)
+      munmap(s->map, s->size);
+   s->map = NULL;
+   s->size = 0;
+   s->writable = 0;
+}
+
+// Make room for segment number `segment` in the table
+static Segment *segment_slot(int segment)
+{
+   if (segment >= store.segment_capacity)
+   {
+      int capacity = store.segment_capacity ? store.segment_capacity : 16;
+      while (capacity <= segment)
+         capacity *= 2;
+      Segment *grown = realloc(store.segments, (size_t)capacity * sizeof(Segment));
+      if (!grown)
+         return NULL;
+      memset(grown + store.segment_capacity, 0, (size_t)(capacity - store.segment_capacity) * sizeof(Segment));
+      store.segments = grown;
+      store.segment_capacity = capacity;
+   }
+   return &store.segments[segment];
+}
+
+static int valid_header(const SegmentHeader *h, size_t size, int segment)
+{
+   return size >= sizeof(*h) && memcmp(h->magic, SEGMENT_MAGIC, 4) == 0 && h->version == SEGMENT_VERSION &&
+          h->first_id == (uint32_t)segment * REPLAY_SEGMENT_GAMES && h->games == REPLAY_SEGMENT_GAMES &&
+          (size_t)h->data_offset + h->data_size <= size;
+}
+
+/* Map an existing segment file (or create it when `create`). Segments the
+ * compactor replaced since they were mapped are mapped again. Returns NULL
+ * if the segment does not exist. */
+static Segment *map_segment(int segment, int create)
+{
+   Segment *s = segment_slot(segment);
+   if (!s)
+      return NULL;
+   if (s->map && s->writable && segment < __atomic_load_n(&store.compacted_through, __ATOMIC_ACQUIRE))
+      unmap_segment(s); // the file behind the mapping was replaced
+   if (s->map)
+      return s;
+
+   char path[1100];
+   segment_path(path, sizeof(path), segment, "");
+   int fd = open(path, create ? O_RDWR | O_CREAT : O_RDWR, 0644);
+   if (fd < 0)
+   {
+      if (errno != ENOENT)
+         report("open", segment);
+      return NULL;
+   }
+   struct stat st;
+   if (fstat(fd, &st) != 0)
+   {
+      report("stat", segment);
+      close(fd);
+      return NULL;
+   }
+   int fresh = st.st_size == 0;
+   if (fresh)
+   {
+      if (!create || ftruncate(fd, (off_t)filling_size()) != 0)
+      {
+         close(fd);
+         return NULL;
+      }
+      st.st_size = (off_t)filling_size();
+   }
+   // compacted segments are never written again
+   SegmentHeader h;
+   int compacted = !fresh && pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) && h.compacted;
+   int prot = compacted ? PROT_READ : PROT_READ | PROT_WRITE;
+   void *map = mmap(NULL, (size_t)st.st_size, prot, MAP_SHARED, fd, 0);
+   close(fd); // the mapping keeps the file
+   if (map == MAP_FAILED)
+   {
+      report("mmap", segment);
+      return NULL;
+   }
+   s->map = map;
+   s->size = (size_t)st.st_size;
+   s->writable = !compacted;
+   if (fresh)
+   {
+      SegmentHeader *nh = (SegmentHeader *)s->map;
+      memcpy(nh->magic, SEGMENT_MAGIC, 4);
+      nh->version = SEGMENT_VERSION;
+      nh->first_id = (uint32_t)segment * REPLAY_SEGMENT_GAMES;
+      nh->games = REPLAY_SEGMENT_GAMES;
+      nh->data_offset = (uint32_t)(sizeof(SegmentHeader) + index_size());
+      nh->data_size = (uint32_t)REPLAY_SEGMENT_GAMES * SEGMENT_SLOT_BYTES;
+   }
+   if (!valid_header(header_of(s), s->size, segment))
+   {
+      fprintf(stderr, "%s[replays]%s Ignoring damaged segment %d\n", COLOR_RED COLOR_BOLD, COLOR_RESET, segment);
+      unmap_segment(s);
+      return NULL;
+   }
+   return s;
+}
+
+/* ---- compaction ---- */
+
+// Rewrite one segment with its moves packed back to back
+static int compact_segment(int segment)
+{
+   char path[1100], tmp_path[1100];
+   segment_path(path, sizeof(path), segment, "");
+   segment_path(tmp_path, sizeof(tmp_path), segment, ".tmp");
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return errno == ENOENT ? 0 : -1; // no game of this range was archived
+   struct stat st;
+   void *map = MAP_FAILED;
+   if (fstat(fd, &st) == 0 && st.st_size > 0)
+      map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+      return -1;
+   Segment old = {map, (size_t)st.st_size, 0};
+   const SegmentHeader *oh = header_of(&old);
+   if (!valid_header(oh, old.size, segment) || oh->compacted)
+   {
+      munmap(map, old.size);
+      return 0;
+   }
+
+   size_t data_size = 0;
+   const SegmentEntry *old_entries = entries_of(&old);
+   for (int i = 0; i < REPLAY_SEGMENT_GAMES; i++)
+      if (old_entries[i].present)
+         data_size += (old_entries[i].move_count + 1u) / 2;
+   size_t size = sizeof(SegmentHeader) + index_size() + data_size;
+   uint8_t *out = calloc(1, size);
+   if (!out)
+   {
+      munmap(map, old.size);
+      return -1;
+   }
+   SegmentHeader *h = (SegmentHeader *)out;
+   *h = *oh;
+   h->compacted = 1;
+   h->data_size = (uint32_t)data_size;
+   SegmentEntry *entries = (SegmentEntry *)(out + sizeof(SegmentHeader));
+   size_t used = 0;
+   for (int i = 0; i < REPLAY_SEGMENT_GAMES; i++)
+   {
+      if (!old_entries[i].present)
+         continue;
+      size_t n = (old_entries[i].move_count + 1u) / 2;
+      entries[i] = old_entries[i];
+      entries[i].offset = (uint32_t)used;
+      memcpy(out + h->data_offset + used, old.map + oh->data_offset + old_entries[i].offset, n);
+      used += n;
+   }
+   munmap(map, old.size);
+
+   int ok = 0;
+   fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd >= 0)
+   {
+      ok = write(fd, out, size) == (ssize_t)size && fdatasync(fd) == 0;
+      close(fd);
+   }
+   free(out);
+   // the rename is atomic: readers see either the old or the new file
+   if (!ok || rename(tmp_path, path) != 0)
+   {
+      unlink(tmp_path);
+      return -1;
+   }
+   return 0;
+}
+
+static void *compactor_main(void *arg)
+{
+   (void)arg;
+   int to = store.compact_to;
+   for (int segment = __atomic_load_n(&store.compacted_through, __ATOMIC_ACQUIRE); segment < to; segment++)
+   {
+      if (compact_segment(segment) != 0)
+      {
+         report("compaction", segment);
+         break; // retried at the next compaction
+      }
+      __atomic_store_n(&store.compacted_through, segment + 1, __ATOMIC_RELEASE);
+   }
+   __atomic_store_n(&store.compacting, 0, __ATOMIC_RELEASE);
+   return NULL;
+}
+
+static void join_compactor(void)
+{
+   if (store.compactor_started)
+      pthread_join(store.compactor, NULL);
+   store.compactor_started = 0;
+}
+
+void replay_store_compact(int oldest_live_id)
+{
+   if (!store.enabled || __atomic_load_n(&store.compacting, __ATOMIC_ACQUIRE))
+      return;
+   join_compactor();
+   // the segment of the next id is still being filled even with no match running
+   int bound = oldest_live_id < store.next_id ? oldest_live_id : store.next_id;
+   int sealed = bound / REPLAY_SEGMENT_GAMES;
+   int from = __atomic_load_n(&store.compacted_through, __ATOMIC_ACQUIRE);
+   if (sealed <= from)
+      return;
+   // the mappings of the sealed segments are dropped now; the next read maps
+   // whichever file is in place (old or compacted, both are complete)
+   for (int segment = from; segment < sealed && segment < store.segment_capacity; segment++)
+      unmap_segment(&store.segments[segment]);
+   store.compact_to = sealed;
+   __atomic_store_n(&store.compacting, 1, __ATOMIC_RELEASE);
+   if (pthread_create(&store.compactor, NULL, compactor_main, NULL) != 0)
+   {
+      __atomic_store_n(&store.compacting, 0, __ATOMIC_RELEASE);
+      return;
+   }
+   store.compactor_started = 1;
+}
+
+/* ---- store ---- */
+
+int replay_store_open(const char *dir)
+{
+   if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+      return -1;
+   DIR *d = opendir(dir);
+   if (!d)
+      return -1;
+   memset(&store, 0, sizeof(store));
+   snprintf(store.dir, sizeof(store.dir), "%s", dir);
+   // the last segment holds the highest archived id
+   int last = -1;
+   struct dirent *e;
+   while ((e = readdir(d)) != NULL)
+   {
+      int segment;
+      char rest[8] = "";
+      if (sscanf(e->d_name, "replays-%d.seg%7s", &segment, rest) < 1 || segment < 0)
+         continue;
+      if (strcmp(rest, ".tmp") == 0)
+      {
+         // leftover of an interrupted compaction
+         char path[1100];
+         segment_path(path, sizeof(path), segment, ".tmp");
+         unlink(path);
+      }
+      else if (rest[0] == '\0' && segment > last)
+         last = segment;
+   }
+   closedir(d);
+   store.enabled = 1;
+
+   // a segment is compacted on disk when its header says so
+   int compacted = 0;
+   while (compacted <= last)
+   {
+      Segment *s = map_segment(compacted, 0);
+      if (s && !header_of(s)->compacted)
+         break;
+      compacted++;
+   }
+   store.compacted_through = compacted;
+   for (int segment = last; segment >= 0 && store.next_id == 0; segment--)
+   {
+      Segment *s = map_segment(segment, 0);
+      if (!s)
+         continue;
+      const SegmentEntry *entries = entries_of(s);
+      for (int i = REPLAY_SEGMENT_GAMES - 1; i >= 0; i--)
+      {
+         if (entries[i].present)
+         {
+            store.next_id = segment * REPLAY_SEGMENT_GAMES + i + 1;
+            break;
+         }
+      }
+   }
+   return 0;
+}
+
+void replay_store_close(void)
+{
+   if (!store.enabled)
+      return;
+   join_compactor();
+   for (int segment = 0; segment < store.segment_capacity; segment++)
+      unmap_segment(&store.segments[segment]);
+   free(store.segments);
+   store.segments = NULL;
+   store.segment_capacity = 0;
+   store.enabled = 0;
+}
+
+int replay_store_enabled(void)
+{
+   return store.enabled;
+}
+
+int replay_store_next_id(void)
+{
+   return store.next_id;
+}
+
+int replay_store_append(const ReplayGame *game, const uint8_t *moves)
+{
+   if (!store.enabled || game->match_id < 0)
+      return -1;
+   int segment = game->match_id / REPLAY_SEGMENT_GAMES;
+   int index = game->match_id % REPLAY_SEGMENT_GAMES;
+   if (segment < __atomic_load_n(&store.compacted_through, __ATOMIC_ACQUIRE))
+      return -1; // sealed: an id this old cannot end now
+   Segment *s = map_segment(segment, 1);
+   if (!s || !s->writable)
+      return -1;
+   int count = game->move_count < MAX_MOVES ? game->move_count : MAX_MOVES;
+   SegmentEntry *entry = &entries_of(s)[index];
+   uint8_t *packed = s->map + header_of(s)->data_offset + (size_t)index * SEGMENT_SLOT_BYTES;
+   // the moves go in before the entry is marked present
+   memset(packed, 0, SEGMENT_SLOT_BYTES);
+   for (int i = 0; i < count; i++)
+      packed[i >> 1] |= (uint8_t)((moves[i] & 0x0f) << ((i & 1) * 4));
+   entry->offset = (uint32_t)index * SEGMENT_SLOT_BYTES;
+   entry->move_count = (uint16_t)count;
+   entry->variant = (uint8_t)game->variant;
+   entry->first_player = (uint8_t)game->first_player;
+   entry->score[0] = (int16_t)game->score[0];
+   entry->score[1] = (int16_t)game->score[1];
+   memcpy(entry->players, game->players, sizeof(entry->players));
+   __atomic_store_n(&entry->present, 1, __ATOMIC_RELEASE);
+   if (game->match_id + 1 > store.next_id)
+      store.next_id = game->match_id + 1;
+   return 0;
+}
+
+int replay_store_get(int match_id, ReplayGame *game)
+{
+   if (!store.enabled || match_id < 0)
+      return 0;
+   Segment *s = map_segment(match_id / REPLAY_SEGMENT_GAMES, 0);
+   if (!s)
+      return 0;
+   const SegmentEntry *entry = &entries_of(s)[match_id % REPLAY_SEGMENT_GAMES];
+   if (!entry->present)
+      return 0;
+   const SegmentHeader *h = header_of(s);
+   if ((size_t)entry->offset + (entry->move_count + 1u) / 2 > h->data_size)
+      return 0;
+   // segments have no checksum: a damaged variant must not pick a move kernel
+   if (entry->variant >= VARIANT_COUNT || entry->first_player > 1)
+      return 0;
+   game->match_id = match_id;
+   game->variant = entry->variant;
+   game->first_player = entry->first_player;
+   game->move_count = entry->move_count;
+   game->score[0] = entry->score[0];
+   game->score[1] = entry->score[1];
+   memcpy(game->players, entry->players, sizeof(game->players));
+   game->players[0][MAX_USERNAME_LEN - 1] = '\0';
+   game->players[1][MAX_USERNAME_LEN - 1] = '\0';
+   game->moves = s->map + h->data_offset + entry->offset;
+   return 1;
+}
+
+int replay_move(const ReplayGame *game, int i)
+{
+   return (game->moves[i >> 1] >> ((i & 1) * 4)) & 0x0f;
+}
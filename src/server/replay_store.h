@@ -0,0 +1,59 @@
+#ifndef REPLAY_STORE_H
+#define REPLAY_STORE_H
+
+#include <stdint.h>
+#include "../utils/constants.h"
+
+/*
+ * REPLAY STORE
+ * ============
+ * Finished games are archived in segment files in the data directory,
+ * replays-NNNNNN.seg, each covering REPLAY_SEGMENT_GAMES consecutive match
+ * ids. A segment is
+ *   header | index (one entry per match id) | packed moves
+ * where the moves of a game are nibbles (two pits per byte). Segments are
+ * memory-mapped for reading, so a game is found by id in O(1): segment
+ * id / REPLAY_SEGMENT_GAMES, entry id % REPLAY_SEGMENT_GAMES.
+ *
+ * A segment being filled reserves MAX_MOVES / 2 bytes of moves per game
+ * (the file is sparse, untouched pages cost nothing). Once no match of its
+ * id range can still end, a background thread compacts it: the moves are
+ * packed back to back into a new file that replaces the old one with a
+ * rename, and readers remap it on their next access.
+ */
+
+/* An archived game; `moves` points into the mapping (valid until the next
+ * replay_store call) */
+typedef struct
+{
+   int match_id;
+   int variant;
+   int first_player;
+   int move_count;
+   int score[2];
+   char players[2][MAX_USERNAME_LEN];
+   const uint8_t *moves; // packed, see replay_move
+} ReplayGame;
+
+/* Open the segments in `dir` (created on the first archived game).
+ * Returns 0 on success, -1 with errno set otherwise. */
+int replay_store_open(const char *dir);
+void replay_store_close(void);
+int replay_store_enabled(void);
+/* One past the highest archived match id (0 if the store is empty) */
+int replay_store_next_id(void);
+
+/* Archive a finished game; moves[i] is the pit of ply i (game->moves is
+ * ignored). Returns 0 on success. */
+int replay_store_append(const ReplayGame *game, const uint8_t *moves);
+/* Look a game up by match id; returns 1 and fills *game if it is archived */
+int replay_store_get(int match_id, ReplayGame *game);
+/* Pit played at ply i of an archived game */
+int replay_move(const ReplayGame *game, int i);
+
+/* Compact, in the background, every segment whose ids are all below
+ * `oldest_live_id` (no running match can still be archived there).
+ * Does nothing while a previous compaction is still running. */
+void replay_store_compact(int oldest_live_id);
+
+#endif
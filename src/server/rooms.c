@@ -0,0 +1,75 @@
+#include <string.h>
+#include "rooms.h"
+
+static Room rooms[MAX_ROOMS];
+
+int rooms_open(void)
+{
+   memset(rooms, 0, sizeof(rooms));
+   if (broadcast_init(&rooms[ROOM_LOBBY].log, BROADCAST_LOG_ENTRIES) != 0)
+      return -1;
+   strcpy(rooms[ROOM_LOBBY].name, ROOM_LOBBY_NAME);
+   return 0;
+}
+
+void rooms_close(void)
+{
+   for (int i = 0; i < MAX_ROOMS; i++)
+   {
+      if (rooms[i].name[0])
+         broadcast_free(&rooms[i].log);
+   }
+   memset(rooms, 0, sizeof(rooms));
+}
+
+int room_find(const char *name)
+{
+   for (int i = 0; i < MAX_ROOMS; i++)
+   {
+      if (rooms[i].name[0] && strcmp(rooms[i].name, name) == 0)
+         return i;
+   }
+   return -1;
+}
+
+int room_open(const char *name)
+{
+   int found = room_find(name);
+   if (found != -1)
+      return found;
+   for (int i = 0; i < MAX_ROOMS; i++)
+   {
+      if (rooms[i].name[0])
+         continue;
+      if (broadcast_init(&rooms[i].log, ROOM_LOG_ENTRIES) != 0)
+         return -1;
+      strncpy(rooms[i].name, name, ROOM_NAME_LEN - 1);
+      rooms[i].name[ROOM_NAME_LEN - 1] = '\0';
+      rooms[i].members = 0;
+      return i;
+   }
+   return -1;
+}
+
+Room *room_get(int index)
+{
+   if (index < 0 || index >= MAX_ROOMS || !rooms[index].name[0])
+      return NULL;
+   return &rooms[index];
+}
+
+void room_enter(int index)
+{
+   Room *r = room_get(index);
+   if (r)
+      r->members++;
+}
+
+void room_leave(int index)
+{
+   Room *r = room_get(index);
+   if (!r || --r->members > 0 || index == ROOM_LOBBY)
+      return;
+   broadcast_free(&r->log);
+   r->name[0] = '\0';
+}
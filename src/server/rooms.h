@@ -0,0 +1,45 @@
+#ifndef ROOMS_H
+#define ROOMS_H
+
+#include "broadcast.h"
+#include "../utils/constants.h"
+
+/*
+ * CHAT ROOMS
+ * ==========
+ * Chat is sharded into named rooms, each with its own broadcast log, so a
+ * message is only fanned out to the members of the room it was said in.
+ * Every client is in exactly one room (Client.room), the lobby when it
+ * connects. A room is created by the first client that joins it and closed
+ * when its last member leaves; the lobby always exists.
+ *
+ * Rooms are referenced by their index in the table, which stays valid as
+ * long as the room has members.
+ */
+
+#define ROOM_LOBBY 0
+
+typedef struct
+{
+   char name[ROOM_NAME_LEN]; // empty for a free slot
+   int members;
+   BroadcastLog log;
+} Room;
+
+/* Create the lobby. Returns 0 on success, -1 if out of memory */
+int rooms_open(void);
+void rooms_close(void);
+
+/* Index of the room called `name`, -1 if there is none */
+int room_find(const char *name);
+/* Index of the room called `name`, created if needed; -1 when MAX_ROOMS are
+ * open (or out of memory) */
+int room_open(const char *name);
+/* Room at `index`, NULL if the slot is free */
+Room *room_get(int index);
+
+/* Membership counts; the last member leaving closes the room */
+void room_enter(int index);
+void room_leave(int index);
+
+#endif
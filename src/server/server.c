@@ -2,17 +2,28 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <ctype.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include "server.h"
+#include "persist.h"
+#include "replay_store.h"
+#include "replay_session.h"
+#include "broadcast.h"
+#include "rooms.h"
+#include "history.h"
 #include "../utils/constants.h"
 #include "../protocol/protocol.h"
 #include "../core/awale.h"
+#include "../utils/clock.h"
+#include "../utils/arena.h"
 #include <time.h>
 #include <stdarg.h>
+#include <math.h>
 
 int find_client_index_by_name(Client *clients, int client_count, const char *name)
 {
@@ -26,9 +37,9 @@ int find_client_index_by_name(Client *clients, int client_count, const char *nam
 
 int is_friend(const Client *c, const char *username)
 {
-   for (int i = 0; i < c->friend_count; i++)
+   for (int i = 0; i < c->cold->friend_count; i++)
    {
-      if (strcmp(c->friends[i], username) == 0)
+      if (strcmp(c->cold->friends[i], username) == 0)
          return 1;
    }
    return 0;
@@ -36,113 +47,623 @@ int is_friend(const Client *c, const char *username)
 
 int add_friend(Client *c, const char *username)
 {
-   if (c->friend_count >= MAX_FRIENDS)
+   if (c->cold->friend_count >= MAX_FRIENDS)
       return 0;
    if (is_friend(c, username))
       return 1;
-   strncpy(c->friends[c->friend_count], username, MAX_USERNAME_LEN - 1);
-   c->friends[c->friend_count][MAX_USERNAME_LEN - 1] = '\0';
-   c->friend_count++;
+   strncpy(c->cold->friends[c->cold->friend_count], username, MAX_USERNAME_LEN - 1);
+   c->cold->friends[c->cold->friend_count][MAX_USERNAME_LEN - 1] = '\0';
+   c->cold->friend_count++;
    return 1;
 }
 
+void make_session_token(char *out)
+{
+   static int urandom = -2;
+   static unsigned long long fallback = 0;
+   unsigned char bytes[SESSION_TOKEN_LEN / 2];
+   if (urandom == -2)
+      urandom = open("/dev/urandom", O_RDONLY);
+   if (urandom < 0 || read(urandom, bytes, sizeof(bytes)) != (ssize_t)sizeof(bytes))
+   {
+      // no kernel randomness: splitmix64 over the clock (guessable, but unique)
+      fallback += 0x9E3779B97F4A7C15ULL ^ (unsigned long long)monotonic_ms();
+      unsigned long long z = fallback;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      z ^= z >> 31;
+      for (size_t i = 0; i < sizeof(bytes); i++)
+         bytes[i] = (unsigned char)(z >> (8 * (i % 8)));
+   }
+   for (size_t i = 0; i < sizeof(bytes); i++)
+      sprintf(out + 2 * i, "%02x", bytes[i]);
+   out[SESSION_TOKEN_LEN] = '\0';
+}
+
+int find_client_index_by_id(Client *clients, int client_count, int id)
+{
+   for (int i = 0; i < client_count; i++)
+   {
+      if (clients[i].id == id)
+         return i;
+   }
+   return -1;
+}
+
+// Remove one name from a pending challenge list, keeping the order; returns its position or -1
+static int remove_pending_name(char list[][MAX_USERNAME_LEN], int *count, const char *name)
+{
+   for (int i = 0; i < *count; i++)
+   {
+      if (strcmp(list[i], name) == 0)
+      {
+         for (int j = i; j < *count - 1; j++)
+         {
+            strncpy(list[j], list[j + 1], MAX_USERNAME_LEN - 1);
+         }
+         (*count)--;
+         return i;
+      }
+   }
+   return -1;
+}
+
+int remove_challenge_to(Client *c, const char *target_name)
+{
+   int pos = remove_pending_name(c->cold->pending_challenge_to, &c->cold->pending_challenge_to_count, target_name);
+   if (pos == -1)
+      return 0;
+   for (int j = pos; j < c->cold->pending_challenge_to_count; j++)
+   {
+      c->cold->pending_challenge_to_id[j] = c->cold->pending_challenge_to_id[j + 1];
+   }
+   return 1;
+}
+
+int remove_challenge_from(Client *c, const char *challenger_name)
+{
+   return remove_pending_name(c->cold->pending_challenge_from, &c->cold->pending_challenge_from_count, challenger_name) != -1;
+}
+
+/* Scratch arena for messages built while handling one batch of events */
+static Arena scratch;
+static int scratch_ready = 0;
+
+static Arena *scratch_arena(void)
+{
+   if (!scratch_ready)
+   {
+      arena_init(&scratch, SCRATCH_BLOCK_SIZE);
+      scratch_ready = 1;
+   }
+   return &scratch;
+}
+
+void server_scratch_reset(void)
+{
+   arena_reset(scratch_arena());
+}
+
+// Store the payload length in front of "TYPE|payload" (the wire format)
+static Frame finish_frame(char *start, size_t message_len)
+{
+   Frame f;
+   memcpy(start, &message_len, sizeof(size_t));
+   f.data = start;
+   f.len = sizeof(size_t) + message_len;
+   return f;
+}
+
+// Frame an already formatted message
+static Frame frame_text(const char *text)
+{
+   size_t len = strlen(text);
+   char *start = arena_alloc(scratch_arena(), sizeof(size_t) + len);
+   if (!start)
+   {
+      Frame none = {NULL, 0};
+      return none;
+   }
+   memcpy(start + sizeof(size_t), text, len);
+   return finish_frame(start, len);
+}
+
+static Frame frame_vprintf(MessageType type, const char *fmt, va_list ap)
+{
+   char header[16];
+   int hlen = snprintf(header, sizeof(header), "%d|", type);
+   size_t len = 0;
+   char *start = arena_vprintf(scratch_arena(), sizeof(size_t) + (size_t)hlen, &len, fmt, ap);
+   if (!start)
+   {
+      Frame none = {NULL, 0};
+      return none;
+   }
+   if (len > MAX_FRAME_SIZE - 1 - (size_t)hlen)
+      len = MAX_FRAME_SIZE - 1 - (size_t)hlen; // clients reject larger frames
+   memcpy(start + sizeof(size_t), header, (size_t)hlen);
+   return finish_frame(start, (size_t)hlen + len);
+}
+
+Frame frame_printf(MessageType type, const char *fmt, ...)
+{
+   va_list ap;
+   va_start(ap, fmt);
+   Frame f = frame_vprintf(type, fmt, ap);
+   va_end(ap);
+   return f;
+}
+
 void notify(int sock, MessageType type, const char *fmt, ...)
 {
-   char payload[BUF_SIZE];
    va_list ap;
    va_start(ap, fmt);
-   vsnprintf(payload, sizeof(payload), fmt, ap);
+   Frame f = frame_vprintf(type, fmt, ap);
    va_end(ap);
-   char msg[BUF_SIZE];
-   protocol_create_message(msg, sizeof(msg), type, payload);
-   write_client(sock, msg);
-}
-
-void broadcast_board(Match *m, Client *clients)
-{
-   char board_txt[BUF_SIZE];
-   render_board(&m->board, board_txt, sizeof(board_txt));
-   // Append turn info for each recipient individually (players see 'Your turn')
-   int p1_turn = (m->board.current_player == 0);
-   int p2_turn = (m->board.current_player == 1);
-   // Player 1 message
-   char payload_p1[BUF_SIZE];
-   if (p1_turn)
-      snprintf(payload_p1, sizeof(payload_p1), "%s\n%s%sYour turn (Player 1)%s", board_txt, COLOR_BLUE, COLOR_BOLD, COLOR_RESET);
-   else
-      snprintf(payload_p1, sizeof(payload_p1), "%s\n%sWaiting...%s", board_txt, STYLE_DIM, COLOR_RESET);
-   char msg_p1[BUF_SIZE];
-   protocol_create_message(msg_p1, sizeof(msg_p1), MSG_BOARD_UPDATE, payload_p1);
-   write_client(clients[m->player1_index].sock, msg_p1);
-   // Player 2 message
-   char payload_p2[BUF_SIZE];
-   if (p2_turn)
-      snprintf(payload_p2, sizeof(payload_p2), "%s\n%s%sYour turn (Player 2)%s", board_txt, COLOR_BLUE, COLOR_BOLD, COLOR_RESET);
-   else
-      snprintf(payload_p2, sizeof(payload_p2), "%s\n%sWaiting...%s", board_txt, STYLE_DIM, COLOR_RESET);
-   char msg_p2[BUF_SIZE];
-   protocol_create_message(msg_p2, sizeof(msg_p2), MSG_BOARD_UPDATE, payload_p2);
-   write_client(clients[m->player2_index].sock, msg_p2);
-   // Watchers: indicate whose turn
-   const char *turn_name = p1_turn ? clients[m->player1_index].name : clients[m->player2_index].name;
-   const char *player_num = p1_turn ? "Player 1" : "Player 2";
-   char payload_w[BUF_SIZE];
-   snprintf(payload_w, sizeof(payload_w), "%s\nTurn: %s (%s)", board_txt, turn_name, player_num);
-   char msg_w[BUF_SIZE];
-   protocol_create_message(msg_w, sizeof(msg_w), MSG_BOARD_UPDATE, payload_w);
-   for (int i = 0; i < m->watcher_count; i++)
+   write_frame(sock, f);
+}
+
+void response_begin(Response *r, int sock, MessageType type, const char *sep)
+{
+   r->sock = sock;
+   r->type = type;
+   r->sep = sep;
+   r->entries = 0;
+   r->frames = 0;
+   r->cap = sizeof(size_t) + MAX_FRAME_SIZE;
+   r->buf = arena_alloc(scratch_arena(), r->cap);
+   if (!r->buf)
+      r->cap = 0;
+   int n = r->buf ? snprintf(r->buf + sizeof(size_t), MAX_FRAME_SIZE, "%d|", type) : 0;
+   r->header_len = sizeof(size_t) + ((n > 0) ? (size_t)n : 0);
+   r->off = r->header_len;
+}
+
+static void response_flush(Response *r)
+{
+   r->buf[r->off] = '\0';
+   write_frame(r->sock, finish_frame(r->buf, r->off - sizeof(size_t)));
+   r->frames++;
+   r->entries = 0;
+   r->off = r->header_len;
+}
+
+// Append one entry; entries are never split across frames (an entry larger
+// than a whole frame is truncated to fit).
+void response_append(Response *r, const char *fmt, ...)
+{
+   if (!r->buf)
+      return;
+   for (int attempt = 0; attempt < 2; attempt++)
    {
-      write_client(m->watchers[i], msg_w);
+      size_t start = r->off;
+      size_t avail = r->cap - start;
+      size_t sep_len = (r->entries > 0 && r->sep) ? strlen(r->sep) : 0;
+      if (sep_len < avail)
+      {
+         if (sep_len > 0)
+            memcpy(r->buf + start, r->sep, sep_len);
+         va_list ap;
+         va_start(ap, fmt);
+         int n = vsnprintf(r->buf + start + sep_len, avail - sep_len, fmt, ap);
+         va_end(ap);
+         if (n >= 0 && (size_t)n < avail - sep_len)
+         {
+            r->off = start + sep_len + (size_t)n;
+            r->entries++;
+            return;
+         }
+         if (n >= 0 && r->entries == 0)
+         {
+            // does not fit even in an empty frame: keep the truncated entry
+            r->off = r->cap - 1;
+            r->entries++;
+            return;
+         }
+      }
+      // roll back and retry in a fresh frame
+      r->off = start;
+      response_flush(r);
    }
 }
 
+void response_end(Response *r, const char *empty_text)
+{
+   if (r->entries == 0 && r->frames == 0 && empty_text)
+      response_append(r, "%s", empty_text);
+   if (r->entries > 0)
+      response_flush(r);
+}
+
+// Index in clients of the player in `seat` (0 or 1), -1 while it is vacant
+static int seat_index(const Match *m, int seat)
+{
+   return seat == 0 ? m->player1_index : m->player2_index;
+}
+
+static int seat_sock(const Match *m, const Client *clients, int seat)
+{
+   int idx = seat_index(m, seat);
+   return idx >= 0 ? clients[idx].sock : -1;
+}
+
+// Private matches can only be followed by friends of one of the players
+static int can_view_match(const Match *m, uint64_t viewer)
+{
+   return !m->private_mode || viewers_contains(&m->viewers, viewer);
+}
+
+// Let the friends of a seated player watch the private match
+static void admit_friends(Match *m, const Client *player)
+{
+   for (int i = 0; i < player->cold->friend_count; i++)
+      viewers_add(&m->viewers, viewer_key(player->cold->friends[i]));
+}
+
+// Authorised viewers of a match going private: the friends of both players
+static void compute_viewers(Match *m, const Client *clients)
+{
+   viewers_clear(&m->viewers);
+   for (int seat = 0; seat < 2; seat++)
+   {
+      int idx = seat_index(m, seat);
+      if (idx >= 0)
+         admit_friends(m, &clients[idx]);
+   }
+}
+
+// `player` made a new friend: admit them to the private matches it is seated in
+static void admit_new_friend(Match *matches, int match_count, int player, const char *friend_name)
+{
+   for (int i = 0; i < match_count; i++)
+   {
+      Match *m = &matches[i];
+      if (m->private_mode && (m->player1_index == player || m->player2_index == player))
+         viewers_add(&m->viewers, viewer_key(friend_name));
+   }
+}
+
+/* Journal records are queued for the persistence writer thread: the move
+ * path only pays for a copy under a mutex */
+static void journal_record(const Match *m, JournalType type, int pit)
+{
+   if (!persist_enabled())
+      return;
+   JournalRecord r;
+   memset(&r, 0, sizeof(r));
+   r.type = type;
+   r.match_id = m->id;
+   r.slot = m->slot;
+   r.ply = m->ply;
+   r.pit = pit;
+   r.clock_ms[0] = m->clock_ms[0];
+   r.clock_ms[1] = m->clock_ms[1];
+   if (type == JOURNAL_START)
+   {
+      r.variant = m->board.variant;
+      r.first_player = m->first_player;
+      r.increment_ms = m->increment_ms;
+      memcpy(r.players, m->player_names, sizeof(r.players));
+   }
+   persist_journal(&r);
+}
+
+static void journal_end(const Match *m)
+{
+   journal_record(m, JOURNAL_END, -1);
+}
+
+/* Save a finished match in the replay store; its slot can then be reused.
+ * A failed save is retried by retry_archives(). */
+static void archive_match(Match *m)
+{
+   if (!replay_store_enabled() || m->id < 0)
+   {
+      m->archived = 1; // nowhere to keep it: only the slot matters
+      return;
+   }
+   ReplayGame g;
+   g.match_id = m->id;
+   g.variant = m->board.variant;
+   g.first_player = m->first_player;
+   g.move_count = m->ply;
+   g.score[0] = m->board.score[0];
+   g.score[1] = m->board.score[1];
+   memcpy(g.players, m->player_names, sizeof(g.players));
+   m->archived = replay_store_append(&g, m->moves) == 0;
+   if (!m->archived)
+   {
+      m->archive_failures++;
+      fprintf(stderr, "%s[replay]%s Cannot archive match #%d (attempt %d of %d)\n", COLOR_RED COLOR_BOLD, COLOR_RESET,
+              m->id, m->archive_failures, ARCHIVE_MAX_RETRIES + 1);
+   }
+}
+
+/* Retry the finished matches the replay store refused; after
+ * ARCHIVE_MAX_RETRIES more failures their replay is given up so that a full
+ * or read-only data directory cannot hold every match slot */
+static void retry_archives(Match *matches, int match_count)
+{
+   for (int i = 0; i < match_count; i++)
+   {
+      Match *m = &matches[i];
+      if (m->is_active || m->archived || m->id < 0)
+         continue;
+      archive_match(m);
+      if (!m->archived && m->archive_failures > ARCHIVE_MAX_RETRIES)
+      {
+         m->archived = 1;
+         fprintf(stderr, "%s[replay]%s Gave up archiving match #%d, its replay is lost\n", COLOR_RED COLOR_BOLD, COLOR_RESET, m->id);
+      }
+   }
+}
+
+// Fill the structured view of a match as seen from `seat` (-1 for watchers)
+static void board_state_of(const Match *m, int seat, BoardState *state)
+{
+   state->match_id = m->id;
+   state->ply = m->ply;
+   state->seat = seat;
+   state->current_player = m->board.current_player;
+   memcpy(state->pits, m->board.pits, sizeof(state->pits));
+   state->score[0] = m->board.score[0];
+   state->score[1] = m->board.score[1];
+   memcpy(state->players, m->player_names, sizeof(state->players));
+}
+
+static Frame board_state_frame(const Match *m, int seat)
+{
+   BoardState state;
+   char payload[BUF_SIZE];
+   board_state_of(m, seat, &state);
+   protocol_format_board(payload, sizeof(payload), &state);
+   return frame_printf(MSG_BOARD_STATE, "%s", payload);
+}
+
+// One move as a MSG_BOARD_DELTA frame: the pits it changed and the capture
+static Frame board_delta_frame(const Match *m, int pit, const Board *before)
+{
+   BoardDelta delta;
+   char payload[BUF_SIZE];
+   delta.match_id = m->id;
+   delta.ply = m->ply;
+   delta.pit = pit;
+   delta.current_player = m->board.current_player;
+   delta.score[0] = m->board.score[0];
+   delta.score[1] = m->board.score[1];
+   delta.captured = (delta.score[0] + delta.score[1]) - (before->score[0] + before->score[1]);
+   delta.changed = 0;
+   for (int i = 0; i < TOTAL_PITS; i++)
+   {
+      if (m->board.pits[i] != before->pits[i])
+      {
+         delta.pits[delta.changed] = i;
+         delta.seeds[delta.changed] = m->board.pits[i];
+         delta.changed++;
+      }
+   }
+   protocol_format_delta(payload, sizeof(payload), &delta);
+   return frame_printf(MSG_BOARD_DELTA, "%s", payload);
+}
+
+/* Same frame to every watcher of the match */
+static void write_watchers(const Match *m, Frame f)
+{
+   for (int h = m->watchers.head; h != WATCH_NONE; h = watch_get(h)->match_next)
+      write_frame(watch_get(h)->sock, f);
+}
+
+// Board as seen by the player in `seat`: `delta` if there is one and the
+// player takes deltas, otherwise a keyframe
+static void send_player_board(const Match *m, Client *clients, int seat, Frame delta)
+{
+   int idx = seat_index(m, seat);
+   if (idx < 0)
+      return; // seat vacant until the player resumes
+   Client *p = &clients[idx];
+   if (p->board_format == BOARD_FORMAT_DELTA && delta.data)
+      write_frame(p->sock, delta);
+   else
+      write_frame(p->sock, board_state_frame(m, seat));
+}
+
+void send_board(Match *m, Client *clients, int client_index)
+{
+   Frame none = {NULL, 0};
+   send_player_board(m, clients, client_index == m->player1_index ? 0 : 1, none);
+}
+
+// Send the board to both players and every watcher; clients render it
+static void send_board_update(Match *m, Client *clients, int client_count, Frame delta)
+{
+   (void)client_count;
+   send_player_board(m, clients, 0, delta);
+   send_player_board(m, clients, 1, delta);
+   // Watchers share one frame per format
+   Frame data = {NULL, 0};
+   for (int h = m->watchers.head; h != WATCH_NONE; h = watch_get(h)->match_next)
+   {
+      const WatchEntry *w = watch_get(h);
+      if (delta.data && w->board_format == BOARD_FORMAT_DELTA)
+      {
+         write_frame(w->sock, delta);
+         continue;
+      }
+      if (!data.data)
+         data = board_state_frame(m, -1);
+      write_frame(w->sock, data);
+   }
+}
+
+void broadcast_board(Match *m, Client *clients, int client_count)
+{
+   Frame keyframe = {NULL, 0};
+   send_board_update(m, clients, client_count, keyframe);
+}
+
+void broadcast_move(Match *m, Client *clients, int client_count, int pit, const Board *before)
+{
+   int wants_delta = 0; // the delta is only framed if somebody asked for it
+   for (int seat = 0; seat < 2; seat++)
+   {
+      int idx = seat_index(m, seat);
+      wants_delta |= idx >= 0 && clients[idx].board_format == BOARD_FORMAT_DELTA;
+   }
+   for (int h = m->watchers.head; h != WATCH_NONE && !wants_delta; h = watch_get(h)->match_next)
+      wants_delta = watch_get(h)->board_format == BOARD_FORMAT_DELTA;
+   Frame delta = {NULL, 0};
+   if (wants_delta)
+      delta = board_delta_frame(m, pit, before);
+   send_board_update(m, clients, client_count, delta);
+}
+
 void end_match(Match *m, Client *clients)
 {
    if (!m)
       return;
+   if (m->is_active)
+   {
+      archive_match(m);
+      history_add_game(m->id, m->board.variant, m->player_names, m->board.score, (int64_t)time(NULL));
+   }
    m->is_active = 0;
-   clients[m->player1_index].status = CLIENT_IDLE;
-   clients[m->player2_index].status = CLIENT_IDLE;
-   clients[m->player1_index].current_match = -1;
-   clients[m->player2_index].current_match = -1;
-   clients[m->player1_index].is_turn = 0;
-   clients[m->player2_index].is_turn = 0;
+   m->dirty = 1;
+   journal_end(m);
+   for (int seat = 0; seat < 2; seat++)
+   {
+      int idx = seat_index(m, seat);
+      if (idx < 0)
+         continue;
+      clients[idx].status = CLIENT_IDLE;
+      clients[idx].current_match = -1;
+      clients[idx].is_turn = 0;
+   }
    // Notify watchers about game over with final score
-   char payload[BUF_SIZE];
    const char *winner = NULL;
    if (m->board.score[0] > m->board.score[1])
-      winner = clients[m->player1_index].name;
+      winner = m->player_names[0];
    else if (m->board.score[1] > m->board.score[0])
-      winner = clients[m->player2_index].name;
+      winner = m->player_names[1];
+   Frame f;
    if (winner)
-      snprintf(payload, sizeof(payload), "Game over. Winner: %s (%d-%d)", winner, m->board.score[0], m->board.score[1]);
+      f = frame_printf(MSG_GAME_OVER, "Game over. Winner: %s (%d-%d)", winner, m->board.score[0], m->board.score[1]);
    else
-      snprintf(payload, sizeof(payload), "Game over. Draw (%d-%d)", m->board.score[0], m->board.score[1]);
-   char msg[BUF_SIZE];
-   protocol_create_message(msg, sizeof(msg), MSG_GAME_OVER, payload);
-   for (int i = 0; i < m->watcher_count; i++)
+      f = frame_printf(MSG_GAME_OVER, "Game over. Draw (%d-%d)", m->board.score[0], m->board.score[1]);
+   write_watchers(m, f);
+}
+
+// Count the win and move both Elo ratings (draw: winner/loser order is irrelevant)
+void record_result(Client *clients, int winner_index, int loser_index, int draw)
+{
+   if (winner_index < 0 || loser_index < 0)
+      return; // a seat of a restored match is still vacant
+   Client *w = &clients[winner_index];
+   Client *l = &clients[loser_index];
+   if (!draw)
+      w->wins++;
+   double expected = 1.0 / (1.0 + pow(10.0, (l->rating - w->rating) / 400.0));
+   double score = draw ? 0.5 : 1.0;
+   int delta = (int)lround(RATING_K_FACTOR * (score - expected));
+   w->rating += delta;
+   l->rating -= delta;
+}
+
+// Format both remaining clock times as "name m:ss | name m:ss"
+static void format_clocks(const Match *m, char *out, size_t out_size)
+{
+   long long s1 = (m->clock_ms[0] + 999) / 1000;
+   long long s2 = (m->clock_ms[1] + 999) / 1000;
+   snprintf(out, out_size, "%s %lld:%02lld | %s %lld:%02lld",
+            m->player_names[0], s1 / 60, s1 % 60,
+            m->player_names[1], s2 / 60, s2 % 60);
+}
+
+// Start the clock of the side to move; flagging is detected by a wheel timer
+static void start_turn_clock(Match *m, ServerTimers *timers, long long now)
+{
+   if (m->increment_ms < 0)
+      return; // untimed match
+   m->turn_started = now;
+   m->flag_timer = timer_add(&timers->wheel, now, m->clock_ms[m->board.current_player],
+                             TIMER_MATCH_FLAG, m->id, m->ply);
+}
+
+/* A player entering a match, whether through a challenge or the queue,
+ * refuses the challenges it received and cancels the ones it sent */
+static void drop_challenges(Client *clients, int client_count, int i)
+{
+   ClientCold *cold = clients[i].cold;
+   for (int j = 0; j < cold->pending_challenge_from_count; j++)
+   {
+      int other = find_client_index_by_name(clients, client_count, cold->pending_challenge_from[j]);
+      if (other != -1 && remove_challenge_to(&clients[other], clients[i].name))
+         notify(clients[other].sock, MSG_CHALLENGE_RESPONSE, "%s started another game and refused your challenge", clients[i].name);
+   }
+   cold->pending_challenge_from_count = 0;
+   for (int j = 0; j < cold->pending_challenge_to_count; j++)
+   {
+      int other = find_client_index_by_name(clients, client_count, cold->pending_challenge_to[j]);
+      if (other != -1 && remove_challenge_from(&clients[other], clients[i].name))
+         notify(clients[other].sock, MSG_CHALLENGE_RESPONSE, "%s cancelled their challenge (started another game)", clients[i].name);
+   }
+   cold->pending_challenge_to_count = 0;
+}
+
+// Ids keep growing across restarts so that archived replays stay addressable
+static int next_match_id = 0;
+
+// A new slot while the table has room, else the oldest archived match's
+static Match *free_match_slot(Match *matches, int *match_count)
+{
+   if (*match_count < MAX_MATCHES)
    {
-      write_client(m->watchers[i], msg);
+      Match *m = &matches[*match_count];
+      m->slot = (*match_count)++;
+      return m;
+   }
+   Match *oldest = NULL;
+   for (int i = 0; i < *match_count; i++)
+   {
+      Match *m = &matches[i];
+      if (m->is_active || (!m->archived && m->id >= 0))
+         continue;
+      if (!oldest || m->id < oldest->id)
+         oldest = m;
    }
+   return oldest;
 }
 
-Match *start_match(Client *clients, int a, int b, Match *matches, int *match_count)
+Match *start_match(Client *clients, int client_count, int a, int b, Variant variant, Match *matches, int *match_count, ServerTimers *timers)
 {
-   if (*match_count >= MAX_MATCHES)
+   Match *m = free_match_slot(matches, match_count);
+   if (!m)
       return NULL;
-   Match *m = &matches[*match_count];
-   m->id = *match_count;
+   m->id = next_match_id++;
+   m->archived = 0;
+   m->archive_failures = 0;
    m->player1_index = a;
    m->player2_index = b;
-   init_board(&m->board);
-   m->watcher_count = 0;
+   strncpy(m->player_names[0], clients[a].name, MAX_USERNAME_LEN - 1);
+   m->player_names[0][MAX_USERNAME_LEN - 1] = '\0';
+   strncpy(m->player_names[1], clients[b].name, MAX_USERNAME_LEN - 1);
+   m->player_names[1][MAX_USERNAME_LEN - 1] = '\0';
+   init_board_variant(&m->board, variant);
+   watch_clear(&m->watchers); // watchers of the archived match the slot held
    m->private_mode = 0;
    m->is_active = 1;
-   m->replay_move_count = 0;
+   m->ply = 0;
+   m->analysis_ply = -1;
+   // time control: increment_ms < 0 marks an untimed match
+   m->clock_ms[0] = timers->base_ms;
+   m->clock_ms[1] = timers->base_ms;
+   m->increment_ms = timers->base_ms > 0 ? timers->increment_ms : -1;
+   m->flag_timer.index = 0;
    clients[a].status = CLIENT_IN_MATCH;
    clients[b].status = CLIENT_IN_MATCH;
    clients[a].current_match = m->id;
    clients[b].current_match = m->id;
+   clients[a].queued = 0;
+   clients[b].queued = 0;
    // Randomly choose who starts: 0 -> a, 1 -> b
    srand((unsigned int)time(NULL) ^ (unsigned int)(a << 8) ^ (unsigned int)(b << 16));
    int starter = rand() % 2;
@@ -158,20 +679,24 @@ Match *start_match(Client *clients, int a, int b, Match *matches, int *match_cou
       clients[a].is_turn = 0;
       clients[b].is_turn = 1;
    }
+   m->first_player = m->board.current_player;
+   m->dirty = 1;
+   journal_record(m, JOURNAL_START, -1);
+   drop_challenges(clients, client_count, a);
+   drop_challenges(clients, client_count, b);
    // Notify players
-   notify(clients[a].sock, MSG_CHALLENGE_RESPONSE, "Game started vs %s. %s starts.", clients[b].name, clients[a].is_turn ? "You" : "Opponent");
-   notify(clients[b].sock, MSG_CHALLENGE_RESPONSE, "Game started vs %s. %s starts.", clients[a].name, clients[b].is_turn ? "You" : "Opponent");
-   broadcast_board(m, clients);
-   // store initial board snapshot for replay (before any move)
-   if (m->replay_move_count < MAX_MOVES)
-   {
-      char snap[BUF_SIZE];
-      render_board(&m->board, snap, sizeof(snap));
-      strncpy(m->replay_boards[m->replay_move_count], snap, BUF_SIZE - 1);
-      m->replay_boards[m->replay_move_count][BUF_SIZE - 1] = '\0';
-      m->replay_move_count++;
-   }
-   (*match_count)++;
+   const char *rules = variant_info(variant)->name;
+   notify(clients[a].sock, MSG_CHALLENGE_RESPONSE, "Game started vs %s (%s rules). %s starts.", clients[b].name, rules, clients[a].is_turn ? "You" : "Opponent");
+   notify(clients[b].sock, MSG_CHALLENGE_RESPONSE, "Game started vs %s (%s rules). %s starts.", clients[a].name, rules, clients[b].is_turn ? "You" : "Opponent");
+   if (m->increment_ms >= 0)
+   {
+      char clocks[128];
+      format_clocks(m, clocks, sizeof(clocks));
+      notify(clients[a].sock, MSG_INFO, "Clocks: %s (+%llds per move)", clocks, m->increment_ms / 1000);
+      notify(clients[b].sock, MSG_INFO, "Clocks: %s (+%llds per move)", clocks, m->increment_ms / 1000);
+   }
+   broadcast_board(m, clients, client_count);
+   start_turn_clock(m, timers, monotonic_ms());
    return m;
 }
 
@@ -180,37 +705,103 @@ void clear_clients(Client *clients, int client_count)
    int i = 0;
    for (i = 0; i < client_count; i++)
    {
+      broadcast_forget(clients[i].sock);
       close(clients[i].sock);
    }
 }
 
+static ClientCold cold_pool[MAX_CLIENTS];
+static ClientCold *cold_free[MAX_CLIENTS];
+static int cold_free_count = -1; // -1 until the free list is built
+
+ClientCold *client_cold_alloc(void)
+{
+   if (cold_free_count < 0)
+   {
+      for (cold_free_count = 0; cold_free_count < MAX_CLIENTS; cold_free_count++)
+         cold_free[cold_free_count] = &cold_pool[MAX_CLIENTS - 1 - cold_free_count];
+   }
+   if (cold_free_count == 0)
+      return NULL;
+   ClientCold *cold = cold_free[--cold_free_count];
+   memset(cold, 0, sizeof(*cold));
+   return cold;
+}
+
+void client_cold_free(ClientCold *cold)
+{
+   if (cold)
+      cold_free[cold_free_count++] = cold;
+}
+
 void remove_client(Client *clients, int to_remove, int *client_count)
 {
+   chat_leave(&clients[to_remove]);
+   if (clients[to_remove].cold)
+      watch_clear(&clients[to_remove].cold->watching);
+   client_cold_free(clients[to_remove].cold);
    /* we remove the client in the array */
    memmove(clients + to_remove, clients + to_remove + 1, (*client_count - to_remove - 1) * sizeof(Client));
    /* number client - 1 */
    (*client_count)--;
 }
 
-void send_message_to_all_clients(Client *clients, Client sender, int client_count, const char *buffer, char from_server)
+/* Chat goes through the broadcast log of the sender's room */
+static BroadcastLog *room_log(int room)
 {
-   int i = 0;
-   for (i = 0; i < client_count; i++)
+   Room *r = room_get(room);
+   return r ? &r->log : NULL;
+}
+
+void chat_join(Client *c)
+{
+   c->room = ROOM_LOBBY;
+   room_enter(ROOM_LOBBY);
+   c->chat_cursor = room_log(ROOM_LOBBY)->head;
+}
+
+void chat_leave(Client *c)
+{
+   room_leave(c->room);
+   c->room = -1;
+}
+
+int chat_pending(const Client *c)
+{
+   const BroadcastLog *log = room_log(c->room);
+   return log && c->sock >= 0 && (c->chat_cursor < log->head || broadcast_spilled(c->sock));
+}
+
+int deliver_chat(Client *clients, int client_count)
+{
+   int waiting = 0;
+   for (int i = 0; i < client_count; i++)
    {
-      /* we don't send message to the sender */
-      if (sender.sock != clients[i].sock)
-      {
-         char message[BUF_SIZE];
-         message[0] = 0;
-         if (from_server == 0)
-         {
-            strncpy(message, sender.name, BUF_SIZE - 1);
-            strncat(message, " : ", sizeof message - strlen(message) - 1);
-         }
-         strncat(message, buffer, sizeof message - strlen(message) - 1);
-         printf("message: %s\n", message);
-         write_client(clients[i].sock, message);
-      }
+      if (chat_pending(&clients[i]))
+         waiting |= broadcast_deliver(room_log(clients[i].room), clients[i].sock, clients[i].id, &clients[i].chat_cursor);
+   }
+   return waiting;
+}
+
+void send_message_to_all_clients(const Client *sender, const char *buffer, char from_server)
+{
+   /* the text is the same for everyone: framed once per room log */
+   char message[BUF_SIZE];
+   message[0] = 0;
+   if (from_server == 0)
+   {
+      strncpy(message, sender->name, BUF_SIZE - 1);
+      strncat(message, " : ", sizeof message - strlen(message) - 1);
+   }
+   strncat(message, buffer, sizeof message - strlen(message) - 1);
+   printf("message: %s\n", message);
+   /* we don't send message to the sender; server notices reach every room */
+   Frame f = frame_text(message);
+   for (int room = 0; room < MAX_ROOMS; room++)
+   {
+      BroadcastLog *log = room_log(room);
+      if (log && (from_server || room == sender->room))
+         broadcast_append(log, sender->id, f.data, f.len);
    }
 }
 
@@ -225,6 +816,10 @@ int init_connection(int port)
       exit(errno);
    }
 
+   /* a restarted server must not wait for the old connections' TIME_WAIT */
+   int reuse = 1;
+   setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
    sin.sin_addr.s_addr = htonl(INADDR_ANY);
    sin.sin_port = htons(port);
    sin.sin_family = AF_INET;
@@ -249,41 +844,87 @@ void end_connection(int sock)
    close(sock);
 }
 
-int read_from_client(int sock, char *buffer)
+/* Append whatever the socket has to the client's input buffer.
+ * Returns the number of bytes read, 0 if the client left (or on error). */
+int read_client_input(Client *client)
 {
-   int n = 0;
-
-   if ((n = recv(sock, buffer, BUF_SIZE - 1, 0)) < 0)
+   size_t room = sizeof(client->cold->input) - client->input_len;
+   if (room == 0)
+      return 1; // a full line is still waiting to be consumed
+   ssize_t n = recv(client->sock, client->cold->input + client->input_len, room, 0);
+   if (n < 0)
    {
       perror("recv()");
       /* if recv error we disonnect the client */
       n = 0;
    }
-
-   buffer[n] = 0;
-
-   return n;
+   client->input_len += (size_t)n;
+   return (int)n;
 }
 
-void write_client(int sock, const char *buffer)
+/* 1 if a complete command is waiting in the client's input buffer */
+int has_client_command(const Client *client)
 {
-   size_t len = strlen(buffer);
+   if (client->input_len == 0)
+      return 0; // the common case, without touching the cold part
+   return client->input_len == sizeof(client->cold->input) || memchr(client->cold->input, '\n', client->input_len) != NULL;
+}
 
-   /* Send message length first (4 bytes) */
-   if (send(sock, (char *)&len, sizeof(len), 0) < 0)
+/* Pop the next '\n' terminated command from the client's input buffer.
+ * A buffer full of bytes without any newline is returned as one (truncated)
+ * command so that a misbehaving client cannot stall its connection.
+ * Returns 1 if a command was stored in `command`, 0 if none is complete. */
+int next_client_command(Client *client, char *command, size_t size)
+{
+   char *nl = memchr(client->cold->input, '\n', client->input_len);
+   size_t line_len;
+   size_t consumed;
+   if (nl)
    {
-      perror("send() - length");
-      exit(errno);
+      line_len = (size_t)(nl - client->cold->input);
+      consumed = line_len + 1;
    }
-
-   /* Send client_count message */
-   if (send(sock, buffer, len, 0) < 0)
+   else if (client->input_len == sizeof(client->cold->input))
    {
-      perror("send() - message");
-      exit(errno);
+      line_len = client->input_len;
+      consumed = client->input_len;
+   }
+   else
+   {
+      return 0;
+   }
+   if (line_len > 0 && client->cold->input[line_len - 1] == '\r')
+      line_len--;
+   if (line_len > size - 1)
+      line_len = size - 1;
+   memcpy(command, client->cold->input, line_len);
+   command[line_len] = '\0';
+   client->input_len -= consumed;
+   memmove(client->cold->input, client->cold->input + consumed, client->input_len);
+   return 1;
+}
+
+void write_frame(int sock, Frame f)
+{
+   if (sock < 0)
+      return; // vacant seat of a restored match
+   broadcast_flush(sock); // a chat frame cut short goes first
+   /* Length prefix and message go out in a single send */
+   size_t sent = 0;
+   while (sent < f.len)
+   {
+      ssize_t n = send(sock, f.data + sent, f.len - sent, MSG_NOSIGNAL);
+      if (n < 0)
+         return; // the peer is gone: the read side notices and cleans up
+      sent += (size_t)n;
    }
 }
 
+void write_client(int sock, const char *buffer)
+{
+   write_frame(sock, frame_text(buffer));
+}
+
 char *get_server_ip(void)
 {
    static char ip_str[INET_ADDRSTRLEN];
@@ -326,70 +967,114 @@ char *get_server_ip(void)
    return ip_str;
 }
 
-void handle_list_command(int sock, Client *clients, int client_count)
+void handle_list_command(int sock, Client *clients, int client_index, int client_count)
 {
-   /* Build list of all online users with names and bios on separate lines */
-   char user_list[BUF_SIZE];
-   user_list[0] = 0;
+   /* Stream the users of the client's room with names and bios on separate lines */
+   Response r;
+   response_begin(&r, sock, MSG_LIST_USERS, "\n");
 
-   for (int i = 0; i < client_count; i++)
+   int room = clients[client_index].room;
+   const Room *joined = room_get(room);
+   int left = joined ? joined->members : 0;
+   for (int i = 0; i < client_count && left > 0; i++)
    {
-      /* Add user name */
-      strncat(user_list, clients[i].name, BUF_SIZE - strlen(user_list) - 1);
+      if (clients[i].room != room)
+         continue;
+      left--;
+      /* Add user name, then bio or "no bio" (with dimmed style) */
+      const char *bio = clients[i].cold->bio[0] != '\0' ? clients[i].cold->bio : "no bio";
+      response_append(&r, "%s%s\n%s%s%s", clients[i].name, clients[i].sock < 0 ? " (reconnecting)" : "", STYLE_DIM, bio, COLOR_RESET);
+   }
+   response_end(&r, NULL);
 
-      /* Add bio or "no bio" (with dimmed style) */
-      strncat(user_list, "\n", BUF_SIZE - strlen(user_list) - 1);
-      strncat(user_list, STYLE_DIM, BUF_SIZE - strlen(user_list) - 1);
+   printf("%s[list]%s Sent user list to client (%d frame(s))\n", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, r.frames);
+}
 
-      if (strlen(clients[i].bio) > 0)
-      {
-         strncat(user_list, clients[i].bio, BUF_SIZE - strlen(user_list) - 1);
-      }
-      else
-      {
-         strncat(user_list, "no bio", BUF_SIZE - strlen(user_list) - 1);
-      }
+void handle_message_command(int sock, const Client *sender, const char *message)
+{
+   /* Send acknowledgment to sender */
+   notify(sock, MSG_INFO, "Message received");
 
-      strncat(user_list, COLOR_RESET, BUF_SIZE - strlen(user_list) - 1);
+   /* Broadcast message to the other clients of the room: framed once into
+    * its log, each member is served from it as fast as its connection allows */
+   Room *room = room_get(sender->room);
+   if (!room)
+      return;
+   Frame f = frame_printf(MSG_CHAT, "%s: %s", sender->name, message);
+   broadcast_append(&room->log, sender->id, f.data, f.len);
 
-      /* Add separator except for last user */
-      if (i < client_count - 1)
-      {
-         strncat(user_list, "\n", BUF_SIZE - strlen(user_list) - 1);
-      }
+   printf("%s[broadcast]%s Message from %s logged as #%llu in %s\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, sender->name, (unsigned long long)room->log.head - 1, room->name);
+}
+
+/* A room name is a word of letters, digits, '-' and '_' */
+static int valid_room_name(const char *name)
+{
+   size_t len = strlen(name);
+   if (len == 0 || len >= ROOM_NAME_LEN)
+      return 0;
+   for (size_t i = 0; i < len; i++)
+   {
+      if (!isalnum((unsigned char)name[i]) && name[i] != '-' && name[i] != '_')
+         return 0;
    }
-   /* Send user list to sender */
-   char response[BUF_SIZE];
-   protocol_create_message(response, BUF_SIZE, MSG_LIST_USERS, user_list);
-   write_client(sock, response);
+   return 1;
+}
 
-   printf("%s[list]%s Sent user list to client\n", COLOR_YELLOW COLOR_BOLD, COLOR_RESET);
+/* Tell the other members of a room that `c` came or went */
+static void room_notice(const Client *c, int room, const char *what)
+{
+   Room *r = room_get(room);
+   if (!r)
+      return;
+   Frame f = frame_printf(MSG_INFO, "%s %s %s", c->name, what, r->name);
+   broadcast_append(&r->log, c->id, f.data, f.len);
 }
 
-void handle_message_command(int sock, Client *clients, Client sender, int client_count, const char *message)
+void handle_join_command(int sock, Client *clients, int client_index, const char *args)
 {
-   /* Send acknowledgment to sender */
-   char ack[BUF_SIZE];
-   protocol_create_message(ack, BUF_SIZE, MSG_INFO, "Message received");
-   write_client(sock, ack);
+   Client *c = &clients[client_index];
+   const char *name = (args && args[0]) ? args : ROOM_LOBBY_NAME;
+   if (!valid_room_name(name))
+   {
+      notify(sock, MSG_ERROR, "Usage: join <room> (letters, digits, '-' and '_', at most %d characters)", ROOM_NAME_LEN - 1);
+      return;
+   }
+   Room *current = room_get(c->room);
+   if (current && strcmp(current->name, name) == 0)
+   {
+      notify(sock, MSG_ERROR, "You are already in %s", name);
+      return;
+   }
+   int room = room_open(name);
+   if (room == -1)
+   {
+      notify(sock, MSG_ERROR, "Cannot open room %s: %d rooms are open already", name, MAX_ROOMS);
+      return;
+   }
 
-   /* Broadcast message to all other clients */
-   char formatted_msg[BUF_SIZE];
-   snprintf(formatted_msg, BUF_SIZE, "%s: %s", sender.name, message);
+   room_notice(c, c->room, "left");
+   chat_leave(c);
+   c->room = room;
+   room_enter(room);
+   Room *r = room_get(room);
+   c->chat_cursor = r->log.head; // no history: only what is said from now on
+   room_notice(c, room, "joined");
 
-   char broadcast[BUF_SIZE];
-   protocol_create_message(broadcast, BUF_SIZE, MSG_CHAT, formatted_msg);
+   notify(sock, MSG_INFO, "Joined %s (%d member%s)", r->name, r->members, r->members == 1 ? "" : "s");
+   printf("%s[room]%s %s joined %s\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, c->name, r->name);
+}
 
-   for (int i = 0; i < client_count; i++)
+void handle_rooms_command(int sock)
+{
+   Response r;
+   response_begin(&r, sock, MSG_INFO, "\n");
+   for (int room = 0; room < MAX_ROOMS; room++)
    {
-      /* Send to all clients except sender */
-      if (sender.sock != clients[i].sock)
-      {
-         write_client(clients[i].sock, broadcast);
-      }
+      const Room *open = room_get(room);
+      if (open)
+         response_append(&r, "%s (%d member%s)", open->name, open->members, open->members == 1 ? "" : "s");
    }
-
-   printf("%s[broadcast]%s Message from %s sent to %d clients\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, sender.name, client_count - 1);
+   response_end(&r, NULL);
 }
 
 int is_username_unique(Client *clients, int client_count, const char *username)
@@ -411,33 +1096,25 @@ void handle_bio_command(int sock, Client *clients, int client_index, const char
    /* Validate bio text */
    if (bio_text == NULL || strlen(bio_text) == 0)
    {
-      char error_msg[BUF_SIZE];
-      protocol_create_message(error_msg, BUF_SIZE, MSG_ERROR, "Bio text cannot be empty");
-      write_client(sock, error_msg);
+      notify(sock, MSG_ERROR, "Bio text cannot be empty");
       return;
    }
 
    /* Check bio length */
    if (strlen(bio_text) > MAX_BIO_LEN - 1)
    {
-      char error_msg[BUF_SIZE];
-      snprintf(error_msg, BUF_SIZE, "Bio text too long (max %d characters)", MAX_BIO_LEN - 1);
-      protocol_create_message(error_msg, BUF_SIZE, MSG_ERROR, error_msg);
-      write_client(sock, error_msg);
+      notify(sock, MSG_ERROR, "Bio text too long (max %d characters)", MAX_BIO_LEN - 1);
       return;
    }
 
    /* Update the bio for the current user */
-   strncpy(clients[client_index].bio, bio_text, MAX_BIO_LEN - 1);
-   clients[client_index].bio[MAX_BIO_LEN - 1] = 0;
+   strncpy(clients[client_index].cold->bio, bio_text, MAX_BIO_LEN - 1);
+   clients[client_index].cold->bio[MAX_BIO_LEN - 1] = 0;
 
    /* Send confirmation message to the user */
-   char ack[BUF_SIZE];
-   snprintf(ack, BUF_SIZE, "Bio updated: %s", clients[client_index].bio);
-   protocol_create_message(ack, BUF_SIZE, MSG_BIO_SET, ack);
-   write_client(sock, ack);
+   notify(sock, MSG_BIO_SET, "Bio updated: %s", clients[client_index].cold->bio);
 
-   printf("%s[bio]%s %s updated bio: %s\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET, clients[client_index].name, clients[client_index].bio);
+   printf("%s[bio]%s %s updated bio: %s\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET, clients[client_index].name, clients[client_index].cold->bio);
 }
 
 void handle_getbio_command(int sock, Client *clients, int client_count, const char *username)
@@ -445,9 +1122,7 @@ void handle_getbio_command(int sock, Client *clients, int client_count, const ch
    /* Validate username */
    if (username == NULL || strlen(username) == 0)
    {
-      char error_msg[BUF_SIZE];
-      protocol_create_message(error_msg, BUF_SIZE, MSG_ERROR, "Usage: getbio <username>");
-      write_client(sock, error_msg);
+      notify(sock, MSG_ERROR, "Usage: getbio <username>");
       return;
    }
 
@@ -464,38 +1139,27 @@ void handle_getbio_command(int sock, Client *clients, int client_count, const ch
 
    if (found_index == -1)
    {
-      char error_msg[BUF_SIZE];
-      char tmp[BUF_SIZE];
-      snprintf(tmp, BUF_SIZE, "User '%s' not found", username);
-      protocol_create_message(error_msg, BUF_SIZE, MSG_ERROR, tmp);
-      write_client(sock, error_msg);
+      notify(sock, MSG_ERROR, "User '%s' not found", username);
       return;
    }
 
-   /* Build bio response */
-   char payload[BUF_SIZE];
-   if (strlen(clients[found_index].bio) > 0)
+   /* Send bio response */
+   if (strlen(clients[found_index].cold->bio) > 0)
    {
-      snprintf(payload, BUF_SIZE, "%s: %s", clients[found_index].name, clients[found_index].bio);
+      notify(sock, MSG_BIO_INFO, "%s: %s", clients[found_index].name, clients[found_index].cold->bio);
    }
    else
    {
-      snprintf(payload, BUF_SIZE, "%s: no bio", clients[found_index].name);
+      notify(sock, MSG_BIO_INFO, "%s: no bio", clients[found_index].name);
    }
-
-   char response[BUF_SIZE];
-   protocol_create_message(response, BUF_SIZE, MSG_BIO_INFO, payload);
-   write_client(sock, response);
 }
 
-void handle_pm_command(int sock, Client *clients, Client sender, int client_count, const char *args)
+void handle_pm_command(int sock, Client *clients, const Client *sender, int client_count, const char *args)
 {
    /* Validate args: expect "<username> <message>" */
    if (args == NULL || strlen(args) == 0)
    {
-      char error_msg[BUF_SIZE];
-      protocol_create_message(error_msg, BUF_SIZE, MSG_ERROR, "Usage: pm <username> <message>");
-      write_client(sock, error_msg);
+      notify(sock, MSG_ERROR, "Usage: pm <username> <message>");
       return;
    }
 
@@ -508,17 +1172,13 @@ void handle_pm_command(int sock, Client *clients, Client sender, int client_coun
    const char *space = strchr(args, ' ');
    if (space == NULL)
    {
-      char error_msg[BUF_SIZE];
-      protocol_create_message(error_msg, BUF_SIZE, MSG_ERROR, "Usage: pm <username> <message>");
-      write_client(sock, error_msg);
+      notify(sock, MSG_ERROR, "Usage: pm <username> <message>");
       return;
    }
    size_t uname_len = (size_t)(space - args);
    if (uname_len == 0 || uname_len >= MAX_USERNAME_LEN)
    {
-      char error_msg[BUF_SIZE];
-      protocol_create_message(error_msg, BUF_SIZE, MSG_ERROR, "Invalid username");
-      write_client(sock, error_msg);
+      notify(sock, MSG_ERROR, "Invalid username");
       return;
    }
    strncpy(target, args, uname_len);
@@ -528,17 +1188,13 @@ void handle_pm_command(int sock, Client *clients, Client sender, int client_coun
 
    if (strlen(message) == 0)
    {
-      char error_msg[BUF_SIZE];
-      protocol_create_message(error_msg, BUF_SIZE, MSG_ERROR, "Message cannot be empty");
-      write_client(sock, error_msg);
+      notify(sock, MSG_ERROR, "Message cannot be empty");
       return;
    }
 
-   if (strcmp(target, sender.name) == 0)
+   if (strcmp(target, sender->name) == 0)
    {
-      char error_msg[BUF_SIZE];
-      protocol_create_message(error_msg, BUF_SIZE, MSG_ERROR, "Cannot send PM to yourself");
-      write_client(sock, error_msg);
+      notify(sock, MSG_ERROR, "Cannot send PM to yourself");
       return;
    }
 
@@ -555,31 +1211,16 @@ void handle_pm_command(int sock, Client *clients, Client sender, int client_coun
 
    if (target_index == -1)
    {
-      char error_buf[BUF_SIZE];
-      char tmp[BUF_SIZE];
-      snprintf(tmp, BUF_SIZE, "User '%s' not found", target);
-      protocol_create_message(error_buf, BUF_SIZE, MSG_ERROR, tmp);
-      write_client(sock, error_buf);
+      notify(sock, MSG_ERROR, "User '%s' not found", target);
       return;
    }
 
-   /* Build outgoing messages */
-   char to_target_payload[BUF_SIZE];
-   snprintf(to_target_payload, BUF_SIZE, "%s -> you: %s", sender.name, message);
-   char to_sender_payload[BUF_SIZE];
-   snprintf(to_sender_payload, BUF_SIZE, "you -> %s: %s", target, message);
-
-   char to_target_msg[BUF_SIZE];
-   protocol_create_message(to_target_msg, BUF_SIZE, MSG_PRIVATE_CHAT, to_target_payload);
-   char to_sender_msg[BUF_SIZE];
-   protocol_create_message(to_sender_msg, BUF_SIZE, MSG_PRIVATE_CHAT, to_sender_payload);
-
    /* Send to target and confirmation to sender */
-   write_client(clients[target_index].sock, to_target_msg);
-   write_client(sock, to_sender_msg);
+   notify(clients[target_index].sock, MSG_PRIVATE_CHAT, "%s -> you: %s", sender->name, message);
+   notify(sock, MSG_PRIVATE_CHAT, "you -> %s: %s", target, message);
 }
 
-void handle_challenge_command(int sock, Client *clients, int client_index, int client_count, const char *target_name)
+void handle_challenge_command(int sock, Client *clients, int client_index, int client_count, const char *target_name, ServerTimers *timers)
 {
    if (clients[client_index].status == CLIENT_IN_MATCH)
    {
@@ -598,9 +1239,9 @@ void handle_challenge_command(int sock, Client *clients, int client_index, int c
    }
 
    /* Check if already challenged this user */
-   for (int i = 0; i < clients[client_index].pending_challenge_to_count; i++)
+   for (int i = 0; i < clients[client_index].cold->pending_challenge_to_count; i++)
    {
-      if (strcmp(clients[client_index].pending_challenge_to[i], target_name) == 0)
+      if (strcmp(clients[client_index].cold->pending_challenge_to[i], target_name) == 0)
       {
          notify(sock, MSG_ERROR, "You already challenged %s", target_name);
          return;
@@ -608,7 +1249,7 @@ void handle_challenge_command(int sock, Client *clients, int client_index, int c
    }
 
    /* Check if at max pending challenges sent */
-   if (clients[client_index].pending_challenge_to_count >= MAX_CHALLENGES)
+   if (clients[client_index].cold->pending_challenge_to_count >= MAX_CHALLENGES)
    {
       notify(sock, MSG_ERROR, "Too many pending challenges");
       return;
@@ -620,6 +1261,11 @@ void handle_challenge_command(int sock, Client *clients, int client_index, int c
       notify(sock, MSG_ERROR, "User '%s' not found", target_name);
       return;
    }
+   if (clients[t].status == CLIENT_DISCONNECTED)
+   {
+      notify(sock, MSG_ERROR, "User '%s' is reconnecting", clients[t].name);
+      return;
+   }
    if (clients[t].status == CLIENT_IN_MATCH)
    {
       notify(sock, MSG_ERROR, "User '%s' is busy in a game", clients[t].name);
@@ -627,9 +1273,9 @@ void handle_challenge_command(int sock, Client *clients, int client_index, int c
    }
 
    /* Check if target already has pending challenge from this user */
-   for (int i = 0; i < clients[t].pending_challenge_from_count; i++)
+   for (int i = 0; i < clients[t].cold->pending_challenge_from_count; i++)
    {
-      if (strcmp(clients[t].pending_challenge_from[i], clients[client_index].name) == 0)
+      if (strcmp(clients[t].cold->pending_challenge_from[i], clients[client_index].name) == 0)
       {
          notify(sock, MSG_ERROR, "Challenge already pending to %s", target_name);
          return;
@@ -637,9 +1283,9 @@ void handle_challenge_command(int sock, Client *clients, int client_index, int c
    }
 
    /* Check if this user already has pending challenge to the target (prevent mutual challenges) */
-   for (int i = 0; i < clients[client_index].pending_challenge_from_count; i++)
+   for (int i = 0; i < clients[client_index].cold->pending_challenge_from_count; i++)
    {
-      if (strcmp(clients[client_index].pending_challenge_from[i], target_name) == 0)
+      if (strcmp(clients[client_index].cold->pending_challenge_from[i], target_name) == 0)
       {
          notify(sock, MSG_ERROR, "%s already challenged you; cannot send a reverse challenge", target_name);
          return;
@@ -647,31 +1293,34 @@ void handle_challenge_command(int sock, Client *clients, int client_index, int c
    }
 
    /* Check if target is at max pending challenges received */
-   if (clients[t].pending_challenge_from_count >= MAX_CHALLENGES)
+   if (clients[t].cold->pending_challenge_from_count >= MAX_CHALLENGES)
    {
       notify(sock, MSG_ERROR, "User '%s' has too many pending challenges", clients[t].name);
       return;
    }
 
-   /* Add challenge */
-   strncpy(clients[client_index].pending_challenge_to[clients[client_index].pending_challenge_to_count],
+   /* Add challenge (it expires after CHALLENGE_TIMEOUT_MS) */
+   static int next_challenge_id = 1;
+   int challenge_id = next_challenge_id++;
+   strncpy(clients[client_index].cold->pending_challenge_to[clients[client_index].cold->pending_challenge_to_count],
            clients[t].name, MAX_USERNAME_LEN - 1);
-   clients[client_index].pending_challenge_to[clients[client_index].pending_challenge_to_count][MAX_USERNAME_LEN - 1] = '\0';
-   clients[client_index].pending_challenge_to_count++;
+   clients[client_index].cold->pending_challenge_to[clients[client_index].cold->pending_challenge_to_count][MAX_USERNAME_LEN - 1] = '\0';
+   clients[client_index].cold->pending_challenge_to_id[clients[client_index].cold->pending_challenge_to_count] = challenge_id;
+   clients[client_index].cold->pending_challenge_to_count++;
+   timer_add(&timers->wheel, monotonic_ms(), CHALLENGE_TIMEOUT_MS, TIMER_CHALLENGE_EXPIRY, clients[client_index].id, challenge_id);
 
-   strncpy(clients[t].pending_challenge_from[clients[t].pending_challenge_from_count],
+   strncpy(clients[t].cold->pending_challenge_from[clients[t].cold->pending_challenge_from_count],
            clients[client_index].name, MAX_USERNAME_LEN - 1);
-   clients[t].pending_challenge_from[clients[t].pending_challenge_from_count][MAX_USERNAME_LEN - 1] = '\0';
-   clients[t].pending_challenge_from_count++;
+   clients[t].cold->pending_challenge_from[clients[t].cold->pending_challenge_from_count][MAX_USERNAME_LEN - 1] = '\0';
+   clients[t].cold->pending_challenge_from_count++;
 
-   notify(sock, MSG_INFO, "Challenge sent to %s", clients[t].name);
-   notify(clients[t].sock, MSG_CHALLENGE, "from %s", clients[client_index].name);
+   notify(sock, MSG_INFO, "Challenge sent to %s (%s rules)", clients[t].name, variant_info(clients[client_index].variant)->name);
+   notify(clients[t].sock, MSG_CHALLENGE, "from %s (%s rules)", clients[client_index].name, variant_info(clients[client_index].variant)->name);
 }
 
 void handle_cancel_command(int sock, Client *clients, int client_index, int client_count, const char *target_name)
 {
-   (void)client_count; // unused
-   if (clients[client_index].pending_challenge_to_count == 0)
+   if (clients[client_index].cold->pending_challenge_to_count == 0)
    {
       notify(sock, MSG_ERROR, "No pending challenges to cancel");
       return;
@@ -682,59 +1331,27 @@ void handle_cancel_command(int sock, Client *clients, int client_index, int clie
       return;
    }
 
-   /* Find the challenge to this target */
-   int found_idx = -1;
-   for (int i = 0; i < clients[client_index].pending_challenge_to_count; i++)
-   {
-      if (strcmp(clients[client_index].pending_challenge_to[i], target_name) == 0)
-      {
-         found_idx = i;
-         break;
-      }
-   }
-
-   if (found_idx == -1)
+   /* Remove from sender's pending_challenge_to */
+   if (!remove_challenge_to(&clients[client_index], target_name))
    {
       notify(sock, MSG_ERROR, "No pending challenge to %s", target_name);
       return;
    }
 
-   /* Find target user */
+   /* Remove from target's pending_challenge_from */
    int t = find_client_index_by_name(clients, client_count, target_name);
    if (t != -1)
    {
-      /* Remove from target's pending_challenge_from */
-      for (int i = 0; i < clients[t].pending_challenge_from_count; i++)
-      {
-         if (strcmp(clients[t].pending_challenge_from[i], clients[client_index].name) == 0)
-         {
-            /* Shift remaining elements */
-            for (int j = i; j < clients[t].pending_challenge_from_count - 1; j++)
-            {
-               strncpy(clients[t].pending_challenge_from[j],
-                       clients[t].pending_challenge_from[j + 1], MAX_USERNAME_LEN - 1);
-            }
-            clients[t].pending_challenge_from_count--;
-            break;
-         }
-      }
+      remove_challenge_from(&clients[t], clients[client_index].name);
       notify(clients[t].sock, MSG_CHALLENGE_RESPONSE, "%s cancelled the challenge", clients[client_index].name);
    }
 
-   /* Remove from sender's pending_challenge_to */
-   for (int j = found_idx; j < clients[client_index].pending_challenge_to_count - 1; j++)
-   {
-      strncpy(clients[client_index].pending_challenge_to[j],
-              clients[client_index].pending_challenge_to[j + 1], MAX_USERNAME_LEN - 1);
-   }
-   clients[client_index].pending_challenge_to_count--;
-
    notify(sock, MSG_INFO, "Challenge to %s cancelled", target_name);
 }
 
 void handle_refuse_command(int sock, Client *clients, int client_index, int client_count, const char *target_name)
 {
-   if (clients[client_index].pending_challenge_from_count == 0)
+   if (clients[client_index].cold->pending_challenge_from_count == 0)
    {
       notify(sock, MSG_ERROR, "You have no incoming challenges");
       return;
@@ -745,60 +1362,32 @@ void handle_refuse_command(int sock, Client *clients, int client_index, int clie
       return;
    }
 
-   /* Find the challenge from this target */
-   int found_idx = -1;
-   for (int i = 0; i < clients[client_index].pending_challenge_from_count; i++)
-   {
-      if (strcmp(clients[client_index].pending_challenge_from[i], target_name) == 0)
-      {
-         found_idx = i;
-         break;
-      }
-   }
-
-   if (found_idx == -1)
+   /* Remove from receiver's pending_challenge_from */
+   if (!remove_challenge_from(&clients[client_index], target_name))
    {
       notify(sock, MSG_ERROR, "No incoming challenge from %s", target_name);
       return;
    }
 
-   /* Find challenger */
+   /* Remove from challenger's pending_challenge_to */
    int s = find_client_index_by_name(clients, client_count, target_name);
    if (s != -1)
    {
-      /* Remove from challenger's pending_challenge_to */
-      for (int i = 0; i < clients[s].pending_challenge_to_count; i++)
-      {
-         if (strcmp(clients[s].pending_challenge_to[i], clients[client_index].name) == 0)
-         {
-            /* Shift remaining elements */
-            for (int j = i; j < clients[s].pending_challenge_to_count - 1; j++)
-            {
-               strncpy(clients[s].pending_challenge_to[j],
-                       clients[s].pending_challenge_to[j + 1], MAX_USERNAME_LEN - 1);
-            }
-            clients[s].pending_challenge_to_count--;
-            break;
-         }
-      }
-
+      remove_challenge_to(&clients[s], clients[client_index].name);
       notify(clients[s].sock, MSG_CHALLENGE_RESPONSE, "%s refused your challenge", clients[client_index].name);
    }
 
-   /* Remove from receiver's pending_challenge_from */
-   for (int j = found_idx; j < clients[client_index].pending_challenge_from_count - 1; j++)
-   {
-      strncpy(clients[client_index].pending_challenge_from[j],
-              clients[client_index].pending_challenge_from[j + 1], MAX_USERNAME_LEN - 1);
-   }
-   clients[client_index].pending_challenge_from_count--;
-
    notify(sock, MSG_INFO, "Challenge from %s refused", target_name);
 }
 
-void handle_accept_command(int sock, Client *clients, int client_index, int client_count, const char *target_name, Match *matches, int *match_count)
+void handle_accept_command(int sock, Client *clients, int client_index, int client_count, const char *target_name, Match *matches, int *match_count, ServerTimers *timers)
 {
-   if (clients[client_index].pending_challenge_from_count == 0)
+   if (clients[client_index].status != CLIENT_IDLE)
+   {
+      notify(sock, MSG_ERROR, "You are already in a game");
+      return;
+   }
+   if (clients[client_index].cold->pending_challenge_from_count == 0)
    {
       notify(sock, MSG_ERROR, "You have no incoming challenges");
       return;
@@ -809,18 +1398,8 @@ void handle_accept_command(int sock, Client *clients, int client_index, int clie
       return;
    }
 
-   /* Find the challenge from this target */
-   int found_idx = -1;
-   for (int i = 0; i < clients[client_index].pending_challenge_from_count; i++)
-   {
-      if (strcmp(clients[client_index].pending_challenge_from[i], target_name) == 0)
-      {
-         found_idx = i;
-         break;
-      }
-   }
-
-   if (found_idx == -1)
+   /* Remove from receiver's pending_challenge_from */
+   if (!remove_challenge_from(&clients[client_index], target_name))
    {
       notify(sock, MSG_ERROR, "No incoming challenge from %s", target_name);
       return;
@@ -830,117 +1409,44 @@ void handle_accept_command(int sock, Client *clients, int client_index, int clie
    if (s == -1)
    {
       notify(sock, MSG_ERROR, "Challenger disconnected");
-      /* Remove the stale challenge */
-      for (int j = found_idx; j < clients[client_index].pending_challenge_from_count - 1; j++)
-      {
-         strncpy(clients[client_index].pending_challenge_from[j],
-                 clients[client_index].pending_challenge_from[j + 1], MAX_USERNAME_LEN - 1);
-      }
-      clients[client_index].pending_challenge_from_count--;
       return;
    }
 
    /* Remove from challenger's pending_challenge_to */
-   for (int i = 0; i < clients[s].pending_challenge_to_count; i++)
-   {
-      if (strcmp(clients[s].pending_challenge_to[i], clients[client_index].name) == 0)
-      {
-         /* Shift remaining elements */
-         for (int j = i; j < clients[s].pending_challenge_to_count - 1; j++)
-         {
-            strncpy(clients[s].pending_challenge_to[j],
-                    clients[s].pending_challenge_to[j + 1], MAX_USERNAME_LEN - 1);
-         }
-         clients[s].pending_challenge_to_count--;
-         break;
-      }
-   }
-
-   /* Remove from receiver's pending_challenge_from */
-   for (int j = found_idx; j < clients[client_index].pending_challenge_from_count - 1; j++)
-   {
-      strncpy(clients[client_index].pending_challenge_from[j],
-              clients[client_index].pending_challenge_from[j + 1], MAX_USERNAME_LEN - 1);
-   }
-   clients[client_index].pending_challenge_from_count--;
+   remove_challenge_to(&clients[s], clients[client_index].name);
 
-   /* Automatically refuse all OTHER incoming challenges */
-   for (int i = 0; i < clients[client_index].pending_challenge_from_count; i++)
+   /* The challenger may have been paired by the matchmaker meanwhile */
+   if (clients[s].status == CLIENT_DISCONNECTED)
    {
-      int other_challenger_idx = find_client_index_by_name(clients, client_count, 
-                                                            clients[client_index].pending_challenge_from[i]);
-      if (other_challenger_idx != -1)
-      {
-         /* Remove from other challenger's pending_challenge_to */
-         for (int j = 0; j < clients[other_challenger_idx].pending_challenge_to_count; j++)
-         {
-            if (strcmp(clients[other_challenger_idx].pending_challenge_to[j], clients[client_index].name) == 0)
-            {
-               for (int k = j; k < clients[other_challenger_idx].pending_challenge_to_count - 1; k++)
-               {
-                  strncpy(clients[other_challenger_idx].pending_challenge_to[k],
-                          clients[other_challenger_idx].pending_challenge_to[k + 1], MAX_USERNAME_LEN - 1);
-               }
-               clients[other_challenger_idx].pending_challenge_to_count--;
-               break;
-            }
-         }
-         
-         /* Notify other challenger of refusal */
-         notify(clients[other_challenger_idx].sock, MSG_CHALLENGE_RESPONSE, 
-                "%s accepted another challenge and refused yours", clients[client_index].name);
-      }
+      notify(sock, MSG_ERROR, "%s is reconnecting", clients[s].name);
+      return;
    }
-   
-   /* Clear all remaining incoming challenges */
-   clients[client_index].pending_challenge_from_count = 0;
-
-   /* Automatically cancel all outgoing challenges */
-   for (int i = 0; i < clients[client_index].pending_challenge_to_count; i++)
+   if (clients[s].status != CLIENT_IDLE)
    {
-      int challenged_idx = find_client_index_by_name(clients, client_count, 
-                                                      clients[client_index].pending_challenge_to[i]);
-      if (challenged_idx != -1)
-      {
-         /* Remove from challenged player's pending_challenge_from */
-         for (int j = 0; j < clients[challenged_idx].pending_challenge_from_count; j++)
-         {
-            if (strcmp(clients[challenged_idx].pending_challenge_from[j], clients[client_index].name) == 0)
-            {
-               for (int k = j; k < clients[challenged_idx].pending_challenge_from_count - 1; k++)
-               {
-                  strncpy(clients[challenged_idx].pending_challenge_from[k],
-                          clients[challenged_idx].pending_challenge_from[k + 1], MAX_USERNAME_LEN - 1);
-               }
-               clients[challenged_idx].pending_challenge_from_count--;
-               break;
-            }
-         }
-         
-         /* Notify challenged player of cancellation */
-         notify(clients[challenged_idx].sock, MSG_CHALLENGE_RESPONSE, 
-                "%s cancelled their challenge (accepted another match)", clients[client_index].name);
-      }
+      notify(sock, MSG_ERROR, "%s is already in a game", clients[s].name);
+      return;
    }
-   
-   /* Clear all outgoing challenges */
-   clients[client_index].pending_challenge_to_count = 0;
-   clients[client_index].status = CLIENT_IDLE;
 
-   /* Start the match */
-   start_match(clients, s, client_index, matches, match_count);
+   /* Start the match; it withdraws every other challenge of both players */
+   // the challenger picked the rules
+   if (!start_match(clients, client_count, s, client_index, clients[s].variant, matches, match_count, timers))
+      notify(sock, MSG_ERROR, "No free match slot, try again later");
 }
 
 Match *get_match_by_id(int id, Match *matches, int match_count)
 {
-   if (id < 0 || id >= match_count)
+   if (id < 0)
       return NULL;
-   return &matches[id];
+   for (int i = 0; i < match_count; i++)
+   {
+      if (matches[i].id == id)
+         return &matches[i];
+   }
+   return NULL;
 }
 
-void handle_move_command(int sock, Client *clients, int client_index, int client_count, const char *pit_str, Match *matches, int match_count)
+void handle_move_command(int sock, Client *clients, int client_index, int client_count, const char *pit_str, Match *matches, int match_count, ServerTimers *timers)
 {
-   (void)client_count; // unused
    if (clients[client_index].status != CLIENT_IN_MATCH)
    {
       notify(sock, MSG_ERROR, "You are not in a game");
@@ -970,64 +1476,83 @@ void handle_move_command(int sock, Client *clients, int client_index, int client
       notify(sock, MSG_ERROR, "Not your turn");
       return;
    }
+   if (seat_index(m, 1 - logical_player) < 0)
+   {
+      notify(sock, MSG_ERROR, "Waiting for %s to resume the match", m->player_names[1 - logical_player]);
+      return;
+   }
    if (!is_valid_move(&m->board, pit))
    {
       notify(sock, MSG_ERROR, "Invalid move");
       return;
    }
+   // charge the mover's clock before the move lands
+   long long now = monotonic_ms();
+   char clocks[128] = "";
+   if (m->increment_ms >= 0)
+   {
+      timer_cancel(&timers->wheel, m->flag_timer);
+      m->clock_ms[logical_player] -= now - m->turn_started;
+      if (m->clock_ms[logical_player] < 0)
+         m->clock_ms[logical_player] = 0;
+      m->clock_ms[logical_player] += m->increment_ms;
+   }
+   Board before = m->board;
    make_move(&m->board, pit);
+   if (m->ply < MAX_MOVES)
+      m->moves[m->ply] = (unsigned char)pit;
+   m->ply++;
+   m->dirty = 1;
+   journal_record(m, JOURNAL_MOVE, pit);
    // swap turns
    clients[m->player1_index].is_turn = (m->board.current_player == 0);
    clients[m->player2_index].is_turn = (m->board.current_player == 1);
-   // notify move
-   notify(clients[m->player1_index].sock, MSG_MOVE, "%s played pit %d", clients[client_index].name, pit);
-   notify(clients[m->player2_index].sock, MSG_MOVE, "%s played pit %d", clients[client_index].name, pit);
-   // notify watchers too
-   for (int w = 0; w < m->watcher_count; w++)
-   {
-      notify(m->watchers[w], MSG_MOVE, "%s played pit %d", clients[client_index].name, pit);
-   }
-   broadcast_board(m, clients);
-   // record board after move for replay
-   if (m->replay_move_count < MAX_MOVES)
+   if (m->increment_ms >= 0)
    {
-      char snap[BUF_SIZE];
-      char move_info[64];
-      snprintf(move_info, sizeof(move_info), "(move by %s pit %d)", clients[client_index].name, pit);
-      render_board(&m->board, snap, sizeof(snap));
-      // prepend move info line
-      char combined[BUF_SIZE];
-      snprintf(combined, sizeof(combined), "%s\n%s", move_info, snap);
-      strncpy(m->replay_boards[m->replay_move_count], combined, BUF_SIZE - 1);
-      m->replay_boards[m->replay_move_count][BUF_SIZE - 1] = '\0';
-      m->replay_move_count++;
+      // " [" + the clocks + "]"
+      clocks[0] = ' ';
+      clocks[1] = '[';
+      format_clocks(m, clocks + 2, sizeof(clocks) - 3);
+      strcat(clocks, "]");
    }
+   // notify move
+   notify(seat_sock(m, clients, 0), MSG_MOVE, "%s played pit %d%s", clients[client_index].name, pit, clocks);
+   notify(seat_sock(m, clients, 1), MSG_MOVE, "%s played pit %d%s", clients[client_index].name, pit, clocks);
+   // notify watchers too
+   write_watchers(m, frame_printf(MSG_MOVE, "%s played pit %d%s", clients[client_index].name, pit, clocks));
+   broadcast_move(m, clients, client_count, pit, &before);
    if (is_game_over(&m->board))
    {
       // announce winner
       const char *winner = NULL;
       if (m->board.score[0] > m->board.score[1])
-         winner = clients[m->player1_index].name;
+         winner = m->player_names[0];
       else if (m->board.score[1] > m->board.score[0])
-         winner = clients[m->player2_index].name;
-      char payload[BUF_SIZE];
+         winner = m->player_names[1];
+      Frame over;
       if (winner)
-         snprintf(payload, sizeof(payload), "Game over. Winner: %s (%d-%d)", winner, m->board.score[0], m->board.score[1]);
+         over = frame_printf(MSG_GAME_OVER, "Game over. Winner: %s (%d-%d)", winner, m->board.score[0], m->board.score[1]);
       else
-         snprintf(payload, sizeof(payload), "Game over. Draw (%d-%d)", m->board.score[0], m->board.score[1]);
-      notify(clients[m->player1_index].sock, MSG_GAME_OVER, "%s", payload);
-      notify(clients[m->player2_index].sock, MSG_GAME_OVER, "%s", payload);
-      // update wins count
+         over = frame_printf(MSG_GAME_OVER, "Game over. Draw (%d-%d)", m->board.score[0], m->board.score[1]);
+      write_frame(seat_sock(m, clients, 0), over);
+      write_frame(seat_sock(m, clients, 1), over);
+      // update wins count and ratings
       if (m->board.score[0] > m->board.score[1])
       {
-         clients[m->player1_index].wins++;
+         record_result(clients, m->player1_index, m->player2_index, 0);
       }
       else if (m->board.score[1] > m->board.score[0])
       {
-         clients[m->player2_index].wins++;
+         record_result(clients, m->player2_index, m->player1_index, 0);
+      }
+      else
+      {
+         record_result(clients, m->player1_index, m->player2_index, 1);
       }
       end_match(m, clients);
+      return;
    }
+   start_turn_clock(m, timers, now);
 }
 
 void handle_quit_command(int sock, Client *clients, int client_index, int client_count, Match *matches, int match_count)
@@ -1045,25 +1570,19 @@ void handle_quit_command(int sock, Client *clients, int client_index, int client
       return;
    }
    int other = (client_index == m->player1_index) ? m->player2_index : m->player1_index;
-   notify(clients[other].sock, MSG_GAME_OVER, "%s quit the game", clients[client_index].name);
+   if (other >= 0)
+      notify(clients[other].sock, MSG_GAME_OVER, "%s quit the game", clients[client_index].name);
    notify(sock, MSG_GAME_OVER, "You quit the game");
    // count as win for the other player
-   clients[other].wins++;
+   record_result(clients, other, client_index, 0);
    // inform watchers
-   char msg_quit[BUF_SIZE];
-   char payload_quit[BUF_SIZE];
-   snprintf(payload_quit, sizeof(payload_quit), "%s quit the game", clients[client_index].name);
-   protocol_create_message(msg_quit, sizeof(msg_quit), MSG_GAME_OVER, payload_quit);
-   for (int w = 0; w < m->watcher_count; w++)
-   {
-      write_client(m->watchers[w], msg_quit);
-   }
+   write_watchers(m, frame_printf(MSG_GAME_OVER, "%s quit the game", clients[client_index].name));
    end_match(m, clients);
 }
 
 void handle_watch_command(int sock, Client *clients, int client_index, int client_count, const char *match_id_str, Match *matches, int match_count)
 {
-   (void)client_count; // unused directly
+   (void)client_count;
    if (!match_id_str || strlen(match_id_str) == 0)
    {
       notify(sock, MSG_ERROR, "Usage: watch <matchId>");
@@ -1072,45 +1591,196 @@ void handle_watch_command(int sock, Client *clients, int client_index, int clien
    // Prevent watching any match while playing in a match
    if (clients[client_index].status == CLIENT_IN_MATCH)
    {
-      notify(sock, MSG_ERROR, "You cannot watch matches while playing in a match");
+      notify(sock, MSG_ERROR, "You cannot watch matches while playing in a match");
+      return;
+   }
+   int id = atoi(match_id_str);
+   Match *m = get_match_by_id(id, matches, match_count);
+   if (!m)
+   {
+      notify(sock, MSG_ERROR, "Match %d not found", id);
+      return;
+   }
+   // Enforce privacy: if match is private, must be friend with at least one player (both acceptable)
+   if (!can_view_match(m, viewer_key(clients[client_index].name)))
+   {
+      notify(sock, MSG_ERROR, "This match is private; only friends can watch");
+      return;
+   }
+   Client *c = &clients[client_index];
+   if (watch_find(&c->cold->watching, m->id) == WATCH_NONE)
+   {
+      if (watch_add(&m->watchers, &c->cold->watching, m->id, c->id, viewer_key(c->name), sock, c->board_format) == WATCH_NONE)
+      {
+         notify(sock, MSG_ERROR, "Too many watchers");
+         return;
+      }
+      notify(sock, MSG_INFO, "Watching match #%d (%s vs %s)", m->id, m->player_names[0], m->player_names[1]);
+   }
+   // a keyframe for this watcher only (a second watch just resends it)
+   write_frame(sock, board_state_frame(m, -1));
+}
+
+static Book opening_book; // empty unless analysis_book_open() mapped one
+
+/* Clients waiting for a search of the analysis worker */
+typedef struct
+{
+   int client_id;
+   int match_id;
+   int ply;
+} AnalysisWaiter;
+
+static AnalysisWaiter analysis_waiters[ANALYSIS_MAX_WAITING];
+static int analysis_waiter_count = 0;
+static TimerId analysis_timer;
+
+int analysis_book_open(const char *path)
+{
+   return book_open(&opening_book, path);
+}
+
+void analysis_book_close(void)
+{
+   book_close(&opening_book);
+}
+
+// Answer an analyze request: `a` is the analysis of `board`, the position of `m` at `ply`
+static void send_analysis(int sock, const Match *m, int ply, const Board *board, const EngineAnalysis *a, const BookEntry *book)
+{
+   if (a->best_move < 0)
+   {
+      notify(sock, MSG_ANALYSIS, "#%d ply %d: game over (%d-%d)", m->id, ply, board->score[0], board->score[1]);
+      return;
+   }
+   // Evaluation from Player 1's side, in seeds (score_weight is per seed)
+   int score = board->current_player == 0 ? a->score : -a->score;
+   char eval[64];
+   if (score >= ENGINE_WIN / 2 || score <= -ENGINE_WIN / 2)
+      snprintf(eval, sizeof(eval), "%s wins", m->player_names[score > 0 ? 0 : 1]);
+   else
+   {
+      EngineParams params;
+      engine_default_params(&params);
+      snprintf(eval, sizeof(eval), "%+.2f", (double)score / params.score_weight);
+   }
+   char pv[ENGINE_MAX_DEPTH * 3 + 1] = "";
+   size_t off = 0;
+   for (int i = 0; i < a->pv_length; i++)
+      off += snprintf(pv + off, sizeof(pv) - off, i ? " %d" : "%d", a->pv[i]);
+   char source[96] = "";
+   if (book && book->games)
+      snprintf(source, sizeof(source), " (book: %s won %d%% of %u games from here)",
+               m->player_names[board->current_player], 100 * book->wins / book->games, (unsigned)book->games);
+   else if (book)
+      snprintf(source, sizeof(source), " (book)");
+   notify(sock, MSG_ANALYSIS, "#%d ply %d: best %d, eval %s (%s vs %s), depth %d%s, pv %s",
+          m->id, ply, a->best_move, eval, m->player_names[0], m->player_names[1], a->depth, source, pv);
+}
+
+void handle_analyze_command(int sock, Client *clients, int client_index, const char *match_id_str, Match *matches, int match_count, ServerTimers *timers)
+{
+   if (!match_id_str || strlen(match_id_str) == 0)
+   {
+      notify(sock, MSG_ERROR, "Usage: analyze <matchId>");
+      return;
+   }
+   int id = atoi(match_id_str);
+   Match *m = get_match_by_id(id, matches, match_count);
+   if (!m)
+   {
+      notify(sock, MSG_ERROR, "Match %d not found", id);
+      return;
+   }
+   // No engine help for the players of a running game
+   if (m->is_active && (client_index == m->player1_index || client_index == m->player2_index))
+   {
+      notify(sock, MSG_ERROR, "You cannot analyze your own match while it is running");
+      return;
+   }
+   // Same privacy rule as watch
+   if (!can_view_match(m, viewer_key(clients[client_index].name)))
+   {
+      notify(sock, MSG_ERROR, "This match is private; only friends can analyze it");
+      return;
+   }
+
+   // Search each position once; later requests for it are served from the
+   // cache, and opening positions from the book without searching at all
+   if (m->analysis_ply != m->ply)
+   {
+      m->analysis_book = book_analyze(&opening_book, &m->board, &m->analysis);
+      if (m->analysis_book)
+         m->analysis_ply = m->ply;
+   }
+   if (m->analysis_ply == m->ply)
+   {
+      send_analysis(sock, m, m->ply, &m->board, &m->analysis, m->analysis_book);
+      return;
+   }
+
+   // Otherwise the worker searches it and the answer comes from handle_analysis_timer
+   for (int i = 0; i < analysis_waiter_count; i++)
+   {
+      const AnalysisWaiter *w = &analysis_waiters[i];
+      if (w->client_id == clients[client_index].id && w->match_id == m->id && w->ply == m->ply)
+         return; // asked twice: answered once
+   }
+   int queued = analysis_waiter_count < ANALYSIS_MAX_WAITING ? analysis_submit(m->id, m->ply, &m->board) : 0;
+   if (queued < 0)
+   {
+      notify(sock, MSG_ERROR, "Analysis is unavailable");
       return;
    }
-   int id = atoi(match_id_str);
-   if (id < 0 || id >= match_count)
+   if (queued == 0)
    {
-      notify(sock, MSG_ERROR, "Match %d not found", id);
+      notify(sock, MSG_ERROR, "The analysis engine is busy, try again in a moment");
       return;
    }
-   Match *m = &matches[id];
-   // Enforce privacy: if match is private, must be friend with at least one player (both acceptable)
-   if (m->private_mode)
+   AnalysisWaiter *w = &analysis_waiters[analysis_waiter_count++];
+   w->client_id = clients[client_index].id;
+   w->match_id = m->id;
+   w->ply = m->ply;
+   if (!timer_pending(&timers->wheel, analysis_timer))
+      analysis_timer = timer_add(&timers->wheel, monotonic_ms(), ANALYSIS_POLL_MS, TIMER_ANALYSIS, 0, 0);
+}
+
+void handle_analysis_timer(Client *clients, int client_count, Match *matches, int match_count, ServerTimers *timers)
+{
+   int match_id, ply;
+   Board board;
+   EngineAnalysis result;
+   while (analysis_poll(&match_id, &ply, &board, &result))
    {
-      const char *watcher_name = clients[client_index].name;
-      int ok = is_friend(&clients[m->player1_index], watcher_name) || is_friend(&clients[m->player2_index], watcher_name);
-      if (!ok)
+      Match *m = get_match_by_id(match_id, matches, match_count);
+      if (m && m->ply == ply)
       {
-         notify(sock, MSG_ERROR, "This match is private; only friends can watch");
-         return;
+         m->analysis = result;
+         m->analysis_book = NULL;
+         m->analysis_ply = ply;
       }
-   }
-   // Add watcher if not already
-   for (int i = 0; i < m->watcher_count; i++)
-   {
-      if (m->watchers[i] == clients[client_index].sock)
+      // answer (and drop) the requests for this position
+      int kept = 0;
+      for (int i = 0; i < analysis_waiter_count; i++)
       {
-         // already watching
-         broadcast_board(m, clients); // resend board
-         return;
+         const AnalysisWaiter *w = &analysis_waiters[i];
+         if (w->match_id != match_id || w->ply != ply)
+         {
+            analysis_waiters[kept++] = *w;
+            continue;
+         }
+         int idx = find_client_index_by_id(clients, client_count, w->client_id);
+         if (idx == -1)
+            continue;
+         if (m)
+            send_analysis(clients[idx].sock, m, ply, &board, &result, NULL);
+         else // the match slot was reused meanwhile
+            notify(clients[idx].sock, MSG_ERROR, "Match %d not found", match_id);
       }
+      analysis_waiter_count = kept;
    }
-   if (m->watcher_count >= MAX_CLIENTS)
-   {
-      notify(sock, MSG_ERROR, "Too many watchers for this match");
-      return;
-   }
-   m->watchers[m->watcher_count++] = clients[client_index].sock;
-   notify(sock, MSG_INFO, "Watching match #%d (%s vs %s)", m->id, clients[m->player1_index].name, clients[m->player2_index].name);
-   broadcast_board(m, clients);
+   if (analysis_busy())
+      analysis_timer = timer_add(&timers->wheel, monotonic_ms(), ANALYSIS_POLL_MS, TIMER_ANALYSIS, 0, 0);
 }
 
 void handle_unwatch_command(int sock, Client *clients, int client_index, int client_count, const char *match_id_str, Match *matches, int match_count)
@@ -1122,33 +1792,19 @@ void handle_unwatch_command(int sock, Client *clients, int client_index, int cli
       return;
    }
    int id = atoi(match_id_str);
-   if (id < 0 || id >= match_count)
+   Match *m = get_match_by_id(id, matches, match_count);
+   if (!m)
    {
       notify(sock, MSG_ERROR, "Match %d not found", id);
       return;
    }
-   Match *m = &matches[id];
-   int sock_to_remove = clients[client_index].sock;
-   int found = 0;
-   for (int i = 0; i < m->watcher_count; i++)
-   {
-      if (m->watchers[i] == sock_to_remove)
-      {
-         // remove by shifting remaining
-         for (int j = i; j < m->watcher_count - 1; j++)
-         {
-            m->watchers[j] = m->watchers[j + 1];
-         }
-         m->watcher_count--;
-         found = 1;
-         break;
-      }
-   }
-   if (!found)
+   int entry = watch_find(&clients[client_index].cold->watching, m->id);
+   if (entry == WATCH_NONE)
    {
       notify(sock, MSG_ERROR, "You are not watching match %d", id);
       return;
    }
+   watch_remove(entry);
    notify(sock, MSG_INFO, "Stopped watching match #%d", id);
 }
 
@@ -1176,30 +1832,30 @@ void handle_addfriend_command(int sock, Client *clients, int client_index, int c
       notify(sock, MSG_INFO, "%s already in friends", target_name);
       return;
    }
-   if (clients[client_index].pending_friend_to[0] != '\0')
+   if (clients[client_index].cold->pending_friend_to[0] != '\0')
    {
-      notify(sock, MSG_ERROR, "You already sent a friend request to %s", clients[client_index].pending_friend_to);
+      notify(sock, MSG_ERROR, "You already sent a friend request to %s", clients[client_index].cold->pending_friend_to);
       return;
    }
-   if (clients[client_index].pending_friend_from[0] != '\0')
+   if (clients[client_index].cold->pending_friend_from[0] != '\0')
    {
-      notify(sock, MSG_ERROR, "You have an incoming friend request from %s", clients[client_index].pending_friend_from);
+      notify(sock, MSG_ERROR, "You have an incoming friend request from %s", clients[client_index].cold->pending_friend_from);
       return;
    }
-   if (clients[t].pending_friend_to[0] != '\0' && strcmp(clients[t].pending_friend_to, clients[client_index].name) == 0)
+   if (clients[t].cold->pending_friend_to[0] != '\0' && strcmp(clients[t].cold->pending_friend_to, clients[client_index].name) == 0)
    {
       notify(sock, MSG_ERROR, "You both sent requests; ask them to accept");
       return;
    }
-   strncpy(clients[client_index].pending_friend_to, clients[t].name, MAX_USERNAME_LEN - 1);
-   clients[client_index].pending_friend_to[MAX_USERNAME_LEN - 1] = 0;
-   strncpy(clients[t].pending_friend_from, clients[client_index].name, MAX_USERNAME_LEN - 1);
-   clients[t].pending_friend_from[MAX_USERNAME_LEN - 1] = 0;
+   strncpy(clients[client_index].cold->pending_friend_to, clients[t].name, MAX_USERNAME_LEN - 1);
+   clients[client_index].cold->pending_friend_to[MAX_USERNAME_LEN - 1] = 0;
+   strncpy(clients[t].cold->pending_friend_from, clients[client_index].name, MAX_USERNAME_LEN - 1);
+   clients[t].cold->pending_friend_from[MAX_USERNAME_LEN - 1] = 0;
    notify(sock, MSG_FRIEND_REQUEST, "Friend request sent to %s", clients[t].name);
    notify(clients[t].sock, MSG_FRIEND_REQUEST, "Friend request from %s (acceptfriend %s / refusefriend %s)", clients[client_index].name, clients[client_index].name, clients[client_index].name);
 }
 
-void handle_acceptfriend_command(int sock, Client *clients, int client_index, int client_count, const char *target_name)
+void handle_acceptfriend_command(int sock, Client *clients, int client_index, int client_count, const char *target_name, Match *matches, int match_count)
 {
    (void)client_count;
    if (!target_name || strlen(target_name) == 0)
@@ -1207,7 +1863,7 @@ void handle_acceptfriend_command(int sock, Client *clients, int client_index, in
       notify(sock, MSG_ERROR, "Usage: acceptfriend <username>");
       return;
    }
-   if (clients[client_index].pending_friend_from[0] == '\0' || strcmp(clients[client_index].pending_friend_from, target_name) != 0)
+   if (clients[client_index].cold->pending_friend_from[0] == '\0' || strcmp(clients[client_index].cold->pending_friend_from, target_name) != 0)
    {
       notify(sock, MSG_ERROR, "No pending friend request from %s", target_name);
       return;
@@ -1216,13 +1872,15 @@ void handle_acceptfriend_command(int sock, Client *clients, int client_index, in
    if (t == -1)
    {
       notify(sock, MSG_ERROR, "User '%s' disconnected", target_name);
-      clients[client_index].pending_friend_from[0] = 0;
+      clients[client_index].cold->pending_friend_from[0] = 0;
       return;
    }
-   add_friend(&clients[client_index], clients[t].name);
-   add_friend(&clients[t], clients[client_index].name);
-   clients[client_index].pending_friend_from[0] = '\0';
-   clients[t].pending_friend_to[0] = '\0';
+   if (add_friend(&clients[client_index], clients[t].name))
+      admit_new_friend(matches, match_count, client_index, clients[t].name);
+   if (add_friend(&clients[t], clients[client_index].name))
+      admit_new_friend(matches, match_count, t, clients[client_index].name);
+   clients[client_index].cold->pending_friend_from[0] = '\0';
+   clients[t].cold->pending_friend_to[0] = '\0';
    notify(sock, MSG_FRIEND_RESPONSE, "%s added to friends", clients[t].name);
    notify(clients[t].sock, MSG_FRIEND_RESPONSE, "%s accepted your friend request", clients[client_index].name);
 }
@@ -1235,7 +1893,7 @@ void handle_refusefriend_command(int sock, Client *clients, int client_index, in
       notify(sock, MSG_ERROR, "Usage: refusefriend <username>");
       return;
    }
-   if (clients[client_index].pending_friend_from[0] == '\0' || strcmp(clients[client_index].pending_friend_from, target_name) != 0)
+   if (clients[client_index].cold->pending_friend_from[0] == '\0' || strcmp(clients[client_index].cold->pending_friend_from, target_name) != 0)
    {
       notify(sock, MSG_ERROR, "No pending friend request from %s", target_name);
       return;
@@ -1244,9 +1902,9 @@ void handle_refusefriend_command(int sock, Client *clients, int client_index, in
    if (t != -1)
    {
       notify(clients[t].sock, MSG_FRIEND_RESPONSE, "%s refused your friend request", clients[client_index].name);
-      clients[t].pending_friend_to[0] = '\0';
+      clients[t].cold->pending_friend_to[0] = '\0';
    }
-   clients[client_index].pending_friend_from[0] = '\0';
+   clients[client_index].cold->pending_friend_from[0] = '\0';
    notify(sock, MSG_FRIEND_RESPONSE, "Friend request from %s refused", target_name);
 }
 
@@ -1258,15 +1916,7 @@ void handle_private_command(int sock, Client *clients, int client_index, int cli
       notify(sock, MSG_ERROR, "You are not in a match");
       return;
    }
-   Match *m = NULL;
-   for (int i = 0; i < match_count; i++)
-   {
-      if (matches[i].id == clients[client_index].current_match)
-      {
-         m = &matches[i];
-         break;
-      }
-   }
+   Match *m = get_match_by_id(clients[client_index].current_match, matches, match_count);
    if (!m)
    {
       notify(sock, MSG_ERROR, "Internal: match not found");
@@ -1280,56 +1930,37 @@ void handle_private_command(int sock, Client *clients, int client_index, int cli
    if (strcmp(arg, "on") == 0)
    {
       m->private_mode = 1;
+      m->dirty = 1;
+      journal_record(m, JOURNAL_PRIVATE, 1);
+      compute_viewers(m, clients);
       // Remove non-friend watchers
-      for (int i = 0; i < m->watcher_count;)
+      for (int h = m->watchers.head; h != WATCH_NONE;)
       {
-         int wsock = m->watchers[i];
-         // find client index by socket
-         int cindex = -1;
-         for (int k = 0; k < client_count; k++)
-         {
-            if (clients[k].sock == wsock)
-            {
-               cindex = k;
-               break;
-            }
-         }
-         if (cindex != -1)
+         const WatchEntry *w = watch_get(h);
+         int next = w->match_next;
+         if (!can_view_match(m, w->viewer_key))
          {
-            const char *wname = clients[cindex].name;
-            int ok = is_friend(&clients[m->player1_index], wname) || is_friend(&clients[m->player2_index], wname);
-            if (!ok)
-            {
-               // notify and remove
-               notify(wsock, MSG_INFO, "Removed from private match #%d", m->id);
-               for (int j = i; j < m->watcher_count - 1; j++)
-                  m->watchers[j] = m->watchers[j + 1];
-               m->watcher_count--;
-               continue; // don't increment i (shifted elements)
-            }
+            notify(w->sock, MSG_INFO, "Removed from private match #%d", m->id);
+            watch_remove(h);
          }
-         i++; // keep
+         h = next;
       }
       // Send acknowledgment to the player who set it to private
       notify(sock, MSG_INFO, "Match #%d now private", m->id);
       
-      // Determine opponent index
-      int opponent_index = (client_index == m->player1_index) ? m->player2_index : m->player1_index;
-      
       // Send notification to opponent
-      notify(clients[opponent_index].sock, MSG_INFO, "%s set the match to private", clients[client_index].name);
+      notify(seat_sock(m, clients, client_index == m->player1_index ? 1 : 0), MSG_INFO, "%s set the match to private", clients[client_index].name);
    }
    else if (strcmp(arg, "off") == 0)
    {
       m->private_mode = 0;
+      m->dirty = 1;
+      journal_record(m, JOURNAL_PRIVATE, 0);
       // Send acknowledgment to the player who set it to public
       notify(sock, MSG_INFO, "Match #%d now public", m->id);
       
-      // Determine opponent index
-      int opponent_index = (client_index == m->player1_index) ? m->player2_index : m->player1_index;
-      
       // Send notification to opponent
-      notify(clients[opponent_index].sock, MSG_INFO, "%s set the match to public", clients[client_index].name);
+      notify(seat_sock(m, clients, client_index == m->player1_index ? 1 : 0), MSG_INFO, "%s set the match to public", clients[client_index].name);
    }
    else
    {
@@ -1340,24 +1971,13 @@ void handle_private_command(int sock, Client *clients, int client_index, int cli
 void handle_friends_command(int sock, Client *clients, int client_index, int client_count)
 {
    (void)client_count;
-   char payload[BUF_SIZE];
-   if (clients[client_index].friend_count == 0)
-   {
-      snprintf(payload, sizeof(payload), "(no friends)");
-   }
-   else
+   Response r;
+   response_begin(&r, sock, MSG_FRIEND_LIST, ",");
+   for (int i = 0; i < clients[client_index].cold->friend_count; i++)
    {
-      payload[0] = '\0';
-      for (int i = 0; i < clients[client_index].friend_count; i++)
-      {
-         strncat(payload, clients[client_index].friends[i], sizeof(payload) - strlen(payload) - 1);
-         if (i < clients[client_index].friend_count - 1)
-            strncat(payload, ",", sizeof(payload) - strlen(payload) - 1);
-      }
+      response_append(&r, "%s", clients[client_index].cold->friends[i]);
    }
-   char msg[BUF_SIZE];
-   protocol_create_message(msg, sizeof(msg), MSG_FRIEND_LIST, payload);
-   write_client(sock, msg);
+   response_end(&r, "(no friends)");
 }
 
 void handle_ranking_command(int sock, Client *clients, int client_count)
@@ -1384,89 +2004,648 @@ void handle_ranking_command(int sock, Client *clients, int client_count)
          idx[best] = tmp;
       }
    }
-   char payload[BUF_SIZE];
-   payload[0] = '\0';
-   if (client_count == 0)
+   Response r;
+   response_begin(&r, sock, MSG_RANK_LIST, NULL);
+   for (int i = 0; i < client_count; i++)
+   {
+      response_append(&r, "%d. %s - %d\n", i + 1, clients[idx[i]].name, clients[idx[i]].wins);
+   }
+   response_end(&r, "(no players)");
+}
+
+void handle_board_command(int sock, Client *clients, int client_index, const char *format)
+{
+   if (format && strcmp(format, "data") == 0)
+   {
+      clients[client_index].board_format = BOARD_FORMAT_DATA;
+      watch_set_format(&clients[client_index].cold->watching, BOARD_FORMAT_DATA);
+      notify(sock, MSG_INFO, "Boards will be sent in full after every move");
+   }
+   else if (format && strcmp(format, "delta") == 0)
    {
-      snprintf(payload, sizeof(payload), "(no players)");
+      clients[client_index].board_format = BOARD_FORMAT_DELTA;
+      watch_set_format(&clients[client_index].cold->watching, BOARD_FORMAT_DELTA);
+      notify(sock, MSG_INFO, "Boards will be sent as a keyframe, then one delta per move");
    }
    else
    {
-      char line[128];
-      for (int i = 0; i < client_count; i++)
-      {
-         snprintf(line, sizeof(line), "%d. %s - %d\n", i + 1, clients[idx[i]].name, clients[idx[i]].wins);
-         strncat(payload, line, sizeof(payload) - strlen(payload) - 1);
-      }
+      notify(sock, MSG_ERROR, "Usage: board data|delta (boards are rendered by the client)");
    }
-   char msg[BUF_SIZE];
-   protocol_create_message(msg, sizeof(msg), MSG_RANK_LIST, payload);
-   write_client(sock, msg);
 }
 
-void handle_watchreplay_command(int sock, Client *clients, int client_index, int client_count, const char *match_id_str, Match *matches, int match_count)
+void handle_sync_command(int sock, Client *clients, int client_index, const char *match_id_str, Match *matches, int match_count)
 {
-   (void)clients;
-   (void)client_index;
-   (void)client_count;
-   if (!match_id_str || strlen(match_id_str) == 0)
+   const Client *c = &clients[client_index];
+   Match *m = NULL;
+   int seat = -1;
+   if (match_id_str && match_id_str[0])
+      m = get_match_by_id(atoi(match_id_str), matches, match_count);
+   else if (c->status == CLIENT_IN_MATCH)
+      m = get_match_by_id(c->current_match, matches, match_count);
+   if (!m || !m->is_active)
+   {
+      notify(sock, MSG_ERROR, "No running match to sync (usage: sync [matchId])");
+      return;
+   }
+   if (client_index == m->player1_index)
+      seat = 0;
+   else if (client_index == m->player2_index)
+      seat = 1;
+   write_frame(sock, board_state_frame(m, seat));
+}
+
+void handle_variant_command(int sock, Client *clients, int client_index, const char *name)
+{
+   char names[256];
+   variant_list(names, sizeof(names));
+   if (!name || strlen(name) == 0)
    {
-      notify(sock, MSG_ERROR, "Usage: watchreplay <matchId>");
+      notify(sock, MSG_INFO, "Your variant: %s (available: %s)", variant_info(clients[client_index].variant)->name, names);
       return;
    }
-   int id = atoi(match_id_str);
-   if (id < 0 || id >= match_count)
+   int v = variant_by_name(name);
+   if (v < 0)
+   {
+      notify(sock, MSG_ERROR, "Unknown variant '%s' (available: %s)", name, names);
+      return;
+   }
+   clients[client_index].variant = (Variant)v;
+   const VariantInfo *info = variant_info(v);
+   notify(sock, MSG_INFO, "Your challenges now use %s rules: %d seeds per pit, capture %d-%d, %d to win%s",
+          info->name, info->seeds, info->min_capture, info->max_capture, info->win_seeds,
+          info->grand_slam ? ", grand slam allowed" : "");
+}
+
+// Send the position a replay viewer is at: the board as data, then a caption
+static void send_replay_position(int sock, const ReplayViewer *v)
+{
+   const ReplayStream *st = v->stream;
+   BoardState state;
+   char board_data[BUF_SIZE];
+   state.match_id = st->match_id;
+   state.ply = v->ply;
+   state.seat = -1;
+   state.current_player = v->board.current_player;
+   memcpy(state.pits, v->board.pits, sizeof(state.pits));
+   state.score[0] = v->board.score[0];
+   state.score[1] = v->board.score[1];
+   memcpy(state.players, st->players, sizeof(state.players));
+   protocol_format_board(board_data, sizeof(board_data), &state);
+   if (v->ply == 0)
+   {
+      notify(sock, MSG_REPLAY_DATA, "%s\n(ply 0/%d)", board_data, st->move_count);
+      return;
+   }
+   int pit = st->moves[v->ply - 1];
+   const char *mover = st->players[pit < PITS_PER_PLAYER ? 0 : 1];
+   notify(sock, MSG_REPLAY_DATA, "%s\n(ply %d/%d, move by %s pit %d)", board_data, v->ply, st->move_count, mover, pit);
+}
+
+// Schedule the viewer's next move, replacing the pending one
+static void arm_replay_timer(ReplayViewer *v, ServerTimers *timers)
+{
+   timer_cancel(&timers->wheel, v->timer);
+   v->timer.index = 0;
+   if (v->ply < v->stream->move_count)
+      v->timer = timer_add(&timers->wheel, monotonic_ms(), v->interval_ms, TIMER_REPLAY_STEP, v->client_id, 0);
+}
+
+// Decoded stream of a match still in the table, or of an archived one
+static ReplayStream *open_replay_stream(int id, Match *matches, int match_count)
+{
+   Match *m = get_match_by_id(id, matches, match_count);
+   if (m)
+   {
+      int count = m->ply < MAX_MOVES ? m->ply : MAX_MOVES;
+      ReplayStream *st = replay_stream_find(id, count);
+      if (st)
+         return st;
+      ReplayGame g;
+      g.match_id = m->id;
+      g.variant = m->board.variant;
+      g.first_player = m->first_player;
+      g.move_count = count;
+      memcpy(g.players, m->player_names, sizeof(g.players));
+      return replay_stream_create(&g, m->moves);
+   }
+   ReplayGame g;
+   if (!replay_store_get(id, &g))
+      return NULL;
+   ReplayStream *st = replay_stream_find(id, g.move_count);
+   if (st)
+      return st;
+   uint8_t moves[MAX_MOVES];
+   for (int i = 0; i < g.move_count; i++)
+      moves[i] = (uint8_t)replay_move(&g, i);
+   return replay_stream_create(&g, moves);
+}
+
+void handle_watchreplay_command(int sock, Client *clients, int client_index, const char *args, Match *matches, int match_count, ServerTimers *timers)
+{
+   int id = -1;
+   int interval_ms = REPLAY_STEP_MS;
+   if (!args || sscanf(args, "%d %d", &id, &interval_ms) < 1)
+   {
+      notify(sock, MSG_ERROR, "Usage: watchreplay <matchId> [ms per move]");
+      return;
+   }
+   if (interval_ms < REPLAY_MIN_STEP_MS)
+      interval_ms = REPLAY_MIN_STEP_MS;
+   ReplayStream *st = open_replay_stream(id, matches, match_count);
+   if (!st)
    {
       notify(sock, MSG_ERROR, "Replay %d not found", id);
       return;
    }
-   Match *m = &matches[id];
-   if (m->replay_move_count == 0)
+   // a previous replay of this client ends here: its timer is cancelled, and
+   // attach takes the new stream before releasing the old one (which may be
+   // the same, held by this client alone)
+   ReplayViewer *v = replay_viewer_find(clients[client_index].id);
+   if (v)
+      timer_cancel(&timers->wheel, v->timer);
+   v = replay_viewer_attach(clients[client_index].id, st, interval_ms);
+   if (!v)
+   {
+      notify(sock, MSG_ERROR, "Too many replays running, try again later");
+      return;
+   }
+   notify(sock, MSG_INFO, "Starting replay for match #%d (%s vs %s) moves:%d, one every %d ms (seek <ply>, speed <ms>, stopreplay)",
+          st->match_id, st->players[0], st->players[1], st->move_count, interval_ms);
+   send_replay_position(sock, v);
+   arm_replay_timer(v, timers);
+}
+
+void handle_seek_command(int sock, Client *clients, int client_index, const char *arg, ServerTimers *timers)
+{
+   ReplayViewer *v = replay_viewer_find(clients[client_index].id);
+   if (!v)
    {
-      notify(sock, MSG_ERROR, "No replay data for match %d", id);
+      notify(sock, MSG_ERROR, "You are not watching a replay");
       return;
    }
-   notify(sock, MSG_INFO, "Starting replay for match #%d (%s vs %s) moves:%d", m->id, clients[m->player1_index].name, clients[m->player2_index].name, m->replay_move_count - 1);
-   for (int i = 0; i < m->replay_move_count; i++)
+   if (!arg || strlen(arg) == 0)
    {
-      char msg[BUF_SIZE];
-      protocol_create_message(msg, sizeof(msg), MSG_REPLAY_DATA, m->replay_boards[i]);
-      write_client(sock, msg);
+      notify(sock, MSG_ERROR, "Usage: seek <ply>");
+      return;
    }
+   replay_viewer_seek(v, atoi(arg));
+   send_replay_position(sock, v);
+   arm_replay_timer(v, timers);
 }
 
-void handle_games_command(int sock, Client *clients, Match *matches, int match_count)
+void handle_speed_command(int sock, Client *clients, int client_index, const char *arg, ServerTimers *timers)
 {
-   char list[BUF_SIZE];
-   list[0] = '\0';
-   if (match_count == 0)
+   ReplayViewer *v = replay_viewer_find(clients[client_index].id);
+   if (!v)
    {
-      protocol_create_message(list, BUF_SIZE, MSG_MATCH_LIST, "No games running");
-      write_client(sock, list);
+      notify(sock, MSG_ERROR, "You are not watching a replay");
       return;
    }
-   // Build a multi-line list: one game per line
-   char payload[BUF_SIZE];
-   payload[0] = '\0';
+   int interval_ms = arg ? atoi(arg) : 0;
+   if (interval_ms <= 0)
+   {
+      notify(sock, MSG_ERROR, "Usage: speed <ms per move>");
+      return;
+   }
+   v->interval_ms = interval_ms < REPLAY_MIN_STEP_MS ? REPLAY_MIN_STEP_MS : interval_ms;
+   arm_replay_timer(v, timers);
+   notify(sock, MSG_INFO, "Replay speed: one move every %d ms", v->interval_ms);
+}
+
+void handle_stopreplay_command(int sock, Client *clients, int client_index, ServerTimers *timers)
+{
+   if (!replay_viewer_find(clients[client_index].id))
+   {
+      notify(sock, MSG_ERROR, "You are not watching a replay");
+      return;
+   }
+   timer_cancel(&timers->wheel, replay_viewer_detach(clients[client_index].id));
+   notify(sock, MSG_INFO, "Replay stopped");
+}
+
+void handle_replay_timer(Client *clients, int client_count, ServerTimers *timers, int client_id)
+{
+   ReplayViewer *v = replay_viewer_find(client_id);
+   if (!v)
+      return;
+   v->timer.index = 0;
+   int i = find_client_index_by_id(clients, client_count, client_id);
+   if (i == -1)
+   {
+      replay_viewer_detach(client_id);
+      return;
+   }
+   if (!replay_viewer_step(v))
+      return;
+   send_replay_position(clients[i].sock, v);
+   if (v->ply == v->stream->move_count)
+      notify(clients[i].sock, MSG_INFO, "Replay of match #%d finished (seek <ply> to look again, stopreplay to close it)", v->stream->match_id);
+   arm_replay_timer(v, timers);
+}
+
+void replay_client_removed(int client_id)
+{
+   // a pending step finds no viewer (client ids are never reused)
+   replay_viewer_detach(client_id);
+}
+
+void handle_games_command(int sock, Client *clients, Match *matches, int match_count)
+{
+   (void)clients; // player names are kept in the match
+   // Stream a multi-line list: one game per line
+   Response r;
+   response_begin(&r, sock, MSG_MATCH_LIST, NULL);
    for (int i = 0; i < match_count; i++)
    {
       Match *m = &matches[i];
-      const char *p1 = clients[m->player1_index].name;
-      const char *p2 = clients[m->player2_index].name;
-      char line[256];
-      
+      if (m->id < 0)
+         continue; // slot lost at recovery
+      const char *p1 = m->player_names[0];
+      const char *p2 = m->player_names[1];
+
       if (m->is_active)
       {
          // Match is ongoing - show whose turn it is
          const char *turn = (m->board.current_player == 0) ? p1 : p2;
-         snprintf(line, sizeof(line), "#%d %s vs %s | turn: %s\n", m->id, p1, p2, turn);
+         response_append(&r, "#%d %s vs %s (%s) | turn: %s\n", m->id, p1, p2, variant_info(m->board.variant)->name, turn);
       }
       else
       {
-         snprintf(line, sizeof(line), "#%d %s vs %s | match ended\n", m->id, p1, p2);
+         response_append(&r, "#%d %s vs %s (%s) | match ended\n", m->id, p1, p2, variant_info(m->board.variant)->name);
+      }
+   }
+   response_end(&r, "No games running");
+}
+
+void handle_history_command(int sock, const char *args)
+{
+   char name[MAX_USERNAME_LEN];
+   int count = HISTORY_DEFAULT_GAMES;
+   if (!args || sscanf(args, "%31s %d", name, &count) < 1)
+   {
+      notify(sock, MSG_ERROR, "Usage: history <user> [count]");
+      return;
+   }
+   if (!history_enabled())
+   {
+      notify(sock, MSG_ERROR, "Match history is off (the server does not persist games)");
+      return;
+   }
+   if (count < 1)
+      count = 1;
+   if (count > HISTORY_MAX_GAMES)
+      count = HISTORY_MAX_GAMES;
+   HistoryRecord games[HISTORY_MAX_GAMES];
+   int n = history_query(name, 0, (int64_t)time(NULL), games, count);
+   // Stream a multi-line list: one game per line, newest first
+   Response r;
+   response_begin(&r, sock, MSG_HISTORY, NULL);
+   for (int i = 0; i < n; i++)
+   {
+      const HistoryRecord *g = &games[i];
+      time_t ended = (time_t)g->ended_at;
+      struct tm tm;
+      char when[32];
+      localtime_r(&ended, &tm);
+      strftime(when, sizeof(when), "%Y-%m-%d %H:%M", &tm);
+      const char *result = g->score[0] > g->score[1] ? "won" : (g->score[0] < g->score[1] ? "lost" : "drew");
+      response_append(&r, "#%d %s %s vs %s (%s): %s %d-%d\n", g->match_id, when, name, g->opponent,
+                      variant_info(g->variant)->name, result, g->score[0], g->score[1]);
+   }
+   response_end(&r, "No finished games");
+}
+
+void handle_queue_command(int sock, Client *clients, int client_index, int client_count, Matchmaker *mm)
+{
+   Client *c = &clients[client_index];
+   if (c->status == CLIENT_IN_MATCH)
+   {
+      notify(sock, MSG_ERROR, "You can't queue while in a game");
+      return;
+   }
+   if (c->queued)
+   {
+      notify(sock, MSG_INFO, "Already in the matchmaking queue");
+      return;
+   }
+   c->queued = 1;
+   c->queued_at = monotonic_ms();
+   int waiting = 0;
+   for (int i = 0; i < client_count; i++)
+   {
+      if (clients[i].queued)
+         waiting++;
+   }
+   notify(sock, MSG_INFO, "Joined matchmaking queue (rating %d, %d waiting, avg time-to-game %.1fs)",
+          c->rating, waiting, matchmaker_average_wait(mm) / 1000.0);
+}
+
+void handle_unqueue_command(int sock, Client *clients, int client_index)
+{
+   if (!clients[client_index].queued)
+   {
+      notify(sock, MSG_ERROR, "You are not in the matchmaking queue");
+      return;
+   }
+   clients[client_index].queued = 0;
+   notify(sock, MSG_INFO, "Left matchmaking queue");
+}
+
+void run_matchmaking(Matchmaker *mm, Client *clients, int client_count, Match *matches, int *match_count, ServerTimers *timers)
+{
+   QueueEntry entries[MAX_CLIENTS];
+   QueuePair pairs[MAX_CLIENTS / 2];
+   int n = 0;
+   for (int i = 0; i < client_count; i++)
+   {
+      if (clients[i].queued && clients[i].status == CLIENT_IDLE)
+      {
+         entries[n].id = i;
+         entries[n].rating = clients[i].rating;
+         entries[n].queued_at = clients[i].queued_at;
+         n++;
+      }
+   }
+   long long now = monotonic_ms();
+   int pair_count = matchmaker_pair(mm, entries, n, now, pairs);
+   for (int p = 0; p < pair_count; p++)
+   {
+      int a = pairs[p].a;
+      int b = pairs[p].b;
+      long long wait_a = now - clients[a].queued_at;
+      long long wait_b = now - clients[b].queued_at;
+      // standard rules unless both players picked the same variant
+      Variant variant = clients[a].variant == clients[b].variant ? clients[a].variant : VARIANT_ABAPA;
+      if (!start_match(clients, client_count, a, b, variant, matches, match_count, timers))
+      {
+         // no free match slot: leave both queued for the next batch
+         notify(clients[a].sock, MSG_ERROR, "No free match slot, still queued");
+         notify(clients[b].sock, MSG_ERROR, "No free match slot, still queued");
+         continue;
+      }
+      printf("%s[queue]%s Paired %s (%d) with %s (%d) after %.1fs / %.1fs\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET,
+             clients[a].name, clients[a].rating, clients[b].name, clients[b].rating, wait_a / 1000.0, wait_b / 1000.0);
+      matchmaker_record_wait(mm, wait_a, wait_b);
+   }
+}
+
+void handle_flag_timer(Client *clients, Match *matches, int match_count, int match_id, int ply)
+{
+   Match *m = get_match_by_id(match_id, matches, match_count);
+   // ignore timers of finished matches or of turns that were already played
+   if (!m || !m->is_active || m->ply != ply)
+      return;
+   int loser_side = m->board.current_player;
+   int loser = loser_side == 0 ? m->player1_index : m->player2_index;
+   int winner = loser_side == 0 ? m->player2_index : m->player1_index;
+   const char *loser_name = m->player_names[loser_side];
+   m->clock_ms[loser_side] = 0;
+   notify(seat_sock(m, clients, loser_side), MSG_GAME_OVER, "You ran out of time");
+   notify(seat_sock(m, clients, 1 - loser_side), MSG_GAME_OVER, "%s ran out of time, you win", loser_name);
+   write_watchers(m, frame_printf(MSG_GAME_OVER, "%s ran out of time", loser_name));
+   record_result(clients, winner, loser, 0);
+   end_match(m, clients);
+   printf("%s[clock]%s %s lost on time in match #%d\n", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, loser_name, m->id);
+}
+
+void handle_challenge_timer(Client *clients, int client_count, int challenger_id, int challenge_id)
+{
+   int c = find_client_index_by_id(clients, client_count, challenger_id);
+   if (c == -1)
+      return;
+   // the challenge may already have been accepted, refused or cancelled
+   int pos = -1;
+   for (int i = 0; i < clients[c].cold->pending_challenge_to_count; i++)
+   {
+      if (clients[c].cold->pending_challenge_to_id[i] == challenge_id)
+      {
+         pos = i;
+         break;
+      }
+   }
+   if (pos == -1)
+      return;
+   char target_name[MAX_USERNAME_LEN];
+   strncpy(target_name, clients[c].cold->pending_challenge_to[pos], MAX_USERNAME_LEN - 1);
+   target_name[MAX_USERNAME_LEN - 1] = '\0';
+   remove_challenge_to(&clients[c], target_name);
+   int t = find_client_index_by_name(clients, client_count, target_name);
+   if (t != -1)
+   {
+      remove_challenge_from(&clients[t], clients[c].name);
+      notify(clients[t].sock, MSG_CHALLENGE_RESPONSE, "Challenge from %s expired", clients[c].name);
+   }
+   notify(clients[c].sock, MSG_CHALLENGE_RESPONSE, "Challenge to %s expired", target_name);
+}
+
+int find_resumable_match(const char *name, Match *matches, int match_count)
+{
+   for (int i = 0; i < match_count; i++)
+   {
+      Match *m = &matches[i];
+      if (!m->is_active)
+         continue;
+      for (int seat = 0; seat < 2; seat++)
+      {
+         if (seat_index(m, seat) < 0 && strcmp(m->player_names[seat], name) == 0)
+            return m->id;
+      }
+   }
+   return -1;
+}
+
+void handle_resume_command(int sock, Client *clients, int client_index, int client_count, Match *matches, int match_count, ServerTimers *timers)
+{
+   Client *c = &clients[client_index];
+   if (c->status == CLIENT_IN_MATCH)
+   {
+      notify(sock, MSG_ERROR, "You are already in a game");
+      return;
+   }
+   int id = find_resumable_match(c->name, matches, match_count);
+   if (id < 0)
+   {
+      notify(sock, MSG_ERROR, "No interrupted match to resume");
+      return;
+   }
+   Match *m = get_match_by_id(id, matches, match_count);
+   int seat = (m->player1_index < 0 && strcmp(m->player_names[0], c->name) == 0) ? 0 : 1;
+   if (seat == 0)
+      m->player1_index = client_index;
+   else
+      m->player2_index = client_index;
+   c->status = CLIENT_IN_MATCH;
+   c->current_match = m->id;
+   c->queued = 0;
+   c->is_turn = (m->board.current_player == seat);
+   if (m->private_mode)
+      admit_friends(m, c); // a restored private match admits nobody until its players are back
+
+   int other = seat_index(m, 1 - seat);
+   if (other < 0)
+   {
+      notify(sock, MSG_INFO, "Resumed match #%d at ply %d; waiting for %s (seat held %ds from the restart)", m->id, m->ply,
+             m->player_names[1 - seat], RECONNECT_GRACE_MS / 1000);
+      broadcast_board(m, clients, client_count);
+      return;
+   }
+   notify(sock, MSG_INFO, "Resumed match #%d at ply %d vs %s", m->id, m->ply, m->player_names[1 - seat]);
+   notify(clients[other].sock, MSG_INFO, "%s is back, match #%d resumes", c->name, m->id);
+   broadcast_board(m, clients, client_count);
+   // the clock of the side to move restarts only once both players are back
+   start_turn_clock(m, timers, monotonic_ms());
+   printf("%s[persist]%s Match #%d resumed at ply %d\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET, m->id, m->ply);
+}
+
+void arm_restored_matches(Match *matches, int match_count, ServerTimers *timers)
+{
+   for (int i = 0; i < match_count; i++)
+   {
+      if (matches[i].is_active)
+         timer_add(&timers->wheel, monotonic_ms(), RECONNECT_GRACE_MS, TIMER_RESTORE_GRACE, matches[i].id, 0);
+   }
+}
+
+void handle_restore_timer(Client *clients, Match *matches, int match_count, int match_id)
+{
+   Match *m = get_match_by_id(match_id, matches, match_count);
+   if (!m || !m->is_active)
+      return;
+   int present[2] = {seat_index(m, 0) >= 0, seat_index(m, 1) >= 0};
+   if (present[0] && present[1])
+      return; // both players came back; a later drop has its own timer
+   if (!present[0] && !present[1])
+   {
+      write_watchers(m, frame_printf(MSG_GAME_OVER, "Neither player came back, match abandoned"));
+      printf("%s[persist]%s Match #%d abandoned, neither player came back\n", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, m->id);
+      end_match(m, clients);
+      return;
+   }
+   int absent = present[0] ? 1 : 0;
+   const char *absent_name = m->player_names[absent];
+   notify(seat_sock(m, clients, 1 - absent), MSG_GAME_OVER, "%s did not come back, you win", absent_name);
+   write_watchers(m, frame_printf(MSG_GAME_OVER, "%s did not come back", absent_name));
+   record_result(clients, seat_index(m, 1 - absent), seat_index(m, absent), 0);
+   printf("%s[persist]%s %s did not resume match #%d in time\n", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, absent_name, m->id);
+   end_match(m, clients);
+}
+
+void match_client_removed(Match *matches, int match_count, int removed)
+{
+   for (int i = 0; i < match_count; i++)
+   {
+      Match *m = &matches[i];
+      // the clients after `removed` moved down one slot
+      if (m->player1_index == removed)
+         m->player1_index = -1;
+      else if (m->player1_index > removed)
+         m->player1_index--;
+      if (m->player2_index == removed)
+         m->player2_index = -1;
+      else if (m->player2_index > removed)
+         m->player2_index--;
+   }
+}
+
+static void match_to_record(const Match *m, MatchRecord *r)
+{
+   memset(r, 0, sizeof(*r));
+   r->match_id = m->id;
+   r->slot = m->slot;
+   r->is_active = m->is_active;
+   r->private_mode = m->private_mode;
+   r->first_player = m->first_player;
+   r->ply = m->ply;
+   r->clock_ms[0] = m->clock_ms[0];
+   r->clock_ms[1] = m->clock_ms[1];
+   r->increment_ms = m->increment_ms;
+   r->board = m->board;
+   memcpy(r->players, m->player_names, sizeof(r->players));
+   memcpy(r->moves, m->moves, sizeof(r->moves));
+}
+
+void snapshot_matches(Match *matches, int match_count)
+{
+   static MatchRecord records[MAX_MATCHES];
+   if (!persist_enabled())
+      return;
+   int n = 0;
+   for (int i = 0; i < match_count; i++)
+   {
+      if (!matches[i].dirty)
+         continue;
+      match_to_record(&matches[i], &records[n++]);
+      matches[i].dirty = 0;
+   }
+   persist_snapshot(records, n);
+}
+
+int restore_matches(const char *dir, Match *matches, int max_matches)
+{
+   MatchRecord *records = malloc(sizeof(MatchRecord) * (size_t)max_matches);
+   if (!records)
+      return 0;
+   int count = persist_load(dir, records, max_matches);
+   next_match_id = replay_store_next_id();
+   for (int i = 0; i < count; i++)
+   {
+      const MatchRecord *r = &records[i];
+      Match *m = &matches[i];
+      memset(m, 0, sizeof(*m));
+      m->id = r->match_id;
+      m->slot = i;
+      m->player1_index = -1;
+      m->player2_index = -1;
+      m->analysis_ply = -1;
+      m->dirty = 1; // rewrite every slot (and so trim the journal) at the next snapshot
+      if (r->match_id < 0)
+      {
+         // slot lost (corrupt and not in the journal): free for the next match
+         strcpy(m->player_names[0], "?");
+         strcpy(m->player_names[1], "?");
+         init_board(&m->board);
+         continue;
+      }
+      if (r->match_id + 1 > next_match_id)
+         next_match_id = r->match_id + 1;
+      m->is_active = r->is_active;
+      m->private_mode = r->private_mode;
+      m->first_player = r->first_player;
+      m->ply = r->ply;
+      m->clock_ms[0] = r->clock_ms[0];
+      m->clock_ms[1] = r->clock_ms[1];
+      m->increment_ms = r->increment_ms;
+      m->board = r->board;
+      memcpy(m->player_names, r->players, sizeof(m->player_names));
+      m->player_names[0][MAX_USERNAME_LEN - 1] = '\0';
+      m->player_names[1][MAX_USERNAME_LEN - 1] = '\0';
+      memcpy(m->moves, r->moves, sizeof(m->moves));
+      // a match that ended just before the crash may not be archived yet
+      if (!m->is_active)
+      {
+         ReplayGame g;
+         m->archived = replay_store_get(m->id, &g);
+         if (!m->archived)
+         {
+            archive_match(m);
+            // nor recorded in the history (it ended about now)
+            history_add_game(m->id, m->board.variant, m->player_names, m->board.score, (int64_t)time(NULL));
+         }
       }
-      strncat(payload, line, sizeof(payload) - strlen(payload) - 1);
    }
-   protocol_create_message(list, BUF_SIZE, MSG_MATCH_LIST, payload);
-   write_client(sock, list);
+   free(records);
+   return count;
+}
+
+void compact_replays(Match *matches, int match_count)
+{
+   retry_archives(matches, match_count);
+   // every id from the oldest running match on may still be archived
+   int oldest = next_match_id;
+   for (int i = 0; i < match_count; i++)
+   {
+      if (matches[i].is_active && matches[i].id >= 0 && matches[i].id < oldest)
+         oldest = matches[i].id;
+   }
+   replay_store_compact(oldest);
 }
@@ -1,93 +1,284 @@
 #ifndef SERVER_H
 #define SERVER_H
+#include <stdint.h>
 #include "../utils/constants.h"
 #include "../core/awale.h"
 #include "../protocol/protocol.h"
+#include "../engine/engine.h"
+#include "../engine/book.h"
+#include "matchmaking.h"
+#include "../utils/timer_wheel.h"
+#include "rate_limit.h"
+#include "watchers.h"
+#include "analysis.h"
 
 typedef enum
 {
    CLIENT_IDLE,
    CLIENT_IN_MATCH,
-   CLIENT_DISCONNECTED
+   CLIENT_DISCONNECTED // connection lost, seat held until RECONNECT_GRACE_MS
 } ClientStatus;
 
+/* How a client wants to receive boards; either way they are data, which
+ * the client renders (src/client/render.c) */
+typedef enum
+{
+   BOARD_FORMAT_DELTA, // a MSG_BOARD_STATE keyframe, then MSG_BOARD_DELTA per move, the default
+   BOARD_FORMAT_DATA   // a full MSG_BOARD_STATE after every move
+} BoardFormat;
+
+/* Per-client state that only a few commands touch: the session token,
+ * profile, challenge and friend lists, and the input buffer. It lives in a
+ * pool of its own so that Client stays small: the scans of the clients
+ * array done every iteration (readiness, lookups by name or id, the
+ * matchmaking batch) read a few cache lines per client instead of ~13 KB,
+ * and remove_client only moves the small part. */
 typedef struct
 {
-   int sock;
-   char name[MAX_USERNAME_LEN];
+   char token[SESSION_TOKEN_LEN + 1]; // presented on reconnect to take the session back
    char bio[MAX_BIO_LEN];
-   ClientStatus status; // CLIENT_IDLE, CLIENT_IN_MATCH
-   int current_match;   // match id, -1 if not in a match
    // Challenge state - support multiple challenges
    char pending_challenge_to[MAX_CHALLENGES][MAX_USERNAME_LEN];   // usernames we challenged
+   int pending_challenge_to_id[MAX_CHALLENGES];                   // id of each sent challenge (for expiry)
    int pending_challenge_to_count;                                // number of pending challenges sent
    char pending_challenge_from[MAX_CHALLENGES][MAX_USERNAME_LEN]; // usernames who challenged us
    int pending_challenge_from_count;                              // number of pending challenges received
-   int is_turn;                                   // for in-game: 1 if it's this client's turn, else 0
    // Friends
    char friends[MAX_FRIENDS][MAX_USERNAME_LEN];
    int friend_count;
    char pending_friend_to[MAX_USERNAME_LEN];
    char pending_friend_from[MAX_USERNAME_LEN];
-   int wins; // number of games won (session)
+   RateLimits limits; // flood protection
+   WatchList watching; // matches this client watches (see watchers.h)
+   // Received bytes not yet split into '\n' terminated commands (length in Client)
+   char input[BUF_SIZE];
+} ClientCold;
+
+typedef struct
+{
+   int id;   // unique per connection, never reused (safe against fd reuse)
+   int sock; // -1 while the connection is lost and the seat is held
+   ClientStatus status; // CLIENT_IDLE, CLIENT_IN_MATCH, CLIENT_DISCONNECTED
+   int current_match;   // match id, -1 if not in a match
+   int is_turn;         // for in-game: 1 if it's this client's turn, else 0
+   size_t input_len;    // bytes buffered in cold->input
+   int reads_paused;    // over its rate limit: not read until TIMER_RESUME_READS
+   char name[MAX_USERNAME_LEN];
+   int drops;  // connections lost so far (tags grace timers)
+   int wins;   // number of games won (session)
+   int rating; // Elo rating used by matchmaking
+   // Matchmaking queue
+   int queued;          // 1 while waiting in the matchmaking queue
+   long long queued_at; // monotonic ms when the client joined the queue
+   long long last_activity; // monotonic ms of the last command (idle reaping)
+   BoardFormat board_format;
+   Variant variant; // rules of the matches this client challenges to
+   int room;             // chat room (index in the room table)
+   uint64_t chat_cursor; // next entry of the room's broadcast log this client should get
+   ClientCold *cold;     // owned, from client_cold_alloc()
 } Client;
 
 typedef struct
 {
-   int id;
-   int player1_index; // index in clients array
-   int player2_index; // index in clients array
+   int id;   // unique over the server's history (archived replays are found by it)
+   int slot; // index in the match table, reused once the match is archived
+   int player1_index; // index in clients array, -1 while the seat is vacant
+   int player2_index; // (a restored match waiting for its player to resume)
+   char player_names[2][MAX_USERNAME_LEN];
    Board board;
-   int watchers[MAX_CLIENTS]; // sockets of watchers
-   int watcher_count;
+   WatchList watchers; // its watchers (see watchers.h)
    int private_mode; // if 1 only friends can watch
+   ViewerSet viewers; // who may watch while private_mode is set (see watchers.h)
    bool is_active; // if false, match has ended
-   // replay data
-   int replay_move_count;
-   char replay_boards[MAX_MOVES][BUF_SIZE]; // board snapshot after each move
+   int archived;   // ended and saved in the replay store (the slot can be reused)
+   int archive_failures; // failed attempts to save it, retried up to ARCHIVE_MAX_RETRIES
+   int ply;        // moves played so far
+   int first_player;               // side that moved first
+   unsigned char moves[MAX_MOVES]; // pits played, in order (snapshots, recovery)
+   int dirty;                      // changed since the last snapshot
+   // chess-style clock (increment_ms < 0 when the match is untimed)
+   long long clock_ms[2];  // remaining time of player 1 / player 2
+   long long increment_ms; // added to the mover's clock after each move
+   long long turn_started; // monotonic ms when the side to move got the turn
+   TimerId flag_timer;     // fires when the side to move runs out of time
+   // analyze cache: one search per position however many clients ask
+   int analysis_ply; // ply of the cached analysis, -1 if none
+   EngineAnalysis analysis;
+   const BookEntry *analysis_book; // opening book entry it came from, NULL if searched
 } Match;
 
+/* Kinds of TimerEvent scheduled on the server's timer wheel */
+typedef enum
+{
+   TIMER_MATCH_FLAG,       // a = match id, b = ply when the turn started
+   TIMER_CHALLENGE_EXPIRY, // a = challenger client id, b = challenge id
+   TIMER_IDLE,             // a = client id
+   TIMER_MATCHMAKING,      // periodic matchmaking batch
+   TIMER_SNAPSHOT,         // periodic snapshot of the matches that changed
+   TIMER_RECONNECT,        // a = client id, b = its drop count: grace period over
+   TIMER_REPLAY_COMPACT,   // periodic compaction of the sealed replay segments
+   TIMER_REPLAY_STEP,      // a = client id: next move of the replay it watches
+   TIMER_RESUME_READS,     // a = client id: its rate limit has a token again
+   TIMER_METRICS,          // periodic log of the server metrics
+   TIMER_ANALYSIS,         // the analysis worker may have finished a search
+   TIMER_RESTORE_GRACE     // a = match id: its players had RECONNECT_GRACE_MS to resume it
+} TimerKind;
+
+typedef struct
+{
+   TimerWheel wheel;
+   long long base_ms;      // initial clock of each player (0: untimed matches)
+   long long increment_ms; // per-move increment
+} ServerTimers;
+
+/* A message in its final wire form: [size_t length]["TYPE|payload"].
+ * Frames are built in the per-iteration scratch arena and are valid until
+ * server_scratch_reset(). */
+typedef struct
+{
+   char *data;
+   size_t len;
+} Frame;
+
+/* Streaming response builder: entries are appended at a tracked offset into
+ * an already framed "TYPE|" buffer; when the next entry does not fit, the
+ * current frame is sent and the entry starts a new one. */
+typedef struct
+{
+   int sock;
+   MessageType type;
+   const char *sep;    // inserted between entries of the same frame (may be NULL)
+   size_t header_len;  // length prefix + "TYPE|"
+   size_t off;         // current write offset in buf
+   int entries;        // entries in the current frame
+   int frames;         // frames already sent
+   char *buf;          // scratch arena buffer of cap bytes
+   size_t cap;
+} Response;
 
 int init_connection(int port);
 void end_connection(int sock);
-int read_from_client(int sock, char *buffer);
+int read_client_input(Client *client);
+int has_client_command(const Client *client);
+int next_client_command(Client *client, char *command, size_t size);
 void write_client(int sock, const char *buffer);
-void send_message_to_all_clients(Client *clients, Client client, int client_count, const char *buffer, char from_server);
+void write_frame(int sock, Frame f);
+Frame frame_printf(MessageType type, const char *fmt, ...);
+/* Release every scratch buffer; called once per event loop iteration */
+void server_scratch_reset(void);
+/* Chat goes through the broadcast log of the client's room (see rooms.h
+ * and broadcast.h): messages are framed once and every member reads them
+ * at its own pace through its cursor. A new client starts at the head of
+ * the lobby; deliver_chat() sends each client what its socket can take and
+ * returns 1 while some still wait for their socket to become writable.
+ * Server notices (from_server) go to every room. */
+void send_message_to_all_clients(const Client *sender, const char *buffer, char from_server);
+void chat_join(Client *c);
+void chat_leave(Client *c);
+int chat_pending(const Client *c);
+int deliver_chat(Client *clients, int client_count);
+/* Cold part of a new client, zeroed; NULL once MAX_CLIENTS are in use */
+ClientCold *client_cold_alloc(void);
+void client_cold_free(ClientCold *cold);
+/* Drop clients[to_remove] (it leaves its room and stops watching, its cold
+ * part is freed) and compact the array */
 void remove_client(Client *clients, int to_remove, int *client_count);
 void clear_clients(Client *clients, int client_count);
 char *get_server_ip(void);
 
 /* Helper functions for client and match management */
 int find_client_index_by_name(Client *clients, int client_count, const char *name);
+int find_client_index_by_id(Client *clients, int client_count, int id);
+int remove_challenge_to(Client *c, const char *target_name);
+int remove_challenge_from(Client *c, const char *challenger_name);
 int is_friend(const Client *c, const char *username);
 int add_friend(Client *c, const char *username);
 void notify(int sock, MessageType type, const char *fmt, ...);
-void broadcast_board(Match *m, Client *clients);
+void response_begin(Response *r, int sock, MessageType type, const char *sep);
+void response_append(Response *r, const char *fmt, ...);
+void response_end(Response *r, const char *empty_text);
+/* Full board (a keyframe for delta clients) to both players and the watchers */
+void broadcast_board(Match *m, Client *clients, int client_count);
+/* Board after the move `pit` played from `before`: delta clients only get
+ * what changed, the others the full board */
+void broadcast_move(Match *m, Client *clients, int client_count, int pit, const Board *before);
+/* Send the current board of the client's match to that client only */
+void send_board(Match *m, Client *clients, int client_index);
+/* Random hex session token of SESSION_TOKEN_LEN characters */
+void make_session_token(char *out);
 void end_match(Match *m, Client *clients);
-Match *start_match(Client *clients, int a, int b, Match *matches, int *match_count);
+void record_result(Client *clients, int winner_index, int loser_index, int draw);
+Match *start_match(Client *clients, int client_count, int a, int b, Variant variant, Match *matches, int *match_count, ServerTimers *timers);
 Match *get_match_by_id(int id, Match *matches, int match_count);
-void handle_list_command(int sock, Client *clients, int client_count);
-void handle_message_command(int sock, Client *clients, Client sender, int client_count, const char *message);
+void handle_list_command(int sock, Client *clients, int client_index, int client_count);
+void handle_message_command(int sock, const Client *sender, const char *message);
+void handle_join_command(int sock, Client *clients, int client_index, const char *args);
+void handle_rooms_command(int sock);
+/* "history <user> [count]": the user's last finished games, newest first */
+void handle_history_command(int sock, const char *args);
 void handle_bio_command(int sock, Client *clients, int client_index, const char *bio_text);
 void handle_getbio_command(int sock, Client *clients, int client_count, const char *username);
-void handle_pm_command(int sock, Client *clients, Client sender, int client_count, const char *args);
+void handle_pm_command(int sock, Client *clients, const Client *sender, int client_count, const char *args);
 int is_username_unique(Client *clients, int client_count, const char *username);
 /* Challenge & Game handlers */
-void handle_challenge_command(int sock, Client *clients, int client_index, int client_count, const char *target_name);
-void handle_accept_command(int sock, Client *clients, int client_index, int client_count, const char *target_name, Match *matches, int *match_count);
+void handle_challenge_command(int sock, Client *clients, int client_index, int client_count, const char *target_name, ServerTimers *timers);
+void handle_accept_command(int sock, Client *clients, int client_index, int client_count, const char *target_name, Match *matches, int *match_count, ServerTimers *timers);
 void handle_refuse_command(int sock, Client *clients, int client_index, int client_count, const char *target_name);
 void handle_cancel_command(int sock, Client *clients, int client_index, int client_count, const char *target_name);
-void handle_move_command(int sock, Client *clients, int client_index, int client_count, const char *pit_str, Match *matches, int match_count);
+void handle_move_command(int sock, Client *clients, int client_index, int client_count, const char *pit_str, Match *matches, int match_count, ServerTimers *timers);
 void handle_quit_command(int sock, Client *clients, int client_index, int client_count, Match *matches, int match_count);
 void handle_games_command(int sock, Client *clients, Match *matches, int match_count);
 void handle_watch_command(int sock, Client *clients, int client_index, int client_count, const char *match_id_str, Match *matches, int match_count);
+/* Answered at once from the cache or the book, otherwise once the analysis
+ * worker has searched the position (see analysis.h) */
+void handle_analyze_command(int sock, Client *clients, int client_index, const char *match_id_str, Match *matches, int match_count, ServerTimers *timers);
+/* Map the opening book analyze answers from (see engine/book.h); returns 0,
+ * or -1 with errno set and analysis searching every position */
+int analysis_book_open(const char *path);
+void analysis_book_close(void);
 void handle_unwatch_command(int sock, Client *clients, int client_index, int client_count, const char *match_id_str, Match *matches, int match_count);
 void handle_addfriend_command(int sock, Client *clients, int client_index, int client_count, const char *target_name);
-void handle_acceptfriend_command(int sock, Client *clients, int client_index, int client_count, const char *target_name);
+void handle_acceptfriend_command(int sock, Client *clients, int client_index, int client_count, const char *target_name, Match *matches, int match_count);
 void handle_refusefriend_command(int sock, Client *clients, int client_index, int client_count, const char *target_name);
 void handle_private_command(int sock, Client *clients, int client_index, int client_count, const char *arg, Match *matches, int match_count);
 void handle_friends_command(int sock, Client *clients, int client_index, int client_count);
 void handle_ranking_command(int sock, Client *clients, int client_count);
-void handle_watchreplay_command(int sock, Client *clients, int client_index, int client_count, const char *match_id_str, Match *matches, int match_count);
+void handle_board_command(int sock, Client *clients, int client_index, const char *format);
+void handle_sync_command(int sock, Client *clients, int client_index, const char *match_id_str, Match *matches, int match_count);
+void handle_variant_command(int sock, Client *clients, int client_index, const char *name);
+void handle_resume_command(int sock, Client *clients, int client_index, int client_count, Match *matches, int match_count, ServerTimers *timers);
+/* Replays: streamed one position at a time on the timer wheel */
+void handle_watchreplay_command(int sock, Client *clients, int client_index, const char *args, Match *matches, int match_count, ServerTimers *timers);
+void handle_seek_command(int sock, Client *clients, int client_index, const char *arg, ServerTimers *timers);
+void handle_speed_command(int sock, Client *clients, int client_index, const char *arg, ServerTimers *timers);
+void handle_stopreplay_command(int sock, Client *clients, int client_index, ServerTimers *timers);
+void handle_replay_timer(Client *clients, int client_count, ServerTimers *timers, int client_id);
+/* End the replay of a client that is going away */
+void replay_client_removed(int client_id);
+/* Matchmaking */
+void handle_queue_command(int sock, Client *clients, int client_index, int client_count, Matchmaker *mm);
+void handle_unqueue_command(int sock, Client *clients, int client_index);
+void run_matchmaking(Matchmaker *mm, Client *clients, int client_count, Match *matches, int *match_count, ServerTimers *timers);
+/* Persistence: keep match player indices valid after remove_client,
+ * queue a snapshot of the matches changed since the last one, and rebuild
+ * the matches saved in `dir` (returns the restored match count) */
+void match_client_removed(Match *matches, int match_count, int removed);
+void snapshot_matches(Match *matches, int match_count);
+int restore_matches(const char *dir, Match *matches, int max_matches);
+/* Retry archiving the finished matches the replay store refused, then hand
+ * the replay segments no running match can still end in to the background
+ * compactor */
+void compact_replays(Match *matches, int match_count);
+/* A restored match waits RECONNECT_GRACE_MS for its players: then the
+ * one who did not resume it forfeits, or it is abandoned if neither did */
+void arm_restored_matches(Match *matches, int match_count, ServerTimers *timers);
+void handle_restore_timer(Client *clients, Match *matches, int match_count, int match_id);
+/* Id of the running match with a vacant seat for `name`, -1 if none */
+int find_resumable_match(const char *name, Match *matches, int match_count);
+/* Timer events */
+void handle_flag_timer(Client *clients, Match *matches, int match_count, int match_id, int ply);
+void handle_challenge_timer(Client *clients, int client_count, int challenger_id, int challenge_id);
+/* Collect finished analysis searches and answer the clients waiting for them */
+void handle_analysis_timer(Client *clients, int client_count, Match *matches, int match_count, ServerTimers *timers);
 
 #endif /* guard */
@@ -0,0 +1,152 @@
+#include <string.h>
+#include "watchers.h"
+
+// Handle 0 is WATCH_NONE; free entries are chained through match_next
+static WatchEntry pool[MAX_WATCHES + 1];
+static int free_head = WATCH_NONE;
+static int pool_ready = 0;
+
+static int entry_alloc(void)
+{
+   if (!pool_ready)
+   {
+      for (int h = MAX_WATCHES; h >= 1; h--)
+      {
+         pool[h].match_next = free_head;
+         free_head = h;
+      }
+      pool_ready = 1;
+   }
+   int h = free_head;
+   if (h != WATCH_NONE)
+      free_head = pool[h].match_next;
+   return h;
+}
+
+WatchEntry *watch_get(int handle)
+{
+   return &pool[handle];
+}
+
+int watch_add(WatchList *match_list, WatchList *client_list, int match_id, int client_id, uint64_t viewer_key, int sock, int board_format)
+{
+   int h = entry_alloc();
+   if (h == WATCH_NONE)
+      return WATCH_NONE;
+   WatchEntry *e = &pool[h];
+   e->match_id = match_id;
+   e->client_id = client_id;
+   e->viewer_key = viewer_key;
+   e->sock = sock;
+   e->board_format = board_format;
+   e->match_list = match_list;
+   e->client_list = client_list;
+   // pushed at the front of both lists
+   e->match_prev = WATCH_NONE;
+   e->match_next = match_list->head;
+   if (match_list->head != WATCH_NONE)
+      pool[match_list->head].match_prev = h;
+   match_list->head = h;
+   match_list->count++;
+   e->client_prev = WATCH_NONE;
+   e->client_next = client_list->head;
+   if (client_list->head != WATCH_NONE)
+      pool[client_list->head].client_prev = h;
+   client_list->head = h;
+   client_list->count++;
+   return h;
+}
+
+void watch_remove(int handle)
+{
+   WatchEntry *e = &pool[handle];
+   if (e->match_prev != WATCH_NONE)
+      pool[e->match_prev].match_next = e->match_next;
+   else
+      e->match_list->head = e->match_next;
+   if (e->match_next != WATCH_NONE)
+      pool[e->match_next].match_prev = e->match_prev;
+   e->match_list->count--;
+   if (e->client_prev != WATCH_NONE)
+      pool[e->client_prev].client_next = e->client_next;
+   else
+      e->client_list->head = e->client_next;
+   if (e->client_next != WATCH_NONE)
+      pool[e->client_next].client_prev = e->client_prev;
+   e->client_list->count--;
+   memset(e, 0, sizeof(*e));
+   e->match_next = free_head;
+   free_head = handle;
+}
+
+void watch_clear(WatchList *list)
+{
+   while (list->head != WATCH_NONE)
+      watch_remove(list->head);
+}
+
+int watch_find(const WatchList *client_list, int match_id)
+{
+   for (int h = client_list->head; h != WATCH_NONE; h = pool[h].client_next)
+   {
+      if (pool[h].match_id == match_id)
+         return h;
+   }
+   return WATCH_NONE;
+}
+
+void watch_set_sock(const WatchList *client_list, int sock)
+{
+   for (int h = client_list->head; h != WATCH_NONE; h = pool[h].client_next)
+      pool[h].sock = sock;
+}
+
+void watch_set_format(const WatchList *client_list, int board_format)
+{
+   for (int h = client_list->head; h != WATCH_NONE; h = pool[h].client_next)
+      pool[h].board_format = board_format;
+}
+
+uint64_t viewer_key(const char *name)
+{
+   // FNV-1a
+   uint64_t h = 14695981039346656037ULL;
+   for (const unsigned char *p = (const unsigned char *)name; *p; p++)
+   {
+      h ^= *p;
+      h *= 1099511628211ULL;
+   }
+   return h ? h : 1;
+}
+
+void viewers_clear(ViewerSet *set)
+{
+   memset(set, 0, sizeof(*set));
+}
+
+// Linear probing from the key's home slot; the table is never more than
+// half full, so a probe ends at the key or at a free slot within a few steps
+static int viewer_slot(const ViewerSet *set, uint64_t key)
+{
+   int i = (int)(key & (VIEWER_SET_SLOTS - 1));
+   while (set->keys[i] != 0 && set->keys[i] != key)
+      i = (i + 1) & (VIEWER_SET_SLOTS - 1);
+   return i;
+}
+
+int viewers_add(ViewerSet *set, uint64_t key)
+{
+   int i = viewer_slot(set, key);
+   if (set->keys[i] == key)
+      return 1;
+   if (set->count >= VIEWER_SET_SLOTS / 2)
+      return 0;
+   set->keys[i] = key;
+   set->count++;
+   return 1;
+}
+
+int viewers_contains(const ViewerSet *set, uint64_t key)
+{
+   return set->keys[viewer_slot(set, key)] == key;
+}
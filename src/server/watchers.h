@@ -0,0 +1,84 @@
+#ifndef WATCHERS_H
+#define WATCHERS_H
+
+#include <stdint.h>
+#include "../utils/constants.h"
+
+/*
+ * WATCHERS
+ * ========
+ * Who watches which match. Each (match, client) pair is one entry of a
+ * fixed pool, linked into two doubly-linked lists at once: the watchers of
+ * the match (Match.watchers) and the matches the client watches
+ * (ClientCold.watching). Links and list heads are handles (pool indexes,
+ * WATCH_NONE for none), so a zeroed WatchList is an empty one, and an entry
+ * is unlinked from both sides in O(1) whichever side drops it.
+ *
+ * An entry names its client by id and keeps a copy of the client's socket
+ * and board format for the broadcasts. They are kept up to date through the
+ * client's list when it reconnects or changes format, and the client's
+ * entries are all dropped when it leaves, so a socket number reused by a
+ * later connection never receives somebody else's game.
+ *
+ * A private match only admits the friends of its players. Match.viewers is
+ * the set of their viewer_key()s: it is filled from both players' friend
+ * lists when the match goes private (or a player resumes it) and grows as
+ * they make friends, so admitting a watcher, or purging the watchers when
+ * the match goes private, costs one hash probe per watcher instead of two
+ * scans of up to MAX_FRIENDS names.
+ */
+
+#define WATCH_NONE 0
+
+typedef struct
+{
+   int head; // first entry, WATCH_NONE if the list is empty
+   int count;
+} WatchList;
+
+typedef struct
+{
+   int match_id;
+   int client_id;
+   uint64_t viewer_key; // viewer_key() of the client's name
+   int sock;         // the client's socket, -1 while its connection is lost
+   int board_format; // the client's BoardFormat
+   WatchList *match_list;
+   WatchList *client_list;
+   int match_prev, match_next; // handles in the match's list
+   int client_prev, client_next; // handles in the client's list
+} WatchEntry;
+
+/* Link a new entry into both lists. Returns its handle, WATCH_NONE when
+ * the pool is full. */
+int watch_add(WatchList *match_list, WatchList *client_list, int match_id, int client_id, uint64_t viewer_key, int sock, int board_format);
+/* Unlink an entry from both of its lists and free it */
+void watch_remove(int handle);
+/* Remove every entry of a list: a match slot being reused, a client leaving */
+void watch_clear(WatchList *list);
+
+/* Entry of a valid handle */
+WatchEntry *watch_get(int handle);
+/* The client's entry for `match_id`, WATCH_NONE if it does not watch it
+ * (walks the client's list: the few matches it watches) */
+int watch_find(const WatchList *client_list, int match_id);
+
+/* Copy a client's new socket or board format into all its entries */
+void watch_set_sock(const WatchList *client_list, int sock);
+void watch_set_format(const WatchList *client_list, int board_format);
+
+/* Open addressing table of name keys, 0 marks a free slot */
+typedef struct
+{
+   uint64_t keys[VIEWER_SET_SLOTS];
+   int count;
+} ViewerSet;
+
+/* 64-bit hash of a user name (never 0) */
+uint64_t viewer_key(const char *name);
+void viewers_clear(ViewerSet *set);
+/* Returns 0 if the set is full */
+int viewers_add(ViewerSet *set, uint64_t key);
+int viewers_contains(const ViewerSet *set, uint64_t key);
+
+#endif
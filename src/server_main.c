@@ -1,4 +1,11 @@
 #include "server/server.h"
+#include "server/persist.h"
+#include "server/replay_store.h"
+#include "server/broadcast.h"
+#include "server/metrics.h"
+#include "server/rooms.h"
+#include "server/history.h"
+#include "utils/clock.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,6 +14,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 
@@ -15,13 +23,371 @@ static void display_help_menu(char *exec_name)
    printf("Usage: %s [--port <port_number>]\n", exec_name);
    printf("Options:\n");
    printf("  --port <port_number>   Specify the port number for the server to listen on (default: %d)\n", SERVER_PORT);
+   printf("  --clock <base>+<inc>   Time control in seconds, 0 for untimed games (default: %d+%d)\n", DEFAULT_BASE_TIME_MS / 1000, DEFAULT_INCREMENT_MS / 1000);
+   printf("  --data <dir>           Directory of the match snapshots, move journal, replays and history (default: %s)\n", PERSIST_DEFAULT_DIR);
+   printf("  --no-persist           Do not save matches or replays (nothing survives a restart)\n");
+   printf("  --book <file>          Opening book for analyze, from bin/bookgen (default: %s in the data directory)\n", BOOK_FILE);
    printf("  --help                 Show this help message\n");
 }
 
+/* Close a client connection and clean up its match, challenges and slot */
+static void disconnect_client(Client *clients, int i, int *client_count, Match *matches, int match_count)
+{
+   char buffer[BUF_SIZE];
+   if (clients[i].sock >= 0)
+   {
+      broadcast_forget(clients[i].sock);
+      close(clients[i].sock);
+   }
+
+   /* Handle match cleanup if client was in a match (or held a seat in one) */
+   if ((clients[i].status == CLIENT_IN_MATCH || clients[i].status == CLIENT_DISCONNECTED) && clients[i].current_match >= 0)
+   {
+      Match *m = get_match_by_id(clients[i].current_match, matches, match_count);
+      if (m)
+      {
+         /* Determine opponent */
+         int opponent_idx = (i == m->player1_index) ? m->player2_index : m->player1_index;
+
+         /* Notify opponent about disconnection (a restored match may still wait for it) */
+         if (opponent_idx >= 0)
+            notify(clients[opponent_idx].sock, MSG_GAME_OVER, "%s disconnected from the match", clients[i].name);
+
+         /* Award win to opponent */
+         record_result(clients, opponent_idx, i, 0);
+
+         /* End the match */
+         end_match(m, clients);
+      }
+   }
+
+   /* Clean up pending challenges sent by this client */
+   for (int j = 0; j < clients[i].cold->pending_challenge_to_count; j++)
+   {
+      int target_idx = find_client_index_by_name(clients, *client_count, clients[i].cold->pending_challenge_to[j]);
+      if (target_idx != -1)
+      {
+         remove_challenge_from(&clients[target_idx], clients[i].name);
+      }
+   }
+
+   /* Clean up pending challenges received by this client */
+   for (int j = 0; j < clients[i].cold->pending_challenge_from_count; j++)
+   {
+      int challenger_idx = find_client_index_by_name(clients, *client_count, clients[i].cold->pending_challenge_from[j]);
+      if (challenger_idx != -1)
+      {
+         remove_challenge_to(&clients[challenger_idx], clients[i].name);
+      }
+   }
+
+   printf("%s[disconnection]%s %s left the server\n", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, clients[i].name);
+   strncpy(buffer, clients[i].name, BUF_SIZE - 1);
+   buffer[BUF_SIZE - 1] = '\0';
+   strncat(buffer, " disconnected !", BUF_SIZE - strlen(buffer) - 1);
+   /* logged now, delivered to the others once the client is gone */
+   send_message_to_all_clients(&clients[i], buffer, 1);
+   replay_client_removed(clients[i].id);
+   remove_client(clients, i, client_count);
+   match_client_removed(matches, match_count, i);
+}
+
+/* A player whose connection drops during a running match keeps the seat
+ * for RECONNECT_GRACE_MS (the clock keeps running). Returns 0 if the client
+ * is not playing and has to be removed instead. */
+static int hold_seat(Client *clients, int i, Match *matches, int match_count, ServerTimers *timers)
+{
+   Client *c = &clients[i];
+   Match *m = c->status == CLIENT_IN_MATCH ? get_match_by_id(c->current_match, matches, match_count) : NULL;
+   if (!m || !m->is_active)
+      return 0;
+   broadcast_forget(c->sock);
+   close(c->sock);
+   c->sock = -1;
+   watch_set_sock(&c->cold->watching, -1);
+   c->status = CLIENT_DISCONNECTED;
+   c->input_len = 0;
+   c->drops++;
+   timer_add(&timers->wheel, monotonic_ms(), RECONNECT_GRACE_MS, TIMER_RECONNECT, c->id, c->drops);
+   int opponent_idx = (i == m->player1_index) ? m->player2_index : m->player1_index;
+   if (opponent_idx >= 0)
+      notify(clients[opponent_idx].sock, MSG_INFO, "%s lost connection; their seat is held for %ds", c->name, RECONNECT_GRACE_MS / 1000);
+   printf("%s[disconnection]%s %s dropped out of match #%d, seat held\n", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, c->name, m->id);
+   return 1;
+}
+
+/* The grace period is over: a player who did not come back forfeits */
+static void check_reconnect(Client *clients, int *client_count, Match *matches, int match_count, int client_id, int drops)
+{
+   int i = find_client_index_by_id(clients, *client_count, client_id);
+   if (i == -1 || clients[i].sock >= 0 || clients[i].drops != drops)
+      return; // reconnected in time (or dropped again since, with a new timer)
+   printf("%s[disconnection]%s %s did not reconnect in time\n", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, clients[i].name);
+   disconnect_client(clients, i, client_count, matches, match_count);
+}
+
+/* Give a held (or half-open) session the new socket of a reconnecting
+ * client; `c` is the handshake state, with commands pipelined after it */
+static void reattach_client(Client *clients, int i, const Client *c, Match *matches, int match_count)
+{
+   Client *held = &clients[i];
+   if (held->sock >= 0)
+   {
+      broadcast_forget(held->sock);
+      close(held->sock); // the old connection is dead even if we have not noticed yet
+   }
+   held->sock = c->sock;
+   watch_set_sock(&held->cold->watching, held->sock);
+   memcpy(held->cold->input, c->cold->input, c->input_len);
+   held->input_len = c->input_len;
+   held->last_activity = monotonic_ms();
+   held->drops++; // cancels the pending grace timer
+   held->status = held->current_match >= 0 ? CLIENT_IN_MATCH : CLIENT_IDLE;
+
+   char ack[BUF_SIZE];
+   char payload[BUF_SIZE];
+   snprintf(payload, sizeof(payload), "%s %s", held->name, held->cold->token);
+   protocol_create_message(ack, BUF_SIZE, MSG_CONNECT_ACK, payload);
+   write_client(held->sock, ack);
+   printf("%s[connection]%s %s reconnected\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET, held->name);
+
+   Match *m = held->status == CLIENT_IN_MATCH ? get_match_by_id(held->current_match, matches, match_count) : NULL;
+   if (!m)
+      return;
+   int opponent_idx = (i == m->player1_index) ? m->player2_index : m->player1_index;
+   if (opponent_idx >= 0)
+      notify(clients[opponent_idx].sock, MSG_INFO, "%s reconnected", held->name);
+   notify(held->sock, MSG_INFO, "Reconnected to match #%d", m->id);
+   send_board(m, clients, i);
+}
+
+/* Reap a client whose last command is older than IDLE_TIMEOUT_MS, otherwise re-arm */
+static void check_idle_client(Client *clients, int *client_count, Match *matches, int match_count, ServerTimers *timers, int client_id)
+{
+   int i = find_client_index_by_id(clients, *client_count, client_id);
+   if (i == -1)
+      return;
+   long long now = monotonic_ms();
+   long long idle = now - clients[i].last_activity;
+   if (idle < IDLE_TIMEOUT_MS)
+   {
+      timer_add(&timers->wheel, now, IDLE_TIMEOUT_MS - idle, TIMER_IDLE, client_id, 0);
+      return;
+   }
+   if (clients[i].sock < 0)
+   {
+      timer_add(&timers->wheel, now, IDLE_TIMEOUT_MS, TIMER_IDLE, client_id, 0);
+      return; // the reconnect grace timer decides
+   }
+   notify(clients[i].sock, MSG_ERROR, "Disconnected after %d minutes of inactivity", IDLE_TIMEOUT_MS / 60000);
+   printf("%s[idle]%s Reaping %s\n", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, clients[i].name);
+   disconnect_client(clients, i, client_count, matches, match_count);
+}
+
+/* Run one client command (a line without its '\n'). Returns 0 if the
+ * client kept flooding after being refused and must be disconnected. */
+static int dispatch_command(Client *clients, int i, int client_count, Match *matches, int *match_count, ServerTimers *timers, Matchmaker *matchmaker, char *buffer)
+{
+   const Client *client = &clients[i];
+   printf("%s[message]%s %s: %s\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, client->name, buffer);
+
+   /* Parse command and arguments */
+   char command[BUF_SIZE];
+   char args[BUF_SIZE];
+   protocol_parse_command(buffer, command, args, BUF_SIZE, BUF_SIZE);
+
+   /* Costly commands have their own budget; plain text is sent as chat */
+   RateClass rate_class = protocol_is_command(buffer) ? rate_class_of(command) : RATE_CLASS_CHAT;
+   RateLimits *limits = &clients[i].cold->limits;
+   if (!rate_admit_command(limits, rate_class, monotonic_ms()))
+   {
+      metrics_add(METRIC_COMMANDS_REFUSED, 1);
+      if (limits->strikes >= RATE_MAX_STRIKES)
+         return 0;
+      notify(clients[i].sock, MSG_ERROR, "Slow down: too many %s, try again in a moment",
+             rate_class == RATE_CLASS_CHAT ? "messages" : "watch and analyze commands");
+      return 1;
+   }
+   metrics_add(METRIC_COMMANDS, 1);
+
+   /* Handle different commands */
+   if (strcmp(command, CMD_LIST_USERS) == 0)
+   {
+      handle_list_command(clients[i].sock, clients, i, client_count);
+   }
+   else if (strcmp(command, CMD_MSG) == 0)
+   {
+      handle_message_command(clients[i].sock, client, args);
+   }
+   else if (strcmp(command, CMD_JOIN) == 0)
+   {
+      handle_join_command(clients[i].sock, clients, i, args);
+   }
+   else if (strcmp(command, CMD_ROOMS) == 0)
+   {
+      handle_rooms_command(clients[i].sock);
+   }
+   else if (strcmp(command, CMD_SET_BIO) == 0)
+   {
+      handle_bio_command(clients[i].sock, clients, i, args);
+   }
+   else if (strcmp(command, CMD_GET_BIO) == 0)
+   {
+      handle_getbio_command(clients[i].sock, clients, client_count, args);
+   }
+   else if (strcmp(command, CMD_PM) == 0)
+   {
+      handle_pm_command(clients[i].sock, clients, client, client_count, args);
+   }
+   else if (strcmp(command, CMD_GAMES) == 0)
+   {
+      handle_games_command(clients[i].sock, clients, matches, *match_count);
+   }
+   else if (strcmp(command, CMD_WATCH) == 0)
+   {
+      handle_watch_command(clients[i].sock, clients, i, client_count, args, matches, *match_count);
+   }
+   else if (strcmp(command, CMD_ANALYZE) == 0)
+   {
+      handle_analyze_command(clients[i].sock, clients, i, args, matches, *match_count, timers);
+   }
+   else if (strcmp(command, CMD_UNWATCH) == 0)
+   {
+      handle_unwatch_command(clients[i].sock, clients, i, client_count, args, matches, *match_count);
+   }
+   else if (strcmp(command, CMD_ADD_FRIEND) == 0)
+   {
+      handle_addfriend_command(clients[i].sock, clients, i, client_count, args);
+   }
+   else if (strcmp(command, CMD_ACCEPT_FRIEND) == 0)
+   {
+      handle_acceptfriend_command(clients[i].sock, clients, i, client_count, args, matches, *match_count);
+   }
+   else if (strcmp(command, CMD_REFUSE_FRIEND) == 0)
+   {
+      handle_refusefriend_command(clients[i].sock, clients, i, client_count, args);
+   }
+   else if (strcmp(command, CMD_PRIVATE) == 0)
+   {
+      handle_private_command(clients[i].sock, clients, i, client_count, args, matches, *match_count);
+   }
+   else if (strcmp(command, CMD_FRIENDS) == 0)
+   {
+      handle_friends_command(clients[i].sock, clients, i, client_count);
+   }
+   else if (strcmp(command, CMD_RANKING) == 0)
+   {
+      handle_ranking_command(clients[i].sock, clients, client_count);
+   }
+   else if (strcmp(command, CMD_WATCH_REPLAY) == 0)
+   {
+      handle_watchreplay_command(clients[i].sock, clients, i, args, matches, *match_count, timers);
+   }
+   else if (strcmp(command, CMD_SEEK) == 0)
+   {
+      handle_seek_command(clients[i].sock, clients, i, args, timers);
+   }
+   else if (strcmp(command, CMD_SPEED) == 0)
+   {
+      handle_speed_command(clients[i].sock, clients, i, args, timers);
+   }
+   else if (strcmp(command, CMD_STOP_REPLAY) == 0)
+   {
+      handle_stopreplay_command(clients[i].sock, clients, i, timers);
+   }
+   else if (strcmp(command, CMD_CHALLENGE) == 0)
+   {
+      handle_challenge_command(clients[i].sock, clients, i, client_count, args, timers);
+   }
+   else if (strcmp(command, CMD_ACCEPT) == 0)
+   {
+      handle_accept_command(clients[i].sock, clients, i, client_count, args, matches, match_count, timers);
+   }
+   else if (strcmp(command, CMD_REFUSE) == 0)
+   {
+      handle_refuse_command(clients[i].sock, clients, i, client_count, args);
+   }
+   else if (strcmp(command, CMD_CANCEL) == 0)
+   {
+      handle_cancel_command(clients[i].sock, clients, i, client_count, args);
+   }
+   else if (strcmp(command, CMD_MOVE) == 0)
+   {
+      handle_move_command(clients[i].sock, clients, i, client_count, args, matches, *match_count, timers);
+   }
+   else if (strcmp(command, CMD_QUEUE) == 0)
+   {
+      handle_queue_command(clients[i].sock, clients, i, client_count, matchmaker);
+   }
+   else if (strcmp(command, CMD_UNQUEUE) == 0)
+   {
+      handle_unqueue_command(clients[i].sock, clients, i);
+   }
+   else if (strcmp(command, CMD_BOARD) == 0)
+   {
+      handle_board_command(clients[i].sock, clients, i, args);
+   }
+   else if (strcmp(command, CMD_SYNC) == 0)
+   {
+      handle_sync_command(clients[i].sock, clients, i, args, matches, *match_count);
+   }
+   else if (strcmp(command, CMD_HISTORY) == 0)
+   {
+      handle_history_command(clients[i].sock, args);
+   }
+   else if (strcmp(command, CMD_VARIANT) == 0)
+   {
+      handle_variant_command(clients[i].sock, clients, i, args);
+   }
+   else if (strcmp(command, CMD_RESUME) == 0)
+   {
+      handle_resume_command(clients[i].sock, clients, i, client_count, matches, *match_count, timers);
+   }
+   else if (strcmp(command, CMD_QUIT) == 0)
+   {
+      handle_quit_command(clients[i].sock, clients, i, client_count, matches, *match_count);
+   }
+   else
+   {
+      /* Unknown command or regular message */
+      handle_message_command(clients[i].sock, client, buffer);
+   }
+   return 1;
+}
+
+/* Run up to MAX_COMMANDS_PER_TURN of the client's buffered commands, so that
+ * every ready client gets a turn. The connection's token bucket pauses its
+ * reads once empty. Returns 0 if the client must be disconnected. */
+static int run_client_commands(Client *clients, int i, int client_count, Match *matches, int *match_count, ServerTimers *timers, Matchmaker *matchmaker)
+{
+   char buffer[BUF_SIZE];
+   Client *c = &clients[i];
+   for (int n = 0; n < MAX_COMMANDS_PER_TURN && has_client_command(c); n++)
+   {
+      long long now = monotonic_ms();
+      long long wait_ms = 0;
+      if (!rate_admit_connection(&c->cold->limits, now, &wait_ms))
+      {
+         c->reads_paused = 1;
+         timer_add(&timers->wheel, now, wait_ms, TIMER_RESUME_READS, c->id, 0);
+         metrics_add(METRIC_READS_PAUSED, 1);
+         return 1;
+      }
+      next_client_command(c, buffer, sizeof(buffer));
+      if (!dispatch_command(clients, i, client_count, matches, match_count, timers, matchmaker, buffer))
+         return 0;
+   }
+   return 1;
+}
+
 int main(int argc, char *argv[])
 {
    /* Parse command-line arguments */
    int port = SERVER_PORT; /* default port */
+   long long base_ms = DEFAULT_BASE_TIME_MS;
+   long long increment_ms = DEFAULT_INCREMENT_MS;
+   const char *data_dir = PERSIST_DEFAULT_DIR; /* NULL: persistence off */
+   const char *book_path = NULL;               /* NULL: BOOK_FILE in data_dir, if there is one */
 
    for (int i = 1; i < argc; i++)
    {
@@ -46,6 +412,46 @@ int main(int argc, char *argv[])
             return EXIT_FAILURE;
          }
       }
+      else if (strcmp(argv[i], "--clock") == 0)
+      {
+         int base_s = 0;
+         int inc_s = 0;
+         if (i + 1 >= argc || (sscanf(argv[i + 1], "%d+%d", &base_s, &inc_s) < 1) || base_s < 0 || inc_s < 0)
+         {
+            fprintf(stderr, "%s[error]%s --clock requires <base_seconds>[+<increment_seconds>]\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+            display_help_menu(argv[0]);
+            return EXIT_FAILURE;
+         }
+         base_ms = (long long)base_s * 1000;
+         increment_ms = (long long)inc_s * 1000;
+         i++; /* skip next argument */
+      }
+      else if (strcmp(argv[i], "--data") == 0)
+      {
+         if (i + 1 >= argc)
+         {
+            fprintf(stderr, "%s[error]%s --data requires a directory argument\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+            display_help_menu(argv[0]);
+            return EXIT_FAILURE;
+         }
+         data_dir = argv[i + 1];
+         i++; /* skip next argument */
+      }
+      else if (strcmp(argv[i], "--no-persist") == 0)
+      {
+         data_dir = NULL;
+      }
+      else if (strcmp(argv[i], "--book") == 0)
+      {
+         if (i + 1 >= argc)
+         {
+            fprintf(stderr, "%s[error]%s --book requires a file argument\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+            display_help_menu(argv[0]);
+            return EXIT_FAILURE;
+         }
+         book_path = argv[i + 1];
+         i++; /* skip next argument */
+      }
       else if (strcmp(argv[i], "--help") == 0)
       {
          display_help_menu(argv[0]);
@@ -83,8 +489,69 @@ int main(int argc, char *argv[])
    memset(matches, 0, MAX_MATCHES * sizeof(Match));
    int match_count = 0;
 
+   /* Opening book for analyze: --book, or the one bin/bookgen left in the data directory */
+   char default_book[512];
+   int book_given = book_path != NULL;
+   if (!book_path && data_dir)
+   {
+      snprintf(default_book, sizeof(default_book), "%s/%s", data_dir, BOOK_FILE);
+      book_path = default_book;
+   }
+   if (book_path)
+   {
+      if (analysis_book_open(book_path) == 0)
+         printf("%s[book]%s Opening book loaded from %s\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET, book_path);
+      else if (book_given || errno != ENOENT)
+         fprintf(stderr, "%s[error]%s Cannot load the opening book %s: %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, book_path, strerror(errno));
+   }
+
+   /* Bring back the matches of the previous run, then keep saving them */
+   if (data_dir)
+   {
+      // finished games are archived in the replay store, which also numbers matches
+      if (replay_store_open(data_dir) != 0)
+         fprintf(stderr, "%s[error]%s Cannot archive replays in %s: %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, data_dir, strerror(errno));
+      if (history_open(data_dir) != 0)
+         fprintf(stderr, "%s[error]%s Cannot keep the match history in %s: %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, data_dir, strerror(errno));
+      match_count = restore_matches(data_dir, matches, MAX_MATCHES);
+      int running = 0;
+      for (int k = 0; k < match_count; k++)
+         running += matches[k].is_active;
+      if (match_count > 0)
+         printf("%s[persist]%s Restored %d matches (%d running) from %s\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET, match_count, running, data_dir);
+      if (persist_open(data_dir) != 0)
+      {
+         fprintf(stderr, "%s[error]%s Cannot save matches in %s: %s\n", COLOR_RED COLOR_BOLD, COLOR_RESET, data_dir, strerror(errno));
+         data_dir = NULL;
+      }
+   }
+
+   if (rooms_open() != 0)
+   {
+      fprintf(stderr, "%s[error]%s Failed to allocate memory for the chat log\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+      exit(EXIT_FAILURE);
+   }
+
+   Matchmaker matchmaker;
+   matchmaker_init(&matchmaker);
+   TimerId matchmaking_timer = {0, 0};
+
+   ServerTimers timers;
+   timer_wheel_init(&timers.wheel, monotonic_ms());
+   timers.base_ms = base_ms;
+   timers.increment_ms = increment_ms;
+   TimerEvent events[MAX_TIMER_EVENTS];
+   if (data_dir)
+      timer_add(&timers.wheel, monotonic_ms(), SNAPSHOT_INTERVAL_MS, TIMER_SNAPSHOT, 0, 0);
+   if (replay_store_enabled())
+      timer_add(&timers.wheel, monotonic_ms(), REPLAY_COMPACT_INTERVAL_MS, TIMER_REPLAY_COMPACT, 0, 0);
+   timer_add(&timers.wheel, monotonic_ms(), METRICS_LOG_INTERVAL_MS, TIMER_METRICS, 0, 0);
+   arm_restored_matches(matches, match_count, &timers);
+   int next_client_id = 1;
+
    // read file descriptors set (to store file descriptors to monitor)
    fd_set rdfs;
+   fd_set wrfs; // clients whose chat delivery waits for room in their socket
    // FD_ZERO(&rdfs) - Clears all bits - empties the set
    // FD_SET(fd, &rdfs) - Adds a file descriptor to monitor
    // FD_ISSET(fd, &rdfs) - Checks if a file descriptor has activity
@@ -103,22 +570,116 @@ int main(int argc, char *argv[])
    while (1)
    {
       int i = 0;
+      /* every message of the previous batch has been sent: recycle the scratch space */
+      server_scratch_reset();
+      /* serve the chat log; readers that are behind wait for their socket */
+      int chat_waiting = deliver_chat(clients, client_count);
+      FD_ZERO(&wrfs);
       FD_ZERO(&rdfs);              // clear all the bits of the set (empty it)
       FD_SET(STDIN_FILENO, &rdfs); // add keyboard
       FD_SET(sock, &rdfs);         // add listening socket
 
       /* add socket of each client */
+      int buffered = 0; // commands already received but not yet run
       for (i = 0; i < client_count; i++)
       {
+         if (clients[i].sock < 0)
+            continue; // seat held for a dropped player
+         if (chat_waiting && chat_pending(&clients[i]))
+            FD_SET(clients[i].sock, &wrfs);
+         if (clients[i].reads_paused)
+            continue; // over its rate limit: the flood waits in its socket
          FD_SET(clients[i].sock, &rdfs);
+         buffered = buffered || has_client_command(&clients[i]);
+      }
+
+      /* run a matchmaking batch periodically while players wait in the queue */
+      for (i = 0; i < client_count; i++)
+      {
+         if (clients[i].queued)
+         {
+            if (!timer_pending(&timers.wheel, matchmaking_timer))
+               matchmaking_timer = timer_add(&timers.wheel, monotonic_ms(), MATCHMAKING_TICK_MS, TIMER_MATCHMAKING, 0, 0);
+            break;
+         }
       }
 
-      if (select(max + 1, &rdfs, NULL, NULL, NULL) == -1)
+      /* the timer wheel decides how long we may sleep */
+      long long timeout_ms = buffered ? 0 : timer_wheel_timeout(&timers.wheel, monotonic_ms());
+      struct timeval tv;
+      tv.tv_sec = timeout_ms / 1000;
+      tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+      if (select(max + 1, &rdfs, &wrfs, NULL, timeout_ms >= 0 ? &tv : NULL) == -1)
       {
          perror("select()");
          exit(errno);
       }
 
+      /* dispatch expired timers */
+      int fired;
+      do
+      {
+         fired = timer_wheel_expire(&timers.wheel, monotonic_ms(), events, MAX_TIMER_EVENTS);
+         for (int e = 0; e < fired; e++)
+         {
+            switch (events[e].kind)
+            {
+            case TIMER_MATCH_FLAG:
+               handle_flag_timer(clients, matches, match_count, events[e].a, events[e].b);
+               break;
+            case TIMER_CHALLENGE_EXPIRY:
+               handle_challenge_timer(clients, client_count, events[e].a, events[e].b);
+               break;
+            case TIMER_IDLE:
+               check_idle_client(clients, &client_count, matches, match_count, &timers, events[e].a);
+               break;
+            case TIMER_MATCHMAKING:
+               run_matchmaking(&matchmaker, clients, client_count, matches, &match_count, &timers);
+               break;
+            case TIMER_RECONNECT:
+               check_reconnect(clients, &client_count, matches, match_count, events[e].a, events[e].b);
+               break;
+            case TIMER_SNAPSHOT:
+               snapshot_matches(matches, match_count);
+               timer_add(&timers.wheel, monotonic_ms(), SNAPSHOT_INTERVAL_MS, TIMER_SNAPSHOT, 0, 0);
+               break;
+            case TIMER_REPLAY_STEP:
+               handle_replay_timer(clients, client_count, &timers, events[e].a);
+               break;
+            case TIMER_RESUME_READS:
+            {
+               int j = find_client_index_by_id(clients, client_count, events[e].a);
+               if (j != -1)
+                  clients[j].reads_paused = 0;
+               break;
+            }
+            case TIMER_METRICS:
+               metrics_log();
+               timer_add(&timers.wheel, monotonic_ms(), METRICS_LOG_INTERVAL_MS, TIMER_METRICS, 0, 0);
+               break;
+            case TIMER_ANALYSIS:
+               handle_analysis_timer(clients, client_count, matches, match_count, &timers);
+               break;
+            case TIMER_RESTORE_GRACE:
+               handle_restore_timer(clients, matches, match_count, events[e].a);
+               break;
+            case TIMER_REPLAY_COMPACT:
+               compact_replays(matches, match_count);
+               timer_add(&timers.wheel, monotonic_ms(), REPLAY_COMPACT_INTERVAL_MS, TIMER_REPLAY_COMPACT, 0, 0);
+               break;
+            }
+         }
+      } while (fired == MAX_TIMER_EVENTS);
+
+      /* timers may have disconnected clients whose sockets were reported readable */
+      for (i = 0; i < client_count; i++)
+      {
+         if (clients[i].sock >= 0 && !clients[i].reads_paused && (FD_ISSET(clients[i].sock, &rdfs) || has_client_command(&clients[i])))
+            break;
+      }
+      int client_ready = i < client_count;
+
       // if there is activity on keyboard stop the sevrer
       if (FD_ISSET(STDIN_FILENO, &rdfs))
       {
@@ -139,13 +700,52 @@ int main(int argc, char *argv[])
             continue;
          }
 
+         // replies are made of several small frames: do not let Nagle hold them back
+         int nodelay = 1;
+         setsockopt(csock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+         /* The handshake is read straight into the next free entry, which
+          * only becomes a client once client_count covers it */
+         Client *c = &clients[client_count];
+         if (client_count == MAX_CLIENTS || !(c->cold = client_cold_alloc()))
+         {
+            printf("%s[error]%s Server full (%d clients). Connection rejected.\n", COLOR_RED COLOR_BOLD, COLOR_RESET, MAX_CLIENTS);
+            notify(csock, MSG_ERROR, "Server full. Connection rejected.");
+            close(csock);
+            continue;
+         }
+         c->sock = csock;
+         c->input_len = 0;
          // try to read the name of the client (it is sended at connection)
-         if (read_from_client(csock, buffer) == 0)
+         if (read_client_input(c) == 0)
          {
             printf("%s[error]%s Client disconnected before sending name.\n", COLOR_RED COLOR_BOLD, COLOR_RESET);
+            client_cold_free(c->cold);
             close(csock);
             continue;
          }
+         // the name is the first line; commands pipelined behind it stay buffered
+         if (!next_client_command(c, buffer, sizeof(buffer)))
+         {
+            memcpy(buffer, c->cold->input, c->input_len);
+            buffer[c->input_len] = '\0';
+            c->input_len = 0;
+         }
+
+         /* "name token": a reconnect that takes its session back */
+         char *token = strrchr(buffer, ' ');
+         if (token && strlen(token + 1) == SESSION_TOKEN_LEN)
+            *token++ = '\0';
+         else
+            token = NULL;
+         int held = token ? find_client_index_by_name(clients, client_count, buffer) : -1;
+         if (held != -1 && strcmp(clients[held].cold->token, token) == 0)
+         {
+            max = csock > max ? csock : max;
+            reattach_client(clients, held, c, matches, match_count);
+            client_cold_free(c->cold);
+            continue;
+         }
 
          /* Check if username is unique */
          if (!is_username_unique(clients, client_count, buffer))
@@ -154,6 +754,7 @@ int main(int argc, char *argv[])
             char error_msg[BUF_SIZE];
             protocol_create_message(error_msg, BUF_SIZE, MSG_ERROR, "Username already taken. Connection rejected.");
             write_client(csock, error_msg);
+            client_cold_free(c->cold);
             close(csock);
             continue;
          }
@@ -165,227 +766,90 @@ int main(int argc, char *argv[])
 
          FD_SET(csock, &rdfs);
 
-         Client c;
-         c.sock = csock;
-         strncpy(c.name, buffer, MAX_USERNAME_LEN - 1);
-         c.status = CLIENT_IDLE;
-         c.current_match = -1;
-         memset(c.bio, 0, MAX_BIO_LEN);
-         memset(c.pending_challenge_to, 0, MAX_CHALLENGES * MAX_USERNAME_LEN);
-         c.pending_challenge_to_count = 0;
-         memset(c.pending_challenge_from, 0, MAX_CHALLENGES * MAX_USERNAME_LEN);
-         c.pending_challenge_from_count = 0;
-         c.is_turn = 0;
-         c.friend_count = 0;
-         c.pending_friend_to[0] = '\0';
-         c.pending_friend_from[0] = '\0';
-         c.wins = 0;
-         clients[client_count] = c;
+         /* the cold part starts zeroed: no bio, challenges nor friends */
+         c->id = next_client_id++;
+         make_session_token(c->cold->token);
+         c->drops = 0;
+         strncpy(c->name, buffer, MAX_USERNAME_LEN - 1);
+         c->name[MAX_USERNAME_LEN - 1] = '\0';
+         c->status = CLIENT_IDLE;
+         c->current_match = -1;
+         c->is_turn = 0;
+         c->wins = 0;
+         c->rating = INITIAL_RATING;
+         c->queued = 0;
+         c->queued_at = 0;
+         c->last_activity = monotonic_ms();
+         c->reads_paused = 0;
+         rate_limits_init(&c->cold->limits, c->last_activity);
+         c->board_format = BOARD_FORMAT_DELTA;
+         c->variant = VARIANT_ABAPA;
+         chat_join(c);
+         timer_add(&timers.wheel, c->last_activity, IDLE_TIMEOUT_MS, TIMER_IDLE, c->id, 0);
          client_count++;
 
-         printf("%s[connection]%s %s joined the server\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET, c.name);
+         printf("%s[connection]%s %s joined the server\n", COLOR_GREEN COLOR_BOLD, COLOR_RESET, c->name);
 
-         /* Send connection acknowledgment to client */
+         /* Send connection acknowledgment to client, with the session token */
          char ack_msg[BUF_SIZE];
-         protocol_create_message(ack_msg, BUF_SIZE, MSG_CONNECT_ACK, c.name);
+         char ack_payload[BUF_SIZE];
+         snprintf(ack_payload, sizeof(ack_payload), "%s %s", c->name, c->cold->token);
+         protocol_create_message(ack_msg, BUF_SIZE, MSG_CONNECT_ACK, ack_payload);
          write_client(csock, ack_msg);
+
+         int resumable = find_resumable_match(c->name, matches, match_count);
+         if (resumable >= 0)
+            notify(csock, MSG_INFO, "Your match #%d was interrupted by a server restart; type 'resume' to continue it", resumable);
       }
       // if there is activity not on listening socket nor on keyboard - maybe client is talking or an error
       // we need to check all clients whether they are talking
-      else
+      else if (client_ready)
       {
+         /* every client that is talking, or still has pipelined commands
+          * buffered, gets a turn */
          int i = 0;
          for (i = 0; i < client_count; i++)
          {
-            /* a client is talking */
+            if (clients[i].sock < 0 || clients[i].reads_paused)
+               continue;
             if (FD_ISSET(clients[i].sock, &rdfs))
             {
-               Client client = clients[i];
-               int c = read_from_client(clients[i].sock, buffer);
-               /* client disconnected */
-               if (c == 0)
+               /* client disconnected: players keep their seat for a while */
+               if (read_client_input(&clients[i]) == 0)
                {
-                  close(clients[i].sock);
-
-                  /* Handle match cleanup if client was in a match */
-                  if (clients[i].status == CLIENT_IN_MATCH && clients[i].current_match >= 0)
-                  {
-                     Match *m = get_match_by_id(clients[i].current_match, matches, match_count);
-                     if (m)
-                     {
-                        /* Determine opponent */
-                        int opponent_idx = (i == m->player1_index) ? m->player2_index : m->player1_index;
-
-                        /* Notify opponent about disconnection */
-                        notify(clients[opponent_idx].sock, MSG_GAME_OVER, "%s disconnected from the match", clients[i].name);
-
-                        /* Award win to opponent */
-                        clients[opponent_idx].wins++;
-
-                        /* End the match */
-                        end_match(m, clients);
-                     }
-                  }
-
-                  /* Clean up pending challenges sent by this client */
-                  for (int j = 0; j < clients[i].pending_challenge_to_count; j++)
-                  {
-                     int target_idx = find_client_index_by_name(clients, client_count, clients[i].pending_challenge_to[j]);
-                     if (target_idx != -1)
-                     {
-                        /* Remove from target's pending_challenge_from */
-                        for (int k = 0; k < clients[target_idx].pending_challenge_from_count; k++)
-                        {
-                           if (strcmp(clients[target_idx].pending_challenge_from[k], clients[i].name) == 0)
-                           {
-                              for (int m = k; m < clients[target_idx].pending_challenge_from_count - 1; m++)
-                              {
-                                 strncpy(clients[target_idx].pending_challenge_from[m],
-                                         clients[target_idx].pending_challenge_from[m + 1], MAX_USERNAME_LEN - 1);
-                              }
-                              clients[target_idx].pending_challenge_from_count--;
-                              break;
-                           }
-                        }
-                     }
-                  }
-
-                  /* Clean up pending challenges received by this client */
-                  for (int j = 0; j < clients[i].pending_challenge_from_count; j++)
-                  {
-                     int challenger_idx = find_client_index_by_name(clients, client_count, clients[i].pending_challenge_from[j]);
-                     if (challenger_idx != -1)
-                     {
-                        /* Remove from challenger's pending_challenge_to */
-                        for (int k = 0; k < clients[challenger_idx].pending_challenge_to_count; k++)
-                        {
-                           if (strcmp(clients[challenger_idx].pending_challenge_to[k], clients[i].name) == 0)
-                           {
-                              for (int m = k; m < clients[challenger_idx].pending_challenge_to_count - 1; m++)
-                              {
-                                 strncpy(clients[challenger_idx].pending_challenge_to[m],
-                                         clients[challenger_idx].pending_challenge_to[m + 1], MAX_USERNAME_LEN - 1);
-                              }
-                              clients[challenger_idx].pending_challenge_to_count--;
-                              break;
-                           }
-                        }
-                     }
-                  }
-
-                  remove_client(clients, i, &client_count);
-                  printf("%s[disconnection]%s %s left the server\n", COLOR_YELLOW COLOR_BOLD, COLOR_RESET, client.name);
-                  strncpy(buffer, client.name, BUF_SIZE - 1);
-                  strncat(buffer, " disconnected !", BUF_SIZE - strlen(buffer) - 1);
-                  send_message_to_all_clients(clients, client, client_count, buffer, 1);
+                  if (!hold_seat(clients, i, matches, match_count, &timers))
+                     disconnect_client(clients, i--, &client_count, matches, match_count);
+                  continue;
                }
-               else
-               {
-                  printf("%s[message]%s %s: %s\n", COLOR_BLUE COLOR_BOLD, COLOR_RESET, client.name, buffer);
-
-                  /* Parse command and arguments */
-                  char command[BUF_SIZE];
-                  char args[BUF_SIZE];
-                  protocol_parse_command(buffer, command, args, BUF_SIZE, BUF_SIZE);
-
-                  /* Handle different commands */
-                  if (strcmp(command, CMD_LIST_USERS) == 0)
-                  {
-                     handle_list_command(clients[i].sock, clients, client_count);
-                  }
-                  else if (strcmp(command, CMD_MSG) == 0)
-                  {
-                     handle_message_command(clients[i].sock, clients, client, client_count, args);
-                  }
-                  else if (strcmp(command, CMD_SET_BIO) == 0)
-                  {
-                     handle_bio_command(clients[i].sock, clients, i, args);
-                  }
-                  else if (strcmp(command, CMD_GET_BIO) == 0)
-                  {
-                     handle_getbio_command(clients[i].sock, clients, client_count, args);
-                  }
-                  else if (strcmp(command, CMD_PM) == 0)
-                  {
-                     handle_pm_command(clients[i].sock, clients, client, client_count, args);
-                  }
-                  else if (strcmp(command, CMD_GAMES) == 0)
-                  {
-                     handle_games_command(clients[i].sock, clients, matches, match_count);
-                  }
-                  else if (strcmp(command, CMD_WATCH) == 0)
-                  {
-                     handle_watch_command(clients[i].sock, clients, i, client_count, args, matches, match_count);
-                  }
-                  else if (strcmp(command, CMD_UNWATCH) == 0)
-                  {
-                     handle_unwatch_command(clients[i].sock, clients, i, client_count, args, matches, match_count);
-                  }
-                  else if (strcmp(command, CMD_ADD_FRIEND) == 0)
-                  {
-                     handle_addfriend_command(clients[i].sock, clients, i, client_count, args);
-                  }
-                  else if (strcmp(command, CMD_ACCEPT_FRIEND) == 0)
-                  {
-                     handle_acceptfriend_command(clients[i].sock, clients, i, client_count, args);
-                  }
-                  else if (strcmp(command, CMD_REFUSE_FRIEND) == 0)
-                  {
-                     handle_refusefriend_command(clients[i].sock, clients, i, client_count, args);
-                  }
-                  else if (strcmp(command, CMD_PRIVATE) == 0)
-                  {
-                     handle_private_command(clients[i].sock, clients, i, client_count, args, matches, match_count);
-                  }
-                  else if (strcmp(command, CMD_FRIENDS) == 0)
-                  {
-                     handle_friends_command(clients[i].sock, clients, i, client_count);
-                  }
-                  else if (strcmp(command, CMD_RANKING) == 0)
-                  {
-                     handle_ranking_command(clients[i].sock, clients, client_count);
-                  }
-                  else if (strcmp(command, CMD_WATCH_REPLAY) == 0)
-                  {
-                     handle_watchreplay_command(clients[i].sock, clients, i, client_count, args, matches, match_count);
-                  }
-                  else if (strcmp(command, CMD_CHALLENGE) == 0)
-                  {
-                     handle_challenge_command(clients[i].sock, clients, i, client_count, args);
-                  }
-                  else if (strcmp(command, CMD_ACCEPT) == 0)
-                  {
-                     handle_accept_command(clients[i].sock, clients, i, client_count, args, matches, &match_count);
-                  }
-                  else if (strcmp(command, CMD_REFUSE) == 0)
-                  {
-                     handle_refuse_command(clients[i].sock, clients, i, client_count, args);
-                  }
-                  else if (strcmp(command, CMD_CANCEL) == 0)
-                  {
-                     handle_cancel_command(clients[i].sock, clients, i, client_count, args);
-                  }
-                  else if (strcmp(command, CMD_MOVE) == 0)
-                  {
-                     handle_move_command(clients[i].sock, clients, i, client_count, args, matches, match_count);
-                  }
-                  else if (strcmp(command, CMD_QUIT) == 0)
-                  {
-                     handle_quit_command(clients[i].sock, clients, i, client_count, matches, match_count);
-                  }
-                  else
-                  {
-                     /* Unknown command or regular message */
-                     handle_message_command(clients[i].sock, clients, client, client_count, buffer);
-                  }
-               }
-               break;
+            }
+            else if (!has_client_command(&clients[i]))
+            {
+               continue;
+            }
+            clients[i].last_activity = monotonic_ms();
+            if (!run_client_commands(clients, i, client_count, matches, &match_count, &timers, &matchmaker))
+            {
+               printf("%s[flood]%s Dropping %s: too many refused commands\n", COLOR_RED COLOR_BOLD, COLOR_RESET, clients[i].name);
+               notify(clients[i].sock, MSG_ERROR, "Disconnected for flooding");
+               metrics_add(METRIC_FLOOD_DISCONNECTS, 1);
+               disconnect_client(clients, i--, &client_count, matches, match_count);
             }
          }
       }
    }
 
    clear_clients(clients, client_count);
+   metrics_log();
+   /* last snapshot, then wait for the writer to put everything on disk */
+   snapshot_matches(matches, match_count);
+   persist_close();
+   replay_store_close();
+   rooms_close();
+   analysis_close();
+   analysis_book_close();
+   history_close();
+   matchmaker_free(&matchmaker);
+   timer_wheel_free(&timers.wheel);
    free(matches);
    matches = NULL;
    end_connection(sock);
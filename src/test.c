@@ -66,14 +66,15 @@ bool is_valid_board_seeds(const Board *board)
             return false; // Negative seeds in a pit is invalid
         total_seeds += board->pits[i];
     }
-    // Total seeds must equal INITIAL_SEEDS * TOTAL_PITS
-    return total_seeds + board->score[0] + board->score[1] == INITIAL_SEEDS * TOTAL_PITS;
+    // Total seeds must equal the variant's seeds per pit * TOTAL_PITS
+    return total_seeds + board->score[0] + board->score[1] == variant_info(board->variant)->seeds * TOTAL_PITS;
 }
 
 // Retrurns true if the board is valid, false otherwise
 bool input_init_board(Board *board)
 {
     int total_seeds = 0;
+    const int expected_seeds = variant_info(board->variant)->seeds * TOTAL_PITS;
 
     printf("Enter the number if seeds in each pit for player 1:\n");
     for (int i = 0; i < PITS_PER_PLAYER; i++)
@@ -82,9 +83,9 @@ bool input_init_board(Board *board)
         sprintf(prompt, "Pit %d: ", i);
         board->pits[i] = get_validated_integer_input(prompt);
         total_seeds += board->pits[i];
-        display_total_seeds_at_bottom(total_seeds, INITIAL_SEEDS * TOTAL_PITS);
+        display_total_seeds_at_bottom(total_seeds, expected_seeds);
     }
-    display_total_seeds_at_bottom(total_seeds, INITIAL_SEEDS * TOTAL_PITS);
+    display_total_seeds_at_bottom(total_seeds, expected_seeds);
 
     printf("\n\nEnter the number if seeds in each pit for player 2:\n");
     for (int i = PITS_PER_PLAYER; i < TOTAL_PITS; i++)
@@ -93,18 +94,18 @@ bool input_init_board(Board *board)
         sprintf(prompt, "Pit %d: ", i);
         board->pits[i] = get_validated_integer_input(prompt);
         total_seeds += board->pits[i];
-        display_total_seeds_at_bottom(total_seeds, INITIAL_SEEDS * TOTAL_PITS);
+        display_total_seeds_at_bottom(total_seeds, expected_seeds);
     }
-    display_total_seeds_at_bottom(total_seeds, INITIAL_SEEDS * TOTAL_PITS);
+    display_total_seeds_at_bottom(total_seeds, expected_seeds);
 
     printf("\n\nEnter the scores for both players:\n");
     board->score[0] = get_validated_integer_input("Player 1 Score: ");
     total_seeds += board->score[0];
-    display_total_seeds_at_bottom(total_seeds, INITIAL_SEEDS * TOTAL_PITS);
+    display_total_seeds_at_bottom(total_seeds, expected_seeds);
 
     board->score[1] = get_validated_integer_input("Player 2 Score: ");
     total_seeds += board->score[1];
-    display_total_seeds_at_bottom(total_seeds, INITIAL_SEEDS * TOTAL_PITS);
+    display_total_seeds_at_bottom(total_seeds, expected_seeds);
 
     if (!is_valid_board_seeds(board))
     {
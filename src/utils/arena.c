@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+
+static size_t align_up(size_t n)
+{
+   return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static ArenaBlock *new_block(Arena *a, size_t min_size)
+{
+   size_t size = a->block_size;
+   while (size < min_size)
+      size *= 2;
+   ArenaBlock *b = malloc(sizeof(ArenaBlock) + size);
+   if (!b)
+      return NULL;
+   b->next = a->head;
+   b->size = size;
+   b->used = 0;
+   a->head = b;
+   return b;
+}
+
+void arena_init(Arena *a, size_t block_size)
+{
+   a->head = NULL;
+   a->block_size = align_up(block_size ? block_size : 4096);
+   a->in_use = 0;
+   a->peak = 0;
+}
+
+void arena_free(Arena *a)
+{
+   ArenaBlock *b = a->head;
+   while (b)
+   {
+      ArenaBlock *next = b->next;
+      free(b);
+      b = next;
+   }
+   a->head = NULL;
+   a->in_use = 0;
+}
+
+void arena_reset(Arena *a)
+{
+   if (a->in_use > a->peak)
+      a->peak = a->in_use;
+   a->in_use = 0;
+   if (a->head && a->head->next)
+   {
+      // several blocks were needed: replace them by one block for the peak
+      arena_free(a);
+      new_block(a, a->peak);
+   }
+   else if (a->head)
+   {
+      a->head->used = 0;
+   }
+}
+
+void *arena_alloc(Arena *a, size_t size)
+{
+   size = align_up(size ? size : 1);
+   ArenaBlock *b = a->head;
+   if (!b || b->size - b->used < size)
+   {
+      b = new_block(a, size);
+      if (!b)
+         return NULL;
+   }
+   void *p = b->data + b->used;
+   b->used += size;
+   a->in_use += size;
+   return p;
+}
+
+char *arena_vprintf(Arena *a, size_t reserve, size_t *len, const char *fmt, va_list ap)
+{
+   va_list again;
+   va_copy(again, ap);
+   ArenaBlock *b = a->head;
+   if (!b || b->size - b->used <= reserve)
+      b = new_block(a, reserve + 1);
+   if (!b)
+   {
+      va_end(again);
+      return NULL;
+   }
+   // try to format straight into the free space of the current block
+   char *start = b->data + b->used;
+   size_t room = b->size - b->used - reserve;
+   int n = vsnprintf(start + reserve, room, fmt, ap);
+   if (n < 0)
+   {
+      va_end(again);
+      return NULL;
+   }
+   if ((size_t)n >= room)
+   {
+      // too small: format again into a block of the exact size needed
+      b = new_block(a, reserve + (size_t)n + 1);
+      if (!b)
+      {
+         va_end(again);
+         return NULL;
+      }
+      start = b->data;
+      vsnprintf(start + reserve, (size_t)n + 1, fmt, again);
+   }
+   va_end(again);
+   size_t used = align_up(reserve + (size_t)n + 1);
+   if (used > b->size - b->used)
+      used = b->size - b->used;
+   b->used += used;
+   a->in_use += used;
+   *len = (size_t)n;
+   return start;
+}
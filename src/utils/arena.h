@@ -0,0 +1,43 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdarg.h>
+
+/*
+ * BUMP ARENA
+ * ==========
+ * Scratch memory for one iteration of the event loop: allocations only move
+ * a pointer forward and everything is released at once by arena_reset().
+ * When a block is exhausted a larger one is chained in; on reset the chain
+ * is folded into a single block sized for the peak, so a steady workload
+ * settles on one block and no further malloc calls.
+ */
+
+typedef struct ArenaBlock
+{
+   struct ArenaBlock *next;
+   size_t size;
+   size_t used;
+   size_t pad; // keeps data[] 16-byte aligned
+   char data[];
+} ArenaBlock;
+
+typedef struct
+{
+   ArenaBlock *head;  // block currently allocated from (newest)
+   size_t block_size; // minimum size of a new block
+   size_t in_use;     // bytes handed out since the last reset
+   size_t peak;       // largest in_use seen at a reset
+} Arena;
+
+void arena_init(Arena *a, size_t block_size);
+void arena_free(Arena *a);
+/* Release every allocation made since the last reset */
+void arena_reset(Arena *a);
+void *arena_alloc(Arena *a, size_t size);
+/* Format into the arena after `reserve` uninitialised bytes; returns the
+ * start of the reserved area and stores the formatted length in *len */
+char *arena_vprintf(Arena *a, size_t reserve, size_t *len, const char *fmt, va_list ap);
+
+#endif
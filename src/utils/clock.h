@@ -0,0 +1,7 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+/* Milliseconds from a monotonic clock (not affected by wall-clock changes) */
+long long monotonic_ms(void);
+
+#endif
@@ -1,19 +1,10 @@
 #ifndef CONSTANTS_H
 #define CONSTANTS_H
 
-#define PITS_PER_PLAYER 6
-#define TOTAL_PITS 12
-#define INITIAL_SEEDS 4
-
 /* GAME CONSTANTS */
-// seeds
+// pits (seeds per pit and capture rules depend on the variant, see AWALE_VARIANTS)
 #define PITS_PER_PLAYER 6
 #define TOTAL_PITS 12
-#define INITIAL_SEEDS 4
-#define TOTAL_SEEDS (INITIAL_SEEDS * TOTAL_PITS)
-#define MIN_SEEDS_TO_WIN (TOTAL_SEEDS / 2 + 1)
-#define MIN_CAPTURE_SEEDS 2
-#define MAX_CAPTURE_SEEDS 3
 // players
 #define PLAYER_1 0
 #define PLAYER_2 1
@@ -55,11 +46,71 @@
 #define MAX_CHALLENGES 128
 #define MAX_MATCHES 64
 #define MAX_FRIENDS 128
+#define MAX_WATCHES (MAX_CLIENTS * MAX_MATCHES) // (match, watcher) pairs: every client may watch every match
+#define VIEWER_SET_SLOTS 512 // friends of both players of a private match (2 * MAX_FRIENDS), at most half full
 // replays
-#define MAX_REPLAYS 256
+#define MAX_REPLAYS 256 // decoded replay streams open at once
 #define MAX_MOVES 512
+#define REPLAY_STEP_MS 1000         // default replay pace, per move
+#define REPLAY_MIN_STEP_MS 50
+#define REPLAY_KEYFRAME_INTERVAL 16 // plies between the boards kept for seeking
+// matchmaking
+#define INITIAL_RATING 1200
+#define RATING_K_FACTOR 32
+#define MATCHMAKING_TICK_MS 500
+#define MATCHMAKING_BUCKET_WIDTH 50        // rating points per queue bucket
+#define MATCHMAKING_INITIAL_BAND 50        // accepted rating gap when joining
+#define MATCHMAKING_BAND_GROWTH_PER_SEC 25 // band widening while waiting
+#define MATCHMAKING_MAX_BAND 1000
+// timers
+#define DEFAULT_BASE_TIME_MS (5 * 60 * 1000) // per-player clock
+#define DEFAULT_INCREMENT_MS (5 * 1000)      // added after each move
+#define CHALLENGE_TIMEOUT_MS (60 * 1000)
+#define IDLE_TIMEOUT_MS (30 * 60 * 1000)
+#define RECONNECT_GRACE_MS (60 * 1000) // a dropped player's seat is held this long
+#define SESSION_TOKEN_LEN 16           // hex characters
+#define MAX_TIMER_EVENTS 64 // timer events handled per batch
+
+// Flood protection: token buckets of burst tokens, refilled per second
+#define RATE_CONNECTION_BURST 200 // any command; the socket is not read while empty
+#define RATE_CONNECTION_PER_SEC 100
+#define RATE_CHAT_BURST 10 // msg, pm: each one is sent to every client
+#define RATE_CHAT_PER_SEC 2
+#define RATE_WATCH_BURST 10 // watch, unwatch, analyze, watchreplay
+#define RATE_WATCH_PER_SEC 2
+#define RATE_MAX_STRIKES 20      // refused commands in a row before a client is dropped
+#define MAX_COMMANDS_PER_TURN 8  // commands run per client per loop iteration
+#define METRICS_LOG_INTERVAL_MS (60 * 1000)
+// position analysis
+#define ANALYSIS_TIME_MS 200 // search budget of one analyze request
+#define ANALYSIS_THREADS 2
+#define ANALYSIS_HASH_MB 16
+#define ANALYSIS_QUEUE 16        // positions waiting for the analysis worker
+#define ANALYSIS_MAX_WAITING 64  // analyze requests waiting for a search
+#define ANALYSIS_POLL_MS 10      // how often the loop checks for a finished search
+#define BOOK_FILE "book.bin" // opening book written by bin/bookgen, in the data directory
+// match persistence (crash recovery)
+#define PERSIST_DEFAULT_DIR "awale-data"
+#define PERSIST_FLUSH_MS 20            // journal group commit interval
+#define SNAPSHOT_INTERVAL_MS (5 * 1000) // dirty matches are snapshotted this often
+// replay archive
+#define REPLAY_SEGMENT_GAMES 1024              // match ids per segment file
+#define REPLAY_COMPACT_INTERVAL_MS (60 * 1000) // sealed segments are compacted this often
+#define ARCHIVE_MAX_RETRIES 5                  // failed archive retries before a match's slot is freed anyway
+// match history index
+#define HISTORY_MERGE_RECORDS 4096 // records kept in memory before a merge into the sorted file
+#define HISTORY_SPARSE_EVERY 64    // sorted-file records per sparse index entry
+#define HISTORY_DEFAULT_GAMES 10   // games listed by "history <user>"
+#define HISTORY_MAX_GAMES 50
 // buffer size (max message size)
 #define BUF_SIZE 1024
+#define MAX_FRAME_SIZE (64 * 1024)     // largest server -> client message
+#define BROADCAST_LOG_ENTRIES 1024     // lobby chat messages kept for slow readers
+#define ROOM_LOG_ENTRIES 256           // same, for the other chat rooms
+#define MAX_ROOMS 32                   // chat rooms open at once, lobby included
+#define ROOM_NAME_LEN 32
+#define ROOM_LOBBY_NAME "lobby"
+#define SCRATCH_BLOCK_SIZE (64 * 1024) // per-iteration scratch arena block
 
 // useful types
 typedef struct sockaddr_in SOCKADDR_IN;
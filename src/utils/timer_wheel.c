@@ -0,0 +1,224 @@
+#include <stdlib.h>
+#include <string.h>
+#include "timer_wheel.h"
+
+#define TIMER_SLOT_MASK (TIMER_SLOTS - 1)
+#define TIMER_MAX_SPAN ((long long)1 << (TIMER_SLOT_BITS * TIMER_LEVELS))
+
+void timer_wheel_init(TimerWheel *tw, long long now_ms)
+{
+   memset(tw, 0, sizeof(*tw));
+   for (int l = 0; l < TIMER_LEVELS; l++)
+      for (int s = 0; s < TIMER_SLOTS; s++)
+         tw->slots[l][s] = -1;
+   tw->current_tick = now_ms / TIMER_TICK_MS;
+   tw->free_head = -1;
+}
+
+void timer_wheel_free(TimerWheel *tw)
+{
+   free(tw->pool);
+   tw->pool = NULL;
+   tw->pool_size = 0;
+   tw->count = 0;
+}
+
+static int alloc_node(TimerWheel *tw)
+{
+   if (tw->free_head == -1)
+   {
+      int old_size = tw->pool_size;
+      int new_size = old_size ? old_size * 2 : 64;
+      TimerNode *pool = realloc(tw->pool, (size_t)new_size * sizeof(TimerNode));
+      if (!pool)
+         return -1;
+      tw->pool = pool;
+      tw->pool_size = new_size;
+      // node 0 is reserved so that a zero TimerId means "no timer"
+      for (int i = new_size - 1; i >= (old_size ? old_size : 1); i--)
+      {
+         pool[i].generation = 1;
+         pool[i].prev = -2;
+         pool[i].next = tw->free_head;
+         tw->free_head = i;
+      }
+      if (old_size == 0)
+         pool[0].prev = -2;
+   }
+   int n = tw->free_head;
+   tw->free_head = tw->pool[n].next;
+   return n;
+}
+
+static void release_node(TimerWheel *tw, int n)
+{
+   tw->pool[n].generation++;
+   tw->pool[n].prev = -2;
+   tw->pool[n].next = tw->free_head;
+   tw->free_head = n;
+}
+
+// Link a node into the slot matching its distance from the current tick
+static void place(TimerWheel *tw, int n)
+{
+   TimerNode *node = &tw->pool[n];
+   long long diff = node->expires_tick - tw->current_tick;
+   if (diff < 0)
+   {
+      node->expires_tick = tw->current_tick;
+      diff = 0;
+   }
+   if (diff >= TIMER_MAX_SPAN)
+   {
+      node->expires_tick = tw->current_tick + TIMER_MAX_SPAN - 1;
+      diff = TIMER_MAX_SPAN - 1;
+   }
+   int level = 0;
+   while (level < TIMER_LEVELS - 1 && diff >= ((long long)1 << (TIMER_SLOT_BITS * (level + 1))))
+      level++;
+   int slot = (int)((node->expires_tick >> (TIMER_SLOT_BITS * level)) & TIMER_SLOT_MASK);
+   node->prev = -1;
+   node->next = tw->slots[level][slot];
+   if (node->next != -1)
+      tw->pool[node->next].prev = n;
+   tw->slots[level][slot] = n;
+}
+
+static void unlink_node(TimerWheel *tw, int n)
+{
+   TimerNode *node = &tw->pool[n];
+   if (node->prev != -1)
+   {
+      tw->pool[node->prev].next = node->next;
+   }
+   else
+   {
+      // head of some slot: find it from the expiry (O(levels))
+      for (int l = 0; l < TIMER_LEVELS; l++)
+      {
+         int s = (int)((node->expires_tick >> (TIMER_SLOT_BITS * l)) & TIMER_SLOT_MASK);
+         if (tw->slots[l][s] == n)
+         {
+            tw->slots[l][s] = node->next;
+            break;
+         }
+      }
+   }
+   if (node->next != -1)
+      tw->pool[node->next].prev = node->prev;
+}
+
+TimerId timer_add(TimerWheel *tw, long long now_ms, long long delay_ms, int kind, int a, int b)
+{
+   TimerId id = {0, 0};
+   int n = alloc_node(tw);
+   if (n < 0)
+      return id;
+   TimerNode *node = &tw->pool[n];
+   node->event.kind = kind;
+   node->event.a = a;
+   node->event.b = b;
+   if (delay_ms < 0)
+      delay_ms = 0;
+   node->expires_tick = (now_ms + delay_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+   place(tw, n);
+   tw->count++;
+   id.index = (unsigned int)n;
+   id.generation = node->generation;
+   return id;
+}
+
+int timer_pending(const TimerWheel *tw, TimerId id)
+{
+   if (id.index == 0 || (int)id.index >= tw->pool_size)
+      return 0;
+   const TimerNode *node = &tw->pool[id.index];
+   return node->generation == id.generation && node->prev != -2;
+}
+
+int timer_cancel(TimerWheel *tw, TimerId id)
+{
+   if (!timer_pending(tw, id))
+      return 0;
+   unlink_node(tw, (int)id.index);
+   release_node(tw, (int)id.index);
+   tw->count--;
+   return 1;
+}
+
+long long timer_wheel_timeout(const TimerWheel *tw, long long now_ms)
+{
+   if (tw->count == 0)
+      return -1;
+   long long best = -1;
+   for (int l = 0; l < TIMER_LEVELS; l++)
+   {
+      long long base = tw->current_tick >> (TIMER_SLOT_BITS * l);
+      for (int k = 0; k < TIMER_SLOTS; k++)
+      {
+         if (tw->slots[l][(base + k) & TIMER_SLOT_MASK] != -1)
+         {
+            // level 0: exact expiry; upper levels: when the slot cascades down
+            long long tick = (base + k) << (TIMER_SLOT_BITS * l);
+            if (tick < tw->current_tick)
+               tick = tw->current_tick;
+            if (best == -1 || tick < best)
+               best = tick;
+            break;
+         }
+      }
+   }
+   if (best == -1)
+      return -1;
+   long long ms = best * TIMER_TICK_MS - now_ms;
+   return ms < 0 ? 0 : ms;
+}
+
+static void cascade(TimerWheel *tw, int level)
+{
+   int slot = (int)((tw->current_tick >> (TIMER_SLOT_BITS * level)) & TIMER_SLOT_MASK);
+   int n = tw->slots[level][slot];
+   tw->slots[level][slot] = -1;
+   while (n != -1)
+   {
+      int next = tw->pool[n].next;
+      place(tw, n);
+      n = next;
+   }
+}
+
+int timer_wheel_expire(TimerWheel *tw, long long now_ms, TimerEvent *out, int max)
+{
+   long long now_tick = now_ms / TIMER_TICK_MS;
+   int fired = 0;
+   while (tw->current_tick <= now_tick)
+   {
+      if (tw->count == 0)
+      {
+         // nothing armed: jump straight to the present
+         tw->current_tick = now_tick + 1;
+         break;
+      }
+      for (int l = 1; l < TIMER_LEVELS; l++)
+      {
+         if ((tw->current_tick & (((long long)1 << (TIMER_SLOT_BITS * l)) - 1)) != 0)
+            break;
+         cascade(tw, l);
+      }
+      int slot = (int)(tw->current_tick & TIMER_SLOT_MASK);
+      while (tw->slots[0][slot] != -1)
+      {
+         if (fired == max)
+            return fired; // resume this tick on the next call
+         int n = tw->slots[0][slot];
+         tw->slots[0][slot] = tw->pool[n].next;
+         if (tw->pool[n].next != -1)
+            tw->pool[tw->pool[n].next].prev = -1;
+         out[fired++] = tw->pool[n].event;
+         release_node(tw, n);
+         tw->count--;
+      }
+      tw->current_tick++;
+   }
+   return fired;
+}
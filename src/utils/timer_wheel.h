@@ -0,0 +1,70 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+/*
+ * HIERARCHICAL TIMER WHEEL
+ * ========================
+ * TIMER_LEVELS wheels of TIMER_SLOTS slots each; a slot of level L spans
+ * TIMER_SLOTS^L ticks of TIMER_TICK_MS. A timer is linked into the slot of
+ * the lowest level that can hold its expiry and moves down a level when the
+ * wheel above it turns over, so insert and cancel are O(1) and a tick only
+ * touches the timers that are actually due.
+ *
+ * Timers live in a pool owned by the wheel and are referenced by TimerId
+ * handles (slot index + generation), so a stale handle of a timer that
+ * already fired or was cancelled is harmless.
+ *
+ * Expired timers are not run as callbacks: timer_wheel_expire() hands them
+ * back as TimerEvent records that the caller dispatches with its own state.
+ */
+
+#define TIMER_TICK_MS 10
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+#define TIMER_LEVELS 4
+
+typedef struct
+{
+   unsigned int index; // 0 means "no timer"
+   unsigned int generation;
+} TimerId;
+
+typedef struct
+{
+   int kind; // caller-defined event kind
+   int a;    // caller-defined arguments
+   int b;
+} TimerEvent;
+
+typedef struct
+{
+   TimerEvent event;
+   long long expires_tick;
+   unsigned int generation;
+   int prev; // pool indices, -1 terminates; prev == -2 marks a free node
+   int next;
+} TimerNode;
+
+typedef struct
+{
+   long long current_tick; // next tick to process
+   int count;              // armed timers
+   int slots[TIMER_LEVELS][TIMER_SLOTS]; // list heads (pool indices, -1 if empty)
+   TimerNode *pool;        // pool[0] is never used so that index 0 means "none"
+   int pool_size;
+   int free_head;
+} TimerWheel;
+
+void timer_wheel_init(TimerWheel *tw, long long now_ms);
+void timer_wheel_free(TimerWheel *tw);
+/* Arm a timer firing after delay_ms; returns a zero handle if out of memory */
+TimerId timer_add(TimerWheel *tw, long long now_ms, long long delay_ms, int kind, int a, int b);
+/* Disarm a timer; returns 1 if it was still pending */
+int timer_cancel(TimerWheel *tw, TimerId id);
+int timer_pending(const TimerWheel *tw, TimerId id);
+/* Milliseconds until the wheel needs attention, -1 if no timer is armed */
+long long timer_wheel_timeout(const TimerWheel *tw, long long now_ms);
+/* Collect up to max expired events; call again while it returns max */
+int timer_wheel_expire(TimerWheel *tw, long long now_ms, TimerEvent *out, int max);
+
+#endif